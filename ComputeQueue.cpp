@@ -0,0 +1,302 @@
+#include "ComputeQueue.h"
+#include <limits>
+
+using
+    std::vector,
+    std::move;
+
+auto ComputeQueue::retire_batches() -> vk::Result
+{
+    if(in_flight.empty())
+        return vk::Result::eSuccess;
+
+    auto completed = device.getSemaphoreCounterValue(timeline);
+    if(completed.result != vk::Result::eSuccess)
+        return completed.result;
+
+    while(!in_flight.empty() && in_flight.front().timeline_value <= completed.value)
+    {
+        free_bufs.push_back(in_flight.front().buf);
+        in_flight.pop_front();
+    }
+
+    return vk::Result::eSuccess;
+}
+
+auto ComputeQueue::acquire_buffer() -> vk::ResultValue<vk::CommandBuffer>
+{
+    if(!free_bufs.empty())
+    {
+        auto buf = free_bufs.back();
+        free_bufs.pop_back();
+        return {vk::Result::eSuccess, buf};
+    }
+
+    vk::CommandBufferAllocateInfo comm_buf_info;
+    comm_buf_info
+        .setCommandPool(comm_pool)
+        .setLevel(vk::CommandBufferLevel::ePrimary)
+        .setCommandBufferCount(1);
+
+    auto buf_tmp = device.allocateCommandBuffers(comm_buf_info);
+    if(buf_tmp.result != vk::Result::eSuccess)
+        return {buf_tmp.result, vk::CommandBuffer()};
+
+    return {vk::Result::eSuccess, buf_tmp.value[0]};
+}
+
+auto ComputeQueue::get_pending_stages() const -> vk::PipelineStageFlags
+{
+    vk::PipelineStageFlags stages;
+    for(auto &pass : pending_passes)
+        stages |= pass.graphics_stages;
+
+    return stages;
+}
+
+auto ComputeQueue::has_pending_after_graphics() const -> bool
+{
+    for(auto &pass : pending_passes)
+        if(pass.is_after_graphics)
+            return true;
+
+    return false;
+}
+
+auto ComputeQueue::init(vk::Device dev, const QueueDesc &compute, uint32_t graphics_queue_family, bool is_async) -> vk::Result
+{
+    device = dev;
+    compute_queue = compute;
+    graphics_family = graphics_queue_family;
+    last_submitted_value = 0;
+    is_inited_flag = true;
+
+    if(!is_async)
+        return vk::Result::eSuccess;
+
+    vk::CommandPoolCreateInfo pool_info;
+    pool_info
+        .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(compute_queue.family);
+
+    auto pool_tmp = device.createCommandPool(pool_info);
+    if(pool_tmp.result != vk::Result::eSuccess)
+    {
+        destroy();
+        return pool_tmp.result;
+    }
+
+    comm_pool = pool_tmp.value;
+
+    vk::SemaphoreTypeCreateInfo timeline_type_info;
+    timeline_type_info
+        .setSemaphoreType(vk::SemaphoreType::eTimeline)
+        .setInitialValue(0);
+
+    auto timeline_tmp = device.createSemaphore(vk::SemaphoreCreateInfo().setPNext(&timeline_type_info));
+    if(timeline_tmp.result != vk::Result::eSuccess)
+    {
+        destroy();
+        return timeline_tmp.result;
+    }
+
+    timeline = timeline_tmp.value;
+    return vk::Result::eSuccess;
+}
+
+auto ComputeQueue::destroy() -> void
+{
+    if(!is_inited_flag)
+        return;
+
+    in_flight.clear();
+    free_bufs.clear();
+    pending_passes.clear();
+    graphics_wait = {};
+
+    device.destroy(comm_pool);
+    device.destroy(timeline);
+    comm_pool = vk::CommandPool();
+    timeline = vk::Semaphore();
+    is_inited_flag = false;
+}
+
+auto ComputeQueue::is_inited() const -> bool
+{
+    return is_inited_flag;
+}
+
+auto ComputeQueue::AddPass(RecordFunc &&record, vk::PipelineStageFlags graphics_stages, bool is_after_graphics) -> void
+{
+    pending_passes.push_back(Pass{move(record), graphics_stages, is_after_graphics});
+}
+
+auto ComputeQueue::Submit(vk::Semaphore graphics_timeline, uint64_t graphics_value) -> vk::Result
+{
+    if(pending_passes.empty())
+        return vk::Result::eSuccess;
+
+    auto res = retire_batches();
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    auto buf = acquire_buffer();
+    if(buf.result != vk::Result::eSuccess)
+        return buf.result;
+
+    res = buf.value.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    if(res != vk::Result::eSuccess)
+    {
+        free_bufs.push_back(buf.value);
+        return res;
+    }
+
+    for(auto &pass : pending_passes)
+        pass.record(buf.value);
+
+    res = buf.value.end();
+    if(res != vk::Result::eSuccess)
+    {
+        free_bufs.push_back(buf.value);
+        return res;
+    }
+
+    //semaphore wait makes graphics writes visible, nothing to wait before the first graphics submit
+    bool wait_graphics = has_pending_after_graphics() && graphics_value != 0;
+    vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eComputeShader;
+    uint64_t signal_value = last_submitted_value + 1;
+
+    vk::TimelineSemaphoreSubmitInfo timeline_info;
+    timeline_info
+        .setWaitSemaphoreValueCount(wait_graphics ? 1 : 0)
+        .setPWaitSemaphoreValues(&graphics_value)
+        .setSignalSemaphoreValues(signal_value);
+
+    vk::SubmitInfo submit_info;
+    submit_info
+        .setPNext(&timeline_info)
+        .setWaitSemaphoreCount(wait_graphics ? 1 : 0)
+        .setPWaitSemaphores(&graphics_timeline)
+        .setPWaitDstStageMask(&wait_stage)
+        .setCommandBuffers(buf.value)
+        .setSignalSemaphores(timeline);
+
+    res = compute_queue.queue.submit(submit_info);
+    if(res != vk::Result::eSuccess)
+    {
+        free_bufs.push_back(buf.value);
+        return res;
+    }
+
+    last_submitted_value = signal_value;
+    in_flight.push_back(Batch{buf.value, signal_value});
+
+    //graphics waits every batch, so its frame values cover compute work too.
+    //Passes nobody reads are waited at the end of graphics work
+    auto stages = get_pending_stages();
+    graphics_wait.value = signal_value;
+    graphics_wait.stages |= (stages ? stages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eAllCommands));
+    pending_passes.clear();
+    return vk::Result::eSuccess;
+}
+
+auto ComputeQueue::TakeGraphicsWait() -> GraphicsWait
+{
+    auto wait = graphics_wait;
+    graphics_wait = {};
+    return wait;
+}
+
+auto ComputeQueue::RecordInline(vk::CommandBuffer graphics_buf) -> void
+{
+    if(pending_passes.empty())
+        return;
+
+    if(has_pending_after_graphics())
+    {
+        vk::MemoryBarrier barrier;
+        barrier
+            .setSrcAccessMask(vk::AccessFlagBits::eMemoryWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+        graphics_buf.pipelineBarrier(vk::PipelineStageFlagBits::eAllGraphics | vk::PipelineStageFlagBits::eTransfer,
+                                     vk::PipelineStageFlagBits::eComputeShader,
+                                     {},
+                                     barrier,
+                                     {},
+                                     {});
+    }
+
+    for(auto &pass : pending_passes)
+        pass.record(graphics_buf);
+
+    auto stages = get_pending_stages();
+    if(stages)
+    {
+        vk::MemoryBarrier barrier;
+        barrier
+            .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eMemoryRead);
+
+        graphics_buf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                     stages,
+                                     {},
+                                     barrier,
+                                     {},
+                                     {});
+    }
+
+    pending_passes.clear();
+}
+
+auto ComputeQueue::WaitIdle() -> vk::Result
+{
+    if(in_flight.empty())
+        return vk::Result::eSuccess;
+
+    vk::SemaphoreWaitInfo wait_info;
+    wait_info
+        .setFlags({})
+        .setSemaphores(timeline)
+        .setValues(last_submitted_value);
+
+    auto res = device.waitSemaphores(wait_info, std::numeric_limits<uint64_t>::max());
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    return retire_batches();
+}
+
+auto ComputeQueue::IsAsync() const -> bool
+{
+    return static_cast<bool>(timeline);
+}
+
+auto ComputeQueue::GetQueueFamilies() const -> std::vector<uint32_t>
+{
+    if(!IsAsync() || compute_queue.family == graphics_family)
+        return {graphics_family};
+
+    return {graphics_family, compute_queue.family};
+}
+
+auto ComputeQueue::GetTimelineSemaphore() const -> vk::Semaphore
+{
+    return timeline;
+}
+
+auto ComputeQueue::RecordDispatch(vk::CommandBuffer buf, const Dispatch &dispatch) -> void
+{
+    buf.bindPipeline(vk::PipelineBindPoint::eCompute, dispatch.ppl);
+    if(!dispatch.sets.empty())
+        buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, dispatch.layout, 0, dispatch.sets, {});
+
+    if(!dispatch.push_constants.empty())
+        buf.pushConstants(dispatch.layout,
+                          vk::ShaderStageFlagBits::eCompute,
+                          0,
+                          static_cast<uint32_t>(dispatch.push_constants.size()),
+                          dispatch.push_constants.data());
+
+    buf.dispatch(dispatch.group_count[0], dispatch.group_count[1], dispatch.group_count[2]);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <span>
+#include <array>
+#include <functional>
+#include "VulkanInclude.h"
+
+//Records compute passes of a frame and submits them to compute family before graphics submit.
+//Batches signal timeline semaphore, graphics queue waits on it only at stages that consume results,
+//so culling, simulation etc. overlap with rasterization of the previous frame.
+//Without timeline semaphores passes are recorded inline into graphics command buffer
+class ComputeQueue
+{
+public:
+    struct QueueDesc
+    {
+        uint32_t family;
+        vk::Queue queue;
+    };
+
+    using RecordFunc = std::function<void (vk::CommandBuffer)>;
+
+    //what graphics submit must wait on before compute results are used
+    struct GraphicsWait
+    {
+        uint64_t value = 0;//0 - nothing to wait
+        vk::PipelineStageFlags stages;
+    };
+
+    struct Dispatch
+    {
+        vk::Pipeline ppl;
+        vk::PipelineLayout layout;
+        std::span<const vk::DescriptorSet> sets;//bound from set 0
+        std::span<const uint8_t> push_constants;//pushed at offset 0
+        std::array<uint32_t, 3> group_count = {1, 1, 1};
+    };
+
+private:
+    struct Pass
+    {
+        RecordFunc record;
+        vk::PipelineStageFlags graphics_stages;
+        bool is_after_graphics;
+    };
+
+    struct Batch
+    {
+        vk::CommandBuffer buf;
+        uint64_t timeline_value = 0;
+    };
+
+    vk::Device device;
+    QueueDesc compute_queue;
+    uint32_t graphics_family = 0;
+    bool is_inited_flag = false;
+
+    vk::CommandPool comm_pool;
+    std::vector<vk::CommandBuffer> free_bufs;
+
+    vk::Semaphore timeline;//null - passes are recorded inline
+    uint64_t last_submitted_value = 0;
+    std::deque<Batch> in_flight;
+
+    std::vector<Pass> pending_passes;
+    GraphicsWait graphics_wait;
+
+    auto retire_batches() -> vk::Result;
+    auto acquire_buffer() -> vk::ResultValue<vk::CommandBuffer>;
+    auto get_pending_stages() const -> vk::PipelineStageFlags;
+    auto has_pending_after_graphics() const -> bool;
+public:
+    ComputeQueue() = default;
+    ComputeQueue(const ComputeQueue &cq) = delete;
+    ~ComputeQueue() = default;
+
+    //is_async - separate submits with timeline semaphore, compute queue is ignored otherwise
+    auto init(vk::Device dev, const QueueDesc &compute, uint32_t graphics_queue_family, bool is_async) -> vk::Result;
+    //device must be idle
+    auto destroy() -> void;
+    auto is_inited() const -> bool;
+
+    //graphics_stages - where graphics queue reads results, empty means nothing is read
+    //is_after_graphics - pass reads what previous graphics submit wrote, e.g. post-processing of last frame
+    auto AddPass(RecordFunc &&record, vk::PipelineStageFlags graphics_stages, bool is_after_graphics) -> void;
+    //submits pending passes as one batch, graphics_value is the last graphics submit
+    auto Submit(vk::Semaphore graphics_timeline, uint64_t graphics_value) -> vk::Result;
+    //must be waited by the next graphics submit
+    auto TakeGraphicsWait() -> GraphicsWait;
+    //synchronous fallback, pending passes are recorded with barriers around them
+    auto RecordInline(vk::CommandBuffer graphics_buf) -> void;
+    auto WaitIdle() -> vk::Result;
+
+    auto IsAsync() const -> bool;
+    //resources used by both queues need concurrent sharing between these families
+    auto GetQueueFamilies() const -> std::vector<uint32_t>;
+    auto GetTimelineSemaphore() const -> vk::Semaphore;
+
+    static auto RecordDispatch(vk::CommandBuffer buf, const Dispatch &dispatch) -> void;
+};
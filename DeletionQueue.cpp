@@ -0,0 +1,95 @@
+#include "DeletionQueue.h"
+#include <type_traits>
+
+auto DeletionQueue::destroy_object(Object &object) -> void
+{
+    if(auto buffer = std::get_if<DeviceAllocator::BufferAllocation>(&object))
+        allocator->DestroyBuffer(*buffer);
+    else if(auto image = std::get_if<DeviceAllocator::ImageAllocation>(&object))
+        allocator->DestroyImage(*image);
+    else if(auto allocation = std::get_if<DeviceAllocator::Allocation>(&object))
+        allocator->Free(*allocation);
+    else if(auto comm_bufs = std::get_if<CommandBuffers>(&object))
+    {
+        if(!comm_bufs->bufs.empty())
+            device.free(comm_bufs->pool, comm_bufs->bufs);
+    }
+    else if(auto callback = std::get_if<Callback>(&object))
+    {
+        if(*callback)
+            (*callback)();
+    }
+    else
+    {
+        //plain handles, null ones are ignored by destroy
+        std::visit([this](auto &handle)
+        {
+            using T = std::remove_cvref_t<decltype(handle)>;
+            if constexpr(std::is_same_v<T, vk::Pipeline> ||
+                         std::is_same_v<T, vk::RenderPass> ||
+                         std::is_same_v<T, vk::DescriptorPool> ||
+                         std::is_same_v<T, vk::Framebuffer> ||
+                         std::is_same_v<T, vk::ImageView> ||
+                         std::is_same_v<T, vk::Image> ||
+                         std::is_same_v<T, vk::SwapchainKHR> ||
+                         std::is_same_v<T, vk::Semaphore>)
+                device.destroy(handle);
+        }, object);
+    }
+}
+
+auto DeletionQueue::init(vk::Device dev, DeviceAllocator &alloc) -> void
+{
+    device = dev;
+    allocator = &alloc;
+    release_value = 0;
+}
+
+auto DeletionQueue::destroy() -> void
+{
+    if(!is_inited())
+        return;
+
+    for(auto &entry : entries)
+        destroy_object(entry.object);
+
+    entries.clear();
+    device = vk::Device();
+    allocator = nullptr;
+}
+
+auto DeletionQueue::is_inited() const -> bool
+{
+    return allocator != nullptr;
+}
+
+auto DeletionQueue::SetReleaseValue(uint64_t value) -> void
+{
+    release_value = value;
+}
+
+auto DeletionQueue::Push(Object &&object) -> void
+{
+    //nothing is submitted yet, so nothing can use it
+    if(release_value == 0)
+    {
+        destroy_object(object);
+        return;
+    }
+
+    entries.push_back(Entry{release_value, std::move(object)});
+}
+
+auto DeletionQueue::Collect(uint64_t completed_value) -> void
+{
+    while(!entries.empty() && entries.front().frame_value <= completed_value)
+    {
+        destroy_object(entries.front().object);
+        entries.pop_front();
+    }
+}
+
+auto DeletionQueue::GetPendingCount() const -> size_t
+{
+    return entries.size();
+}
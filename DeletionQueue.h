@@ -0,0 +1,68 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <variant>
+#include <functional>
+#include "VulkanInclude.h"
+#include "DeviceAllocator.h"
+
+//Objects released while frames in flight may still use them.
+//Every object is tagged with the release value (last submitted frame value) and destroyed
+//once GPU completes that frame, so replacing resources at runtime doesn't need any idle
+class DeletionQueue
+{
+public:
+    struct CommandBuffers
+    {
+        vk::CommandPool pool;
+        std::vector<vk::CommandBuffer> bufs;
+    };
+
+    //for ranges of suballocators that aren't Vulkan objects themselves, e.g. mesh storage ranges
+    using Callback = std::function<void ()>;
+
+    using Object = std::variant<vk::Pipeline,
+                                vk::RenderPass,
+                                vk::DescriptorPool,
+                                vk::Framebuffer,
+                                vk::ImageView,
+                                vk::Image,
+                                vk::SwapchainKHR,
+                                vk::Semaphore,
+                                DeviceAllocator::BufferAllocation,
+                                DeviceAllocator::ImageAllocation,
+                                DeviceAllocator::Allocation,
+                                CommandBuffers,
+                                Callback>;
+
+private:
+    struct Entry
+    {
+        uint64_t frame_value;
+        Object object;
+    };
+
+    vk::Device device;
+    DeviceAllocator *allocator = nullptr;
+    std::deque<Entry> entries;//release values never decrease, so the oldest ones are in front
+    uint64_t release_value = 0;
+
+    auto destroy_object(Object &object) -> void;
+public:
+    DeletionQueue() = default;
+    DeletionQueue(const DeletionQueue &dq) = delete;
+    ~DeletionQueue() = default;
+
+    auto init(vk::Device dev, DeviceAllocator &alloc) -> void;
+    //destroys everything left, device must be idle
+    auto destroy() -> void;
+    auto is_inited() const -> bool;
+
+    //called after every submit, objects pushed since then wait for this frame
+    auto SetReleaseValue(uint64_t value) -> void;
+    auto Push(Object &&object) -> void;
+    //destroys objects of frames up to completed_value
+    auto Collect(uint64_t completed_value) -> void;
+    auto GetPendingCount() const -> size_t;
+};
@@ -0,0 +1,391 @@
+#include "DeviceAllocator.h"
+#include <bit>
+#include <algorithm>
+
+using
+    std::optional,
+    std::unique_ptr,
+    std::make_unique,
+    std::lock_guard,
+    std::mutex,
+    std::move;
+
+DeviceAllocator::~DeviceAllocator()
+{
+    destroy();
+}
+
+auto DeviceAllocator::init(vk::Device dev, vk::PhysicalDevice ph_dev) -> void
+{
+    device = dev;
+    memory_props = ph_dev.getMemoryProperties();
+
+    auto limits = ph_dev.getProperties().limits;
+    buffer_image_granularity = limits.bufferImageGranularity;
+    non_coherent_atom_size = limits.nonCoherentAtomSize;
+    max_allocation_count = limits.maxMemoryAllocationCount;
+
+    pools.clear();
+    pools.resize(memory_props.memoryTypeCount);
+    for(uint32_t i = 0; i < memory_props.memoryTypeCount; i++)
+    {
+        //small heaps (e.g. 256MB BAR) shouldn't be eaten by single block
+        auto heap_size = memory_props.memoryHeaps[memory_props.memoryTypes[i].heapIndex].size;
+        vk::DeviceSize block_size = std::bit_floor(heap_size / 8);
+        block_size = std::clamp(block_size, MIN_BLOCK_SIZE, DEFAULT_BLOCK_SIZE);
+
+        for(auto &pool : pools[i])
+            pool.block_size = block_size;
+    }
+}
+
+auto DeviceAllocator::destroy() -> void
+{
+    if(!device)
+        return;
+
+    for(auto &type_pools : pools)
+        for(auto &pool : type_pools)
+        {
+            for(auto &block : pool.blocks)
+                free_device_memory(block->memory, block->mapped_ptr != nullptr);
+
+            pool.blocks.clear();
+        }
+
+    pools.clear();
+    device_allocation_count = 0;
+    dedicated_count = 0;
+    dedicated_bytes = 0;
+    device = vk::Device();
+}
+
+auto DeviceAllocator::find_memory_type(uint32_t type_bits, vk::MemoryPropertyFlags props) const -> optional<uint32_t>
+{
+    for(uint32_t i = 0; i < memory_props.memoryTypeCount; i++)
+    {
+        if(!(type_bits & (1u << i)))
+            continue;
+
+        if((memory_props.memoryTypes[i].propertyFlags & props) == props)
+            return i;
+    }
+
+    return {};
+}
+
+auto DeviceAllocator::pool_index(ResourceTiling tiling) const -> size_t
+{
+    if(buffer_image_granularity <= 1)
+        return 0;
+
+    return static_cast<size_t>(tiling);
+}
+
+auto DeviceAllocator::allocate_device_memory(uint32_t memory_type, vk::DeviceSize size, vk::DeviceMemory &memory, void *&mapped_ptr) -> vk::Result
+{
+    if(max_allocation_count != 0 && device_allocation_count >= max_allocation_count)
+        return vk::Result::eErrorTooManyObjects;
+
+    vk::MemoryAllocateInfo alloc_info;
+    alloc_info
+        .setAllocationSize(size)
+        .setMemoryTypeIndex(memory_type);
+
+    auto memory_tmp = device.allocateMemory(alloc_info);
+    if(memory_tmp.result != vk::Result::eSuccess)
+        return memory_tmp.result;
+
+    mapped_ptr = nullptr;
+    if(memory_props.memoryTypes[memory_type].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+    {
+        //persistently mapped for whole lifetime
+        auto map_res = device.mapMemory(memory_tmp.value, 0, VK_WHOLE_SIZE);
+        if(map_res.result != vk::Result::eSuccess)
+        {
+            device.free(memory_tmp.value);
+            return map_res.result;
+        }
+
+        mapped_ptr = map_res.value;
+    }
+
+    memory = memory_tmp.value;
+    device_allocation_count++;
+    return vk::Result::eSuccess;
+}
+
+auto DeviceAllocator::free_device_memory(vk::DeviceMemory memory, bool is_mapped) -> void
+{
+    if(is_mapped)
+        device.unmapMemory(memory);
+
+    device.free(memory);
+    device_allocation_count--;
+}
+
+auto DeviceAllocator::allocate_dedicated(uint32_t memory_type, vk::DeviceSize size) -> hrs::expected<Allocation, vk::Result>
+{
+    Allocation allocation;
+    auto res = allocate_device_memory(memory_type, size, allocation.memory, allocation.mapped_ptr);
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    allocation.offset = 0;
+    allocation.size = size;
+    allocation.memory_type = memory_type;
+    allocation.block = nullptr;
+
+    dedicated_count++;
+    dedicated_bytes += size;
+    return allocation;
+}
+
+auto DeviceAllocator::Allocate(const vk::MemoryRequirements &req,
+                               vk::MemoryPropertyFlags required,
+                               vk::MemoryPropertyFlags preferred,
+                               ResourceTiling tiling) -> hrs::expected<Allocation, vk::Result>
+{
+    if(!device)
+        return vk::Result::eErrorInitializationFailed;
+
+    auto memory_type = find_memory_type(req.memoryTypeBits, required | preferred);
+    if(!memory_type)
+        memory_type = find_memory_type(req.memoryTypeBits, required);
+
+    if(!memory_type)
+        return vk::Result::eErrorFeatureNotPresent;
+
+    lock_guard<mutex> lck(allocator_mutex);
+
+    auto &pool = pools[memory_type.value()][pool_index(tiling)];
+    if(req.size > pool.block_size / 2)
+        return allocate_dedicated(memory_type.value(), req.size);
+
+    auto sub_allocate = [&](MemoryBlock &block) -> optional<Allocation>
+    {
+        auto offset = block.buddy.allocate(req.size, req.alignment);
+        if(!offset)
+            return {};
+
+        Allocation allocation;
+        allocation.memory = block.memory;
+        allocation.offset = offset.value();
+        allocation.size = req.size;
+        allocation.mapped_ptr = (block.mapped_ptr ? static_cast<uint8_t *>(block.mapped_ptr) + offset.value() : nullptr);
+        allocation.memory_type = memory_type.value();
+        allocation.block = &block;
+        return allocation;
+    };
+
+    for(auto &block : pool.blocks)
+    {
+        auto allocation = sub_allocate(*block);
+        if(allocation)
+            return allocation.value();
+    }
+
+    auto new_block = make_unique<MemoryBlock>();
+    auto res = allocate_device_memory(memory_type.value(), pool.block_size, new_block->memory, new_block->mapped_ptr);
+    if(res == vk::Result::eErrorOutOfDeviceMemory || res == vk::Result::eErrorOutOfHostMemory)
+    {
+        //heap can't hold one more block, but exact size still may fit
+        return allocate_dedicated(memory_type.value(), req.size);
+    }
+    else if(res != vk::Result::eSuccess)
+        return res;
+
+    new_block->buddy.init(pool.block_size, MIN_ALLOCATION_SIZE);
+    pool.blocks.push_back(move(new_block));
+    return sub_allocate(*pool.blocks.back()).value();
+}
+
+auto DeviceAllocator::Free(Allocation &allocation) -> void
+{
+    if(!allocation)
+        return;
+
+    lock_guard<mutex> lck(allocator_mutex);
+
+    if(allocation.block == nullptr)
+    {
+        free_device_memory(allocation.memory, allocation.mapped_ptr != nullptr);
+        dedicated_count--;
+        dedicated_bytes -= allocation.size;
+        allocation = {};
+        return;
+    }
+
+    auto block = static_cast<MemoryBlock *>(allocation.block);
+    block->buddy.free(allocation.offset);
+
+    //keep one empty block per pool to avoid allocate/free thrashing
+    if(block->buddy.is_empty())
+    {
+        for(auto &pool : pools[allocation.memory_type])
+        {
+            auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(), [block](const unique_ptr<MemoryBlock> &b)
+            {
+                return b.get() == block;
+            });
+
+            if(it == pool.blocks.end())
+                continue;
+
+            size_t empty_blocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](const unique_ptr<MemoryBlock> &b)
+            {
+                return b->buddy.is_empty();
+            });
+
+            if(empty_blocks > 1)
+            {
+                free_device_memory(block->memory, block->mapped_ptr != nullptr);
+                pool.blocks.erase(it);
+            }
+
+            break;
+        }
+    }
+
+    allocation = {};
+}
+
+auto DeviceAllocator::CreateBuffer(const vk::BufferCreateInfo &info,
+                                   vk::MemoryPropertyFlags required,
+                                   vk::MemoryPropertyFlags preferred) -> hrs::expected<BufferAllocation, vk::Result>
+{
+    auto buffer_tmp = device.createBuffer(info);
+    if(buffer_tmp.result != vk::Result::eSuccess)
+        return buffer_tmp.result;
+
+    auto req = device.getBufferMemoryRequirements(buffer_tmp.value);
+    auto allocation = Allocate(req, required, preferred, ResourceTiling::Linear);
+    if(!allocation.has_value())
+    {
+        device.destroy(buffer_tmp.value);
+        return allocation.error();
+    }
+
+    auto res = device.bindBufferMemory(buffer_tmp.value, allocation.value().memory, allocation.value().offset);
+    if(res != vk::Result::eSuccess)
+    {
+        Free(allocation.value());
+        device.destroy(buffer_tmp.value);
+        return res;
+    }
+
+    return BufferAllocation{buffer_tmp.value, allocation.value()};
+}
+
+auto DeviceAllocator::DestroyBuffer(BufferAllocation &buffer) -> void
+{
+    if(buffer.buffer)
+        device.destroy(buffer.buffer);
+
+    Free(buffer.allocation);
+    buffer = {};
+}
+
+auto DeviceAllocator::CreateImage(const vk::ImageCreateInfo &info,
+                                  vk::MemoryPropertyFlags required,
+                                  vk::MemoryPropertyFlags preferred) -> hrs::expected<ImageAllocation, vk::Result>
+{
+    auto image_tmp = device.createImage(info);
+    if(image_tmp.result != vk::Result::eSuccess)
+        return image_tmp.result;
+
+    auto tiling = (info.tiling == vk::ImageTiling::eLinear ? ResourceTiling::Linear : ResourceTiling::Optimal);
+    auto req = device.getImageMemoryRequirements(image_tmp.value);
+    auto allocation = Allocate(req, required, preferred, tiling);
+    if(!allocation.has_value())
+    {
+        device.destroy(image_tmp.value);
+        return allocation.error();
+    }
+
+    auto res = device.bindImageMemory(image_tmp.value, allocation.value().memory, allocation.value().offset);
+    if(res != vk::Result::eSuccess)
+    {
+        Free(allocation.value());
+        device.destroy(image_tmp.value);
+        return res;
+    }
+
+    return ImageAllocation{image_tmp.value, allocation.value()};
+}
+
+auto DeviceAllocator::DestroyImage(ImageAllocation &image) -> void
+{
+    if(image.image)
+        device.destroy(image.image);
+
+    Free(image.allocation);
+    image = {};
+}
+
+auto DeviceAllocator::mapped_range(const Allocation &allocation, vk::DeviceSize offset, vk::DeviceSize size) const -> vk::MappedMemoryRange
+{
+    if(size == VK_WHOLE_SIZE)
+        size = allocation.size - offset;
+
+    //range must be aligned to nonCoherentAtomSize, block is always bigger than atom
+    vk::DeviceSize begin = allocation.offset + offset;
+    vk::DeviceSize end = begin + size;
+    begin = (begin / non_coherent_atom_size) * non_coherent_atom_size;
+    end = ((end + non_coherent_atom_size - 1) / non_coherent_atom_size) * non_coherent_atom_size;
+
+    vk::MappedMemoryRange range;
+    range
+        .setMemory(allocation.memory)
+        .setOffset(begin)
+        .setSize(end - begin);
+
+    if(allocation.block == nullptr && end > allocation.size)
+        range.setSize(VK_WHOLE_SIZE);
+
+    return range;
+}
+
+auto DeviceAllocator::Flush(const Allocation &allocation, vk::DeviceSize offset, vk::DeviceSize size) -> vk::Result
+{
+    if(!allocation || IsHostCoherent(allocation))
+        return vk::Result::eSuccess;
+
+    return device.flushMappedMemoryRanges(mapped_range(allocation, offset, size));
+}
+
+auto DeviceAllocator::Invalidate(const Allocation &allocation, vk::DeviceSize offset, vk::DeviceSize size) -> vk::Result
+{
+    if(!allocation || IsHostCoherent(allocation))
+        return vk::Result::eSuccess;
+
+    return device.invalidateMappedMemoryRanges(mapped_range(allocation, offset, size));
+}
+
+auto DeviceAllocator::GetStatistics() -> Statistics
+{
+    lock_guard<mutex> lck(allocator_mutex);
+
+    Statistics stats;
+    stats.dedicated_count = dedicated_count;
+    stats.allocation_count = dedicated_count;
+    stats.reserved_bytes = dedicated_bytes;
+    stats.used_bytes = dedicated_bytes;
+
+    for(auto &type_pools : pools)
+        for(auto &pool : type_pools)
+            for(auto &block : pool.blocks)
+            {
+                stats.block_count++;
+                stats.allocation_count += block->buddy.get_allocation_count();
+                stats.reserved_bytes += block->buddy.get_size();
+                stats.used_bytes += block->buddy.get_used();
+            }
+
+    return stats;
+}
+
+auto DeviceAllocator::IsHostCoherent(const Allocation &allocation) const -> bool
+{
+    return static_cast<bool>(memory_props.memoryTypes[allocation.memory_type].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include "VulkanInclude.h"
+#include "utils/expected.hpp"
+#include "utils/BuddyAllocator.hpp"
+
+//Pools device memory: big vk::DeviceMemory blocks are allocated per memory type and
+//resources are sub-allocated from them by buddy allocator.
+//Big resources (more than half of block) get dedicated allocation.
+class DeviceAllocator
+{
+public:
+    enum class ResourceTiling : uint8_t
+    {
+        Linear = 0,//buffers and linear images
+        Optimal = 1//optimal images
+    };
+
+    struct Allocation
+    {
+        vk::DeviceMemory memory;
+        vk::DeviceSize offset = 0;
+        vk::DeviceSize size = 0;
+        void *mapped_ptr = nullptr;//non null only for host visible memory
+        uint32_t memory_type = 0;
+        void *block = nullptr;//owning block, nullptr for dedicated allocation
+
+        explicit operator bool() const
+        {
+            return static_cast<bool>(memory);
+        }
+    };
+
+    struct BufferAllocation
+    {
+        vk::Buffer buffer;
+        Allocation allocation;
+    };
+
+    struct ImageAllocation
+    {
+        vk::Image image;
+        Allocation allocation;
+    };
+
+    struct Statistics
+    {
+        size_t block_count = 0;
+        size_t dedicated_count = 0;
+        size_t allocation_count = 0;//sub-allocations + dedicated
+        vk::DeviceSize reserved_bytes = 0;//sum of all vkAllocateMemory sizes
+        vk::DeviceSize used_bytes = 0;//bytes handed out to resources, including buddy rounding
+    };
+
+    constexpr static vk::DeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+    constexpr static vk::DeviceSize MIN_BLOCK_SIZE = 1024 * 1024;
+    constexpr static vk::DeviceSize MIN_ALLOCATION_SIZE = 256;
+
+private:
+    struct MemoryBlock
+    {
+        vk::DeviceMemory memory;
+        void *mapped_ptr = nullptr;
+        hrs::BuddyAllocator buddy;
+    };
+
+    //linear and optimal resources never share a block when bufferImageGranularity > 1,
+    //so neighbour resources can't alias the same granularity page
+    struct MemoryPool
+    {
+        vk::DeviceSize block_size = DEFAULT_BLOCK_SIZE;
+        std::vector<std::unique_ptr<MemoryBlock>> blocks;
+    };
+
+    vk::Device device;
+    vk::PhysicalDeviceMemoryProperties memory_props;
+    vk::DeviceSize buffer_image_granularity = 1;
+    vk::DeviceSize non_coherent_atom_size = 1;
+    uint32_t max_allocation_count = 0;
+    uint32_t device_allocation_count = 0;//all live vkAllocateMemory objects
+    size_t dedicated_count = 0;
+    vk::DeviceSize dedicated_bytes = 0;
+
+    std::vector<std::array<MemoryPool, 2>> pools;//[memory type][tiling]
+    std::mutex allocator_mutex;
+
+    auto find_memory_type(uint32_t type_bits, vk::MemoryPropertyFlags props) const -> std::optional<uint32_t>;
+    auto pool_index(ResourceTiling tiling) const -> size_t;
+    auto allocate_device_memory(uint32_t memory_type, vk::DeviceSize size, vk::DeviceMemory &memory, void *&mapped_ptr) -> vk::Result;
+    auto free_device_memory(vk::DeviceMemory memory, bool is_mapped) -> void;
+    auto allocate_dedicated(uint32_t memory_type, vk::DeviceSize size) -> hrs::expected<Allocation, vk::Result>;
+    auto mapped_range(const Allocation &allocation, vk::DeviceSize offset, vk::DeviceSize size) const -> vk::MappedMemoryRange;
+public:
+    DeviceAllocator() = default;
+    DeviceAllocator(const DeviceAllocator &alloc) = delete;
+    ~DeviceAllocator();
+
+    auto init(vk::Device dev, vk::PhysicalDevice ph_dev) -> void;
+    auto destroy() -> void;
+
+    auto Allocate(const vk::MemoryRequirements &req,
+                  vk::MemoryPropertyFlags required,
+                  vk::MemoryPropertyFlags preferred = {},
+                  ResourceTiling tiling = ResourceTiling::Linear) -> hrs::expected<Allocation, vk::Result>;
+    auto Free(Allocation &allocation) -> void;
+
+    auto CreateBuffer(const vk::BufferCreateInfo &info,
+                      vk::MemoryPropertyFlags required,
+                      vk::MemoryPropertyFlags preferred = {}) -> hrs::expected<BufferAllocation, vk::Result>;
+    auto DestroyBuffer(BufferAllocation &buffer) -> void;
+
+    auto CreateImage(const vk::ImageCreateInfo &info,
+                     vk::MemoryPropertyFlags required,
+                     vk::MemoryPropertyFlags preferred = {}) -> hrs::expected<ImageAllocation, vk::Result>;
+    auto DestroyImage(ImageAllocation &image) -> void;
+
+    //no-op for host coherent memory
+    auto Flush(const Allocation &allocation, vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE) -> vk::Result;
+    //makes device writes visible to host, no-op for host coherent memory
+    auto Invalidate(const Allocation &allocation, vk::DeviceSize offset = 0, vk::DeviceSize size = VK_WHOLE_SIZE) -> vk::Result;
+
+    auto GetStatistics() -> Statistics;
+    auto IsHostCoherent(const Allocation &allocation) const -> bool;
+};
@@ -4,6 +4,9 @@
 #include <charconv>
 #include <optional>
 #include <array>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
 #include "math/Math.hpp"
 
 using
@@ -50,6 +53,36 @@ auto Engine::init_settings() -> Engine::Result
 		return Engine::Result::error_code::SettingsInitError;
 
 	settings = readed_settings;
+	is_headless = settings.headless.value;
+	headless_frames = settings.headless_frames.value;
+
+	return Engine::Result::error_code::Success;
+}
+
+//--headless, --frames N
+auto Engine::parse_command_line(int argc, char **argv) -> Engine::Result
+{
+	for(int i = 1; i < argc; i++)
+	{
+		string_view arg = argv[i];
+		if(arg == "--headless")
+			is_headless = true;
+		else if(arg == "--frames" && i + 1 < argc)
+		{
+			string_view value = argv[++i];
+			auto res = from_chars(value.data(), value.data() + value.size(), headless_frames);
+			if(res.ec != std::errc() || res.ptr != value.data() + value.size() || headless_frames < 0)
+			{
+				logger.log(hrs::ResultDef<Result>(Result::error_code::CommandLineError, "Bad frames count: " + string(value)));
+				return Result::error_code::CommandLineError;
+			}
+		}
+		else
+		{
+			logger.log(hrs::ResultDef<Result>(Result::error_code::CommandLineError, "Unknown argument: " + string(arg)));
+			return Result::error_code::CommandLineError;
+		}
+	}
 
 	return Engine::Result::error_code::Success;
 }
@@ -66,6 +99,12 @@ auto Engine::init_window() -> Engine::Result
 		is_run = false;
 	});
 
+	window.set_window_event_callback([&](SDL_WindowEventID event)
+	{
+		if(event == SDL_WINDOWEVENT_SIZE_CHANGED)
+			is_drawable_area_changed = true;
+	});
+
 	window.set_keyboard_key_callback([&](SDL_KeyCode key, bool is_pressed)
 	{
 		std::stringstream strstream;
@@ -98,6 +137,10 @@ auto Engine::init_window() -> Engine::Result
 				else
 					main_player.SetForwardRunState(Player::RunState::None);
 				break;
+			case SDLK_F1:
+				if(is_pressed)
+					is_frame_stats_requested = true;
+				break;
 			default:
 				break;
 		}
@@ -140,10 +183,13 @@ auto Engine::init_window() -> Engine::Result
 auto Engine::init_draw_context() -> Engine::Result
 {
     vector<const char *> extensions;
-    auto res = window.get_extensions(extensions);
-    logger.log(res);
-    if(res.error.code != SDLwindow::Result::error_code::Success)
-        return Engine::Result::error_code::DrawContextInitError;
+    if(!is_headless)
+    {
+        auto res = window.get_extensions(extensions);
+        logger.log(res);
+        if(res.error.code != SDLwindow::Result::error_code::Success)
+            return Engine::Result::error_code::DrawContextInitError;
+    }
 
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
@@ -270,17 +316,29 @@ auto Engine::init_graphics_device() -> Engine::Result
 
     auto weak_ptr_dev = create_res_exp.value();
 
-    auto bind_res = drawing_context.BindSurface<GraphicsDevice>(weak_ptr_dev);
-    if(bind_res.first.code != VulkanContext::Result::error_code::SurfaceConnectionToDevice)
+    if(is_headless)
     {
-        logger.log(bind_res.first);
-        return Engine::Result::error_code::GraphicsDeviceInitError;
+        auto headless_res = dynamic_cast<GraphicsDevice *>(weak_ptr_dev.get())->EnableHeadless();
+        if(headless_res.code != GraphicsDevice::Result::error_code::Success)
+        {
+            logger.log(headless_res);
+            return Engine::Result::error_code::GraphicsDeviceInitError;
+        }
     }
     else
     {
-        logger.log(bind_res.second);
-        if(bind_res.second.code != GraphicsDevice::Result::error_code::Success)
+        auto bind_res = drawing_context.BindSurface<GraphicsDevice>(weak_ptr_dev);
+        if(bind_res.first.code != VulkanContext::Result::error_code::SurfaceConnectionToDevice)
+        {
+            logger.log(bind_res.first);
             return Engine::Result::error_code::GraphicsDeviceInitError;
+        }
+        else
+        {
+            logger.log(bind_res.second);
+            if(bind_res.second.code != GraphicsDevice::Result::error_code::Success)
+                return Engine::Result::error_code::GraphicsDeviceInitError;
+        }
     }
 
     auto init_res = dynamic_cast<GraphicsDevice *>(weak_ptr_dev.get())->init(choosed_device.value());
@@ -303,6 +361,21 @@ auto Engine::init_graphics_device() -> Engine::Result
     return Result::error_code::Success;
 }
 
+auto Engine::get_present_mode() -> vk::PresentModeKHR
+{
+	const auto &mode = settings.present_mode.value;
+	if(mode == "immediate")
+		return vk::PresentModeKHR::eImmediate;
+	else if(mode == "fifo")
+		return vk::PresentModeKHR::eFifo;
+	else if(mode == "fifo_relaxed")
+		return vk::PresentModeKHR::eFifoRelaxed;
+	else if(mode != "mailbox")
+		logger.log("Unknown present mode " + mode + ", mailbox is used instead");
+
+	return vk::PresentModeKHR::eMailbox;
+}
+
 auto Engine::create_graphics_device_env() -> Engine::Result
 {
 	if(target_graphics_device.graphics_device->IsEnvCreated())
@@ -329,19 +402,44 @@ auto Engine::create_graphics_device_env() -> Engine::Result
         return Engine::Result::error_code::GraphicsDeviceEnvironmentCreationError;
     }
 
-	auto win_res = window.get_drawable_size(settings.window_width.value, settings.window_height.value);
-    if(win_res.code != SDLwindow::Result::error_code::Success)
-    {
-        logger.log(win_res);
-        return Engine::Result::error_code::GraphicsDeviceEnvironmentCreationError;
-    }
+    //missing optional shaders only disable features, so errors are just logged
+    auto recv_optional_shaders = target_graphics_device.graphics_device->QueryOptionalShaders();
+    res = resource_manager.LoadShaders(recv_optional_shaders);
+    if(res.error.code != ResourceManager::Result::error_code::Success)
+        logger.log(res);
+
+    vector<GraphicsDevice::LoadedShaderProps> optional_shaders;
+    optional_shaders.reserve(recv_optional_shaders.size());
+    for(size_t i = 0; i < recv_optional_shaders.size(); i++)
+        optional_shaders.push_back(GraphicsDevice::LoadedShaderProps{.name = recv_optional_shaders[i], .code = {}});
+
+    resource_manager.GetShaders(optional_shaders);
+    shaders.insert(shaders.end(), optional_shaders.begin(), optional_shaders.end());
+
+	if(!is_headless)
+	{
+		auto win_res = window.get_drawable_size(settings.window_width.value, settings.window_height.value);
+		if(win_res.code != SDLwindow::Result::error_code::Success)
+		{
+			logger.log(win_res);
+			return Engine::Result::error_code::GraphicsDeviceEnvironmentCreationError;
+		}
+	}
+
+    //unreadable cache isn't fatal either, pipelines will be just compiled from scratch
+    auto cache_res = resource_manager.LoadPipelineCache(PIPELINE_CACHE_PATH);
+    if(cache_res.error.code != ResourceManager::Result::error_code::Success)
+        logger.log(cache_res);
 
     auto env_res = target_graphics_device.graphics_device->CreateWorkEnv(GraphicsDevice::DrawableAreaParams
         {
 			.width = static_cast<uint32_t>(settings.window_width.value),
 			.height = static_cast<uint32_t>(settings.window_height.value),
-            .mode = vk::PresentModeKHR::eImmediate
-        }, shaders
+            .mode = get_present_mode(),
+            .image_count = static_cast<uint32_t>(std::max(settings.swapchain_images.value, 0))
+        }, shaders,
+        static_cast<uint32_t>(settings.frames_in_flight.value),
+        resource_manager.GetPipelineCache()
     );
 
     if(env_res.error.code != GraphicsDevice::Result::error_code::Success)
@@ -350,7 +448,158 @@ auto Engine::create_graphics_device_env() -> Engine::Result
         return Engine::Result::error_code::GraphicsDeviceEnvironmentCreationError;
     }
 
-    return Engine::Result::error_code::Success;
+    target_graphics_device.graphics_device->SetDepthPrepass(settings.depth_prepass.value);
+
+    if(!target_graphics_device.graphics_device->IsPipelineCacheLoaded())
+        logger.log("Pipeline cache is empty or incompatible with current device, pipelines are compiled from scratch");
+
+    if(!target_graphics_device.graphics_device->IsGpuCullingEnabled())
+        logger.log("GPU culling is disabled: device features or cull shader are missing");
+
+    if(!is_headless)
+        logger.log("Swapchain: " + vk::to_string(target_graphics_device.graphics_device->GetPresentMode()) +
+                   " present mode, " + std::to_string(target_graphics_device.graphics_device->GetSwapchainImageCount()) + " images");
+
+    if(!target_graphics_device.graphics_device->IsGpuProfilerEnabled())
+        logger.log("GPU profiler is disabled: graphics queue doesn't support timestamps");
+
+    //hot reload is a development convenience, failing watch doesn't stop engine
+    if(settings.shader_hot_reload.value && !is_headless)
+    {
+        auto watch_res = resource_manager.StartShaderWatch();
+        logger.log(watch_res);
+        if(watch_res.error.code == ResourceManager::Result::error_code::Success)
+            logger.log("Shaders are watched for hot reload: " + settings.shaders_path.value.string());
+    }
+
+    return create_scene();
+}
+
+auto Engine::create_scene() -> Engine::Result
+{
+	const array<Vertex, 3> triangle_vertices
+	{
+		Vertex{.position = {-0.1f, 0.1f, 0.0f}, .normal = {0.0f, 0.0f, -1.0f}, .uv = {0.0f, 0.0f}},
+		Vertex{.position = {0.1f, 0.1f, 0.0f}, .normal = {0.0f, 0.0f, -1.0f}, .uv = {1.0f, 0.0f}},
+		Vertex{.position = {0.0f, -0.1f, 0.0f}, .normal = {0.0f, 0.0f, -1.0f}, .uv = {0.5f, 1.0f}}
+	};
+	const array<uint32_t, 3> triangle_indices{0, 1, 2};
+
+	auto mesh_exp = target_graphics_device.graphics_device->AddMesh(triangle_vertices, triangle_indices);
+	if(!mesh_exp.has_value())
+	{
+		logger.log(mesh_exp.error());
+		return Engine::Result::error_code::GraphicsDeviceEnvironmentCreationError;
+	}
+
+	scene_mesh = mesh_exp.value();
+
+	//grid goes away from camera, so depth differs between rows
+	scene_transforms.clear();
+	scene_transforms.reserve(SCENE_GRID_SIZE * SCENE_GRID_SIZE);
+	for(int row = 0; row < SCENE_GRID_SIZE; row++)
+		for(int col = 0; col < SCENE_GRID_SIZE; col++)
+		{
+			auto transform = twv::glsl::Mat4x4::identity();
+			transform[3][0] = (col - SCENE_GRID_SIZE / 2) * 0.25f;
+			transform[3][1] = (row - SCENE_GRID_SIZE / 2) * 0.25f;
+			transform[3][2] = 2.0f + row * 0.5f;
+			scene_transforms.push_back(transform);
+		}
+
+	return Engine::Result::error_code::Success;
+}
+
+//the scene changes nothing but camera here, game objects would be submitted the same way
+auto Engine::submit_scene(const twv::glsl::Mat4x4 &view_proj) -> void
+{
+	if(!scene_mesh)
+		return;
+
+	for(auto &transform : scene_transforms)
+	{
+		//row vectors, origin of object is its translation row
+		auto clip = transform[3] * view_proj;
+		float depth = (clip[3] > 0.0f ? clip[2] / clip[3] : 0.0f);
+		render_queue.Submit(RenderQueue::DrawItem
+		{
+			.mesh = scene_mesh.value(),
+			.transform = transform,
+			.depth = depth
+		});
+	}
+}
+
+auto Engine::reload_changed_shaders() -> void
+{
+	auto graphics_device = target_graphics_device.graphics_device;
+	if(auto rebuild_res = graphics_device->TakePipelineRebuildResult(); rebuild_res.has_value())
+	{
+		if(rebuild_res->code == GraphicsDevice::Result::error_code::Success)
+			logger.log("Pipelines are rebuilt with reloaded shaders");
+		else
+			logger.log(rebuild_res.value());
+	}
+
+	if(!resource_manager.IsShaderWatched())
+		return;
+
+	auto changed = resource_manager.PollChangedShaders();
+	if(changed.empty())
+		return;
+
+	vector<std::string_view> names(changed.begin(), changed.end());
+	auto res = resource_manager.LoadShaders(names);
+	if(res.error.code != ResourceManager::Result::error_code::Success)
+	{
+		logger.log(res);
+		return;
+	}
+
+	vector<GraphicsDevice::LoadedShaderProps> shaders;
+	shaders.reserve(names.size());
+	for(auto &name : names)
+		shaders.push_back(GraphicsDevice::LoadedShaderProps{.name = name, .code = {}});
+
+	res = resource_manager.GetShaders(shaders);
+	if(res.error.code != ResourceManager::Result::error_code::Success)
+	{
+		logger.log(res);
+		return;
+	}
+
+	//broken shader keeps current pipelines, it's just reported
+	auto reload_res = graphics_device->ReloadShaders(shaders);
+	if(reload_res.error.code != GraphicsDevice::Result::error_code::Success)
+		logger.log(reload_res);
+}
+
+auto Engine::resize_drawable_area() -> Engine::Result
+{
+	is_drawable_area_changed = false;
+
+	auto win_res = window.get_drawable_size(settings.window_width.value, settings.window_height.value);
+	if(win_res.code != SDLwindow::Result::error_code::Success)
+	{
+		logger.log(win_res);
+		return Engine::Result::error_code::RuntimeError;
+	}
+
+	auto params = target_graphics_device.graphics_device->GetDrawableAreaParams();
+	params.width = static_cast<uint32_t>(settings.window_width.value);
+	params.height = static_cast<uint32_t>(settings.window_height.value);
+
+	auto res = target_graphics_device.graphics_device->RecreateDrawableArea(params);
+	if(res.code != GraphicsDevice::Result::error_code::Success)
+	{
+		logger.log(res);
+		return Engine::Result::error_code::RuntimeError;
+	}
+
+	if(settings.window_height.value != 0)
+		main_player.GetPOV().GetProjection() = twv::Perspective(0.1f, 100.0f, 90.0f, static_cast<float>(settings.window_width.value) / settings.window_height.value);
+
+	return Engine::Result::error_code::Success;
 }
 
 /*auto Engine::switch_graphics_device(size_t ind) -> WarningLevel
@@ -416,12 +665,27 @@ Engine::Engine()
     is_initizalized = false;
     is_run = false;
     is_settings_changed = false;
+    is_drawable_area_changed = false;
+    is_headless = false;
+    headless_frames = 0;
+    is_frame_stats_requested = false;
+    frame_stats.fill(hrs::RollingStats(FRAME_STATS_WINDOW));
 }
 
 Engine::~Engine()
 {
 	auto res = settings.write_settings("./settings.conf");
 	logger.log(res);
+
+	if(target_graphics_device.graphics_device && target_graphics_device.graphics_device->IsEnvCreated())
+	{
+		auto cache_data = target_graphics_device.graphics_device->GetPipelineCacheData();
+		if(cache_data.has_value())
+			logger.log(resource_manager.SavePipelineCache(PIPELINE_CACHE_PATH, cache_data.value()));
+		else
+			logger.log(cache_data.error());
+	}
+
     if(is_initizalized)
         logger.log("Engine terminated successfully");
 	is_run = false;
@@ -440,10 +704,17 @@ auto Engine::init(int argc, char **argv) -> Engine::Result
 {
     INIT_MODULE(init_logger)
 	INIT_MODULE(init_settings)
-    INIT_MODULE(init_window)
+
+	auto cmd_res = parse_command_line(argc, argv);
+	if(cmd_res != Result::error_code::Success)
+		return cmd_res;
+
+	if(!is_headless)
+		INIT_MODULE(init_window)
     INIT_MODULE(init_draw_context)
     INIT_MODULE(init_resource_manager)
-    INIT_MODULE(init_inter_module_connection)
+	if(!is_headless)
+		INIT_MODULE(init_inter_module_connection)
     INIT_MODULE(init_devices)
     INIT_MODULE(init_graphics_device)
     INIT_MODULE(create_graphics_device_env)
@@ -479,6 +750,9 @@ auto Engine::run() -> Engine::Result
 	twv::Print(main_player.GetPOV().GetViewRotate());
 	twv::Print(main_player.GetPOV().GetCommonMatrix());
 
+	if(is_headless)
+		return run_headless();
+
 	auto on_events_end = [&]()
 	{
 		const float delta_add = 0.001f;
@@ -513,11 +787,34 @@ auto Engine::run() -> Engine::Result
 	};
 
 
+	using clock = std::chrono::steady_clock;
+	auto ms_between = [](clock::time_point start, clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	};
+
+	frame_limiter.SetTargetRate(settings.frame_rate_limit.value);
+	auto last_timings_log = clock::now();
+	auto last_stats_log = last_timings_log;
     while(is_run)
     {
+		auto frame_start = clock::now();
         window.handle_all_events();
+		auto events_end = clock::now();
+
+		if(is_drawable_area_changed)
+		{
+			auto resize_res = resize_drawable_area();
+			if(resize_res.code != Engine::Result::error_code::Success)
+				return resize_res;
+		}
 
+		render_queue.Clear();
 		on_events_end();
+		reload_changed_shaders();
+		auto view_proj = main_player.GetPOV().GetCommonMatrix();
+		submit_scene(view_proj);
+		auto simulation_end = clock::now();
 
 
 		//rotate_matrix = twv::RotateMatrix(twv::glsl::Vec3{sinf(start_rot), cosf(start_rot), sqrtf(powf(sinf(start_rot), 2) + powf(cosf(start_rot), 2))}, start_rot);
@@ -525,7 +822,7 @@ auto Engine::run() -> Engine::Result
 
 		//twv::Print(main_player.GetPOV().GetProjection());
 		//twv::Print(main_player.GetPOV().GetView());
-		res = target_graphics_device.graphics_device->Draw(main_player.GetPOV().GetCommonMatrix());
+		res = target_graphics_device.graphics_device->DrawInstanced(view_proj, render_queue.Build());
 		//twv::Print(main_player.GetForwardDir());
 		//twv::Print(main_player.GetPOV().GetCommonMatrix());
 		//twv::Print(rotate_matrix * model_matrix * proj_matrix);
@@ -534,12 +831,196 @@ auto Engine::run() -> Engine::Result
             logger.log(res);
             return Engine::Result::error_code::RuntimeError;
         }
+
+		auto draw_end = clock::now();
+		frame_limiter.Wait();
+
+		auto now = clock::now();
+		add_frame_stats(ms_between(frame_start, events_end),
+						ms_between(events_end, simulation_end),
+						ms_between(draw_end, now),
+						ms_between(frame_start, now));
+
+		if(now - last_timings_log >= GPU_TIMINGS_LOG_INTERVAL)
+		{
+			log_gpu_timings();
+			last_timings_log = now;
+		}
+
+		if(is_frame_stats_requested || now - last_stats_log >= FRAME_STATS_LOG_INTERVAL)
+		{
+			log_frame_stats();
+			is_frame_stats_requested = false;
+			last_stats_log = now;
+		}
     }
 
     logger.log("Engine running is stoped!");
     return Engine::Result::error_code::Success;
 }
 
+//fixed frames count without window events, camera stays still
+auto Engine::run_headless() -> Engine::Result
+{
+	logger.log("Engine is running headless for " + std::to_string(headless_frames) + " frames");
+
+	//static layer holds one more scene triangle, its buffers are recorded only by the first frame of each image
+	auto *graphics_device = target_graphics_device.graphics_device;
+	auto static_transform = twv::glsl::Mat4x4::identity();
+	static_transform[3][2] = 1.5f;
+
+	const GraphicsDevice::InstancedMeshDraw static_draw
+	{
+		.mesh = scene_mesh.value(),
+		.transforms = std::span<const twv::glsl::Mat4x4>(&static_transform, 1)
+	};
+
+	//pushed camera shaders refuse static layer, scene is just not checked then
+	bool is_static_checked = false;
+	auto static_res = graphics_device->SetStaticDraws(std::span<const GraphicsDevice::InstancedMeshDraw>(&static_draw, 1));
+	if(static_res.code == GraphicsDevice::Result::error_code::Success)
+		is_static_checked = true;
+	else if(static_res.code == GraphicsDevice::Result::error_code::StaticLayerNeedsCameraBuffer)
+		logger.log(static_res);
+	else
+	{
+		logger.log(static_res);
+		return Engine::Result::error_code::RuntimeError;
+	}
+
+	int first_frames = static_cast<int>(graphics_device->GetSwapchainImageCount());
+	uint64_t static_records = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	auto view_proj = main_player.GetPOV().GetCommonMatrix();
+	for(int i = 0; i < headless_frames && is_run; i++)
+	{
+		auto frame_start = std::chrono::steady_clock::now();
+		render_queue.Clear();
+		submit_scene(view_proj);
+		auto res = graphics_device->DrawInstanced(view_proj, render_queue.Build());
+		if(res.code != GraphicsDevice::Result::error_code::Success)
+		{
+			logger.log(res);
+			return Engine::Result::error_code::RuntimeError;
+		}
+
+		add_frame_stats(0.0, 0.0, 0.0, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
+		if(i + 1 == first_frames)
+			static_records = graphics_device->GetStaticRecordCount();
+	}
+
+	//last frame is taken from GPU to be sure all frames are really done
+	if(headless_frames > 0)
+	{
+		auto readback_res = target_graphics_device.graphics_device->RequestReadback();
+		if(readback_res.code == GraphicsDevice::Result::error_code::Success)
+		{
+			render_queue.Clear();
+			submit_scene(view_proj);
+			readback_res = graphics_device->DrawInstanced(view_proj, render_queue.Build());
+		}
+
+		if(readback_res.code != GraphicsDevice::Result::error_code::Success)
+		{
+			logger.log(readback_res);
+			return Engine::Result::error_code::RuntimeError;
+		}
+
+		vector<uint8_t> pixels;
+		auto got_exp = target_graphics_device.graphics_device->WaitReadback(pixels);
+		if(!got_exp.has_value())
+		{
+			logger.log(got_exp.error());
+			return Engine::Result::error_code::RuntimeError;
+		}
+	}
+
+	//camera comes through buffer, so unchanged scene must not record anything after the first frames
+	if(is_static_checked && headless_frames > first_frames)
+	{
+		auto rerecorded = graphics_device->GetStaticRecordCount() - static_records;
+		if(rerecorded != 0)
+		{
+			logger.log("Static layer recorded " + std::to_string(rerecorded) + " secondary buffers after the first frames of unchanged scene");
+			return Engine::Result::error_code::RuntimeError;
+		}
+
+		logger.log("Static layer recorded no secondary buffers after the first frames");
+	}
+
+	graphics_device->SetStaticDraws({});
+
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::stringstream strstream;
+	strstream<<"Headless run is finished: "<<headless_frames<<" frames in "<<elapsed<<" ms";
+	if(headless_frames > 0)
+		strstream<<", "<<elapsed / (headless_frames + 1)<<" ms per frame";
+	logger.log(strstream.str());
+	log_frame_stats();
+	log_gpu_timings();
+
+	is_run = false;
+	return Engine::Result::error_code::Success;
+}
+
+auto Engine::log_gpu_timings() -> void
+{
+	auto timings = target_graphics_device.graphics_device->GetGpuTimings();
+	if(timings.empty())
+		return;
+
+	std::stringstream strstream;
+	strstream<<"GPU timings:";
+	double total = 0.0;
+	for(auto &timing : timings)
+	{
+		strstream<<" "<<timing.name<<" "<<timing.ms<<" ms |";
+		total += timing.ms;
+	}
+	strstream<<" total "<<total<<" ms";
+	logger.log(strstream.str());
+}
+
+auto Engine::add_frame_stats(double events, double simulation, double pacing, double frame) -> void
+{
+	auto &timings = target_graphics_device.graphics_device->GetLastFrameTimings();
+	auto add = [this](FrameStage stage, double ms)
+	{
+		frame_stats[static_cast<size_t>(stage)].Add(ms);
+	};
+
+	add(FrameStage::Events, events);
+	add(FrameStage::Simulation, simulation);
+	add(FrameStage::FenceWait, timings.fence_wait);
+	add(FrameStage::Acquire, timings.acquire);
+	add(FrameStage::Record, timings.record);
+	add(FrameStage::Submit, timings.submit);
+	add(FrameStage::Present, timings.present);
+	add(FrameStage::Pacing, pacing);
+	add(FrameStage::Frame, frame);
+}
+
+auto Engine::log_frame_stats() -> void
+{
+	constexpr static std::array<std::string_view, static_cast<size_t>(FrameStage::FRAME_STAGE_ENUM_MAX)> stage_names
+	{
+		"events", "simulation", "fence wait", "acquire", "record", "submit", "present", "pacing", "frame"
+	};
+
+	std::stringstream strstream;
+	strstream<<"CPU frame stats over last "<<frame_stats[0].GetCount()<<" frames, ms (min/avg/p50/p95/p99/max):";
+	strstream<<std::fixed<<std::setprecision(3);
+	for(size_t i = 0; i < frame_stats.size(); i++)
+	{
+		auto summary = frame_stats[i].GetSummary();
+		strstream<<"\n\t"<<stage_names[i]<<": "<<summary.min<<" / "<<summary.avg<<" / "<<summary.p50<<" / "
+				 <<summary.p95<<" / "<<summary.p99<<" / "<<summary.max;
+	}
+
+	logger.log(strstream.str());
+}
+
 auto Engine::get_settings() -> Settings
 {
     return settings;
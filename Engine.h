@@ -7,8 +7,13 @@
 #include "VulkanContext.h"
 #include "ResourceManager.h"
 #include "Settings.h"
+#include "RenderQueue.h"
 #include <variant>
+#include <chrono>
+#include <array>
 #include "app/Player.h"
+#include "utils/RollingStats.hpp"
+#include "utils/FrameLimiter.hpp"
 
 class Engine
 {
@@ -38,6 +43,7 @@ public:
 
 			//Init
 			SettingsInitError,
+			CommandLineError,
 			LoggerInitError,
 			WindowInitError,
 			DrawContextInitError,
@@ -69,7 +75,29 @@ public:
 
     static_assert(hrs::ResultType<Result>);
 
+	//stored next to settings.conf
+	constexpr static std::string_view PIPELINE_CACHE_PATH = "./pipeline_cache.bin";
+	constexpr static std::chrono::seconds GPU_TIMINGS_LOG_INTERVAL{1};
+	constexpr static std::chrono::seconds FRAME_STATS_LOG_INTERVAL{5};
+	constexpr static int SCENE_GRID_SIZE = 16;//objects per row and column
+	constexpr static size_t FRAME_STATS_WINDOW = 1000;//frames
+
 private:
+	enum class FrameStage : uint8_t
+	{
+		Events = 0,
+		Simulation = 1,
+		FenceWait = 2,
+		Acquire = 3,
+		Record = 4,
+		Submit = 5,
+		Present = 6,
+		Pacing = 7,
+		Frame = 8,
+
+		FRAME_STAGE_ENUM_MAX
+	};
+
 	Logger logger;
 	SDLwindow window;
 	VulkanContext drawing_context;
@@ -81,12 +109,24 @@ private:
 	bool is_run;
 	bool is_initizalized;
 	bool is_settings_changed;
+	bool is_drawable_area_changed;
+	bool is_frame_stats_requested;//dumped after current frame
+	//settings or command line, command line isn't written back to settings
+	bool is_headless;
+	int headless_frames;
 
 
 	Player main_player;
+	//grid of small triangles, each is a separate draw merged back by render_queue
+	std::optional<MeshHandle> scene_mesh;
+	std::vector<twv::glsl::Mat4x4> scene_transforms;
+	RenderQueue render_queue;//cleared and filled by submit_scene every frame
+	std::array<hrs::RollingStats, static_cast<size_t>(FrameStage::FRAME_STAGE_ENUM_MAX)> frame_stats;
+	hrs::FrameLimiter frame_limiter;
 
 private:
 	auto init_settings() -> Engine::Result;
+	auto parse_command_line(int argc, char **argv) -> Engine::Result;
 	auto init_logger() -> Engine::Result;
 	auto init_window() -> Engine::Result;
 	auto init_draw_context() -> Engine::Result;
@@ -95,6 +135,17 @@ private:
 	auto init_devices() -> Engine::Result;
 	auto init_graphics_device() -> Engine::Result;
 	auto create_graphics_device_env() -> Engine::Result;
+	auto resize_drawable_area() -> Engine::Result;
+	auto get_present_mode() -> vk::PresentModeKHR;
+	auto run_headless() -> Engine::Result;
+	auto create_scene() -> Engine::Result;
+	auto submit_scene(const twv::glsl::Mat4x4 &view_proj) -> void;
+	auto log_gpu_timings() -> void;
+	//milliseconds, device stages are taken from last draw
+	auto add_frame_stats(double events, double simulation, double pacing, double frame) -> void;
+	auto log_frame_stats() -> void;
+	//polls watched shaders and hands changed ones to device, reports finished rebuilds
+	auto reload_changed_shaders() -> void;
 	//auto switch_graphics_device(size_t ind) -> WarningLevel;
 public:
 	Engine();
@@ -142,6 +193,9 @@ constexpr auto Engine::Result::message() const -> std::string_view
             break;
 		case Result::error_code::SettingsInitError:
             res = "Settings initialization error";
+            break;
+		case Result::error_code::CommandLineError:
+            res = "Bad command line arguments";
             break;
 		case Result::error_code::LoggerInitError:
             res = "Logger initialization error";
@@ -197,6 +251,9 @@ constexpr auto Engine::Result::to_view() const -> std::string_view
             break;
 		case Result::error_code::SettingsInitError:
             res = "SettingsInitError";
+            break;
+		case Result::error_code::CommandLineError:
+            res = "CommandLineError";
             break;
 		case Result::error_code::LoggerInitError:
             res = "LoggerInitError";
@@ -0,0 +1,231 @@
+#include "FrameDataRing.h"
+#include <algorithm>
+#include <cstring>
+
+using
+    std::optional,
+    std::array;
+
+auto FrameDataRing::create_descriptors() -> vk::Result
+{
+    //data is visible to every stage, layout doesn't depend on who reads it
+    auto stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
+    array<vk::DescriptorSetLayoutBinding, 2> bindings
+    {
+        vk::DescriptorSetLayoutBinding()
+            .setBinding(UNIFORM_BINDING)
+            .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
+            .setDescriptorCount(1)
+            .setStageFlags(stages),
+        vk::DescriptorSetLayoutBinding()
+            .setBinding(STORAGE_BINDING)
+            .setDescriptorType(vk::DescriptorType::eStorageBufferDynamic)
+            .setDescriptorCount(1)
+            .setStageFlags(stages)
+    };
+
+    vk::DescriptorSetLayoutCreateInfo set_layout_info;
+    set_layout_info
+        .setFlags({})
+        .setBindings(bindings);
+
+    auto set_layout_tmp = device.createDescriptorSetLayout(set_layout_info);
+    if(set_layout_tmp.result != vk::Result::eSuccess)
+        return set_layout_tmp.result;
+
+    set_layout = set_layout_tmp.value;
+
+    array<vk::DescriptorPoolSize, 2> pool_sizes
+    {
+        vk::DescriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, 1),
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBufferDynamic, 1)
+    };
+
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info
+        .setFlags({})
+        .setMaxSets(1)
+        .setPoolSizes(pool_sizes);
+
+    auto pool_tmp = device.createDescriptorPool(pool_info);
+    if(pool_tmp.result != vk::Result::eSuccess)
+        return pool_tmp.result;
+
+    descriptor_pool = pool_tmp.value;
+
+    vk::DescriptorSetAllocateInfo set_info;
+    set_info
+        .setDescriptorPool(descriptor_pool)
+        .setSetLayouts(set_layout);
+
+    auto set_tmp = device.allocateDescriptorSets(set_info);
+    if(set_tmp.result != vk::Result::eSuccess)
+        return set_tmp.result;
+
+    descriptor_set = set_tmp.value[0];
+
+    //written once, chunks are selected only by dynamic offsets
+    vk::DescriptorBufferInfo uniform_info(buffer.buffer, 0, uniform_range);
+    vk::DescriptorBufferInfo storage_info(buffer.buffer, 0, storage_range);
+    array<vk::WriteDescriptorSet, 2> writes
+    {
+        vk::WriteDescriptorSet()
+            .setDstSet(descriptor_set)
+            .setDstBinding(UNIFORM_BINDING)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eUniformBufferDynamic)
+            .setBufferInfo(uniform_info),
+        vk::WriteDescriptorSet()
+            .setDstSet(descriptor_set)
+            .setDstBinding(STORAGE_BINDING)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eStorageBufferDynamic)
+            .setBufferInfo(storage_info)
+    };
+
+    device.updateDescriptorSets(writes, {});
+    return vk::Result::eSuccess;
+}
+
+auto FrameDataRing::init(vk::Device dev, vk::PhysicalDevice ph_dev, DeviceAllocator &alloc, uint32_t frames, vk::DeviceSize size_per_frame) -> vk::Result
+{
+    auto limits = ph_dev.getProperties().limits;
+
+    device = dev;
+    allocator = &alloc;
+    frames_count = frames;
+    alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+    frame_size = ((size_per_frame + alignment - 1) / alignment) * alignment;
+    uniform_range = std::min<vk::DeviceSize>({frame_size, limits.maxUniformBufferRange, MAX_UNIFORM_RANGE});
+    storage_range = std::min<vk::DeviceSize>(frame_size, limits.maxStorageBufferRange);
+
+    //descriptor range starts at dynamic offset, so the last chunk of the last frame needs tail.
+    //Tail is never allocated, draws without frame data are bound to it
+    vk::BufferCreateInfo buffer_info;
+    buffer_info
+        .setFlags({})
+        .setSize(frame_size * frames_count + std::max(uniform_range, storage_range))
+        .setUsage(vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer)
+        .setSharingMode(vk::SharingMode::eExclusive);
+
+    auto buffer_tmp = allocator->CreateBuffer(buffer_info,
+                                              vk::MemoryPropertyFlagBits::eHostVisible,
+                                              vk::MemoryPropertyFlagBits::eDeviceLocal);
+    if(!buffer_tmp.has_value())
+    {
+        allocator = nullptr;
+        return buffer_tmp.error();
+    }
+
+    buffer = buffer_tmp.value();
+
+    vk::DeviceSize tail_size = buffer_info.size - GetEmptyOffset();
+    std::memset(static_cast<uint8_t *>(buffer.allocation.mapped_ptr) + GetEmptyOffset(), 0, tail_size);
+    auto res = allocator->Flush(buffer.allocation, GetEmptyOffset(), tail_size);
+    if(res != vk::Result::eSuccess)
+    {
+        destroy();
+        return res;
+    }
+
+    res = create_descriptors();
+    if(res != vk::Result::eSuccess)
+    {
+        destroy();
+        return res;
+    }
+
+    current_frame.reset();
+    return vk::Result::eSuccess;
+}
+
+auto FrameDataRing::destroy() -> void
+{
+    if(!allocator)
+        return;
+
+    device.destroy(descriptor_pool);
+    device.destroy(set_layout);
+    descriptor_pool = vk::DescriptorPool();
+    descriptor_set = vk::DescriptorSet();
+    set_layout = vk::DescriptorSetLayout();
+
+    allocator->DestroyBuffer(buffer);
+    allocator = nullptr;
+    current_frame.reset();
+}
+
+auto FrameDataRing::is_inited() const -> bool
+{
+    return allocator != nullptr;
+}
+
+auto FrameDataRing::BeginFrame(uint32_t frame_ind) -> void
+{
+    current_frame = frame_ind;
+    head = frame_size * frame_ind;
+    flushed = head;
+}
+
+auto FrameDataRing::EndFrame() -> vk::Result
+{
+    if(!current_frame)
+        return vk::Result::eSuccess;
+
+    current_frame.reset();
+    if(head == flushed)
+        return vk::Result::eSuccess;
+
+    return allocator->Flush(buffer.allocation, flushed, head - flushed);
+}
+
+auto FrameDataRing::IsFrameBegun() const -> bool
+{
+    return current_frame.has_value();
+}
+
+auto FrameDataRing::Allocate(vk::DeviceSize size) -> optional<Chunk>
+{
+    if(!current_frame || size == 0)
+        return {};
+
+    vk::DeviceSize aligned_size = ((size + alignment - 1) / alignment) * alignment;
+    vk::DeviceSize frame_end = frame_size * (current_frame.value() + 1);
+    if(head + aligned_size > frame_end)
+        return {};
+
+    Chunk chunk
+    {
+        .ptr = static_cast<uint8_t *>(buffer.allocation.mapped_ptr) + head,
+        .offset = static_cast<uint32_t>(head),
+        .size = static_cast<uint32_t>(size)
+    };
+
+    head += aligned_size;
+    return chunk;
+}
+
+auto FrameDataRing::GetSetLayout() const -> vk::DescriptorSetLayout
+{
+    return set_layout;
+}
+
+auto FrameDataRing::GetDescriptorSet() const -> vk::DescriptorSet
+{
+    return descriptor_set;
+}
+
+auto FrameDataRing::GetEmptyOffset() const -> uint32_t
+{
+    return static_cast<uint32_t>(frame_size * frames_count);
+}
+
+auto FrameDataRing::GetUniformRange() const -> vk::DeviceSize
+{
+    return uniform_range;
+}
+
+auto FrameDataRing::GetStorageRange() const -> vk::DeviceSize
+{
+    return storage_range;
+}
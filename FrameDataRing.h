@@ -0,0 +1,68 @@
+#pragma once
+
+#include <optional>
+#include "VulkanInclude.h"
+#include "DeviceAllocator.h"
+
+//Persistently mapped buffer split into one region per frame in flight.
+//Region of frame slot is reused only after slot's fence is signaled, so chunks are just bump allocated
+//and shaders address them through dynamic offsets of the single descriptor set.
+class FrameDataRing
+{
+public:
+    constexpr static vk::DeviceSize DEFAULT_FRAME_SIZE = 1024 * 1024;
+    constexpr static uint32_t UNIFORM_BINDING = 0;
+    constexpr static uint32_t STORAGE_BINDING = 1;
+    constexpr static uint32_t MAX_UNIFORM_RANGE = 64 * 1024;
+
+    struct Chunk
+    {
+        void *ptr;
+        uint32_t offset;//dynamic offset of uniform or storage binding
+        uint32_t size;
+    };
+
+private:
+    vk::Device device;
+    DeviceAllocator *allocator = nullptr;
+    DeviceAllocator::BufferAllocation buffer;
+
+    vk::DeviceSize alignment = 1;
+    vk::DeviceSize frame_size = 0;
+    uint32_t frames_count = 0;
+    vk::DeviceSize uniform_range = 0;
+    vk::DeviceSize storage_range = 0;
+
+    std::optional<uint32_t> current_frame;
+    vk::DeviceSize head = 0;
+    vk::DeviceSize flushed = 0;
+
+    vk::DescriptorSetLayout set_layout;
+    vk::DescriptorPool descriptor_pool;
+    vk::DescriptorSet descriptor_set;
+
+    auto create_descriptors() -> vk::Result;
+public:
+    FrameDataRing() = default;
+    FrameDataRing(const FrameDataRing &fdr) = delete;
+    ~FrameDataRing() = default;
+
+    auto init(vk::Device dev, vk::PhysicalDevice ph_dev, DeviceAllocator &alloc, uint32_t frames, vk::DeviceSize size_per_frame = DEFAULT_FRAME_SIZE) -> vk::Result;
+    auto destroy() -> void;
+    auto is_inited() const -> bool;
+
+    //region of frame_ind must be free, i.e. its fence is already waited
+    auto BeginFrame(uint32_t frame_ind) -> void;
+    //flushes written data, chunks of this frame can't be allocated after it
+    auto EndFrame() -> vk::Result;
+    auto IsFrameBegun() const -> bool;
+
+    auto Allocate(vk::DeviceSize size) -> std::optional<Chunk>;
+
+    auto GetSetLayout() const -> vk::DescriptorSetLayout;
+    auto GetDescriptorSet() const -> vk::DescriptorSet;
+    //zeroed region no frame writes, valid dynamic offset for both bindings
+    auto GetEmptyOffset() const -> uint32_t;
+    auto GetUniformRange() const -> vk::DeviceSize;
+    auto GetStorageRange() const -> vk::DeviceSize;
+};
@@ -0,0 +1,484 @@
+#include "GpuCulling.h"
+#include "math/Math.hpp"
+#include <cstring>
+#include <algorithm>
+#include <bit>
+
+using
+    std::optional,
+    std::vector,
+    std::array;
+
+auto GpuCulling::create_buffers() -> vk::Result
+{
+    struct buffer_desc
+    {
+        DeviceAllocator::BufferAllocation *target;
+        vk::DeviceSize size;
+        vk::BufferUsageFlags usage;
+    };
+
+    array<buffer_desc, 4> descs
+    {
+        buffer_desc{&objects_buffer,
+                    static_cast<vk::DeviceSize>(capacity) * sizeof(GpuObject),
+                    vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst},
+        buffer_desc{&transforms_buffer,
+                    static_cast<vk::DeviceSize>(capacity) * sizeof(twv::glsl::Mat4x4),
+                    vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst},
+        buffer_desc{&commands_buffer,
+                    static_cast<vk::DeviceSize>(capacity) * sizeof(vk::DrawIndexedIndirectCommand),
+                    vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer},
+        buffer_desc{&count_buffer,
+                    sizeof(uint32_t),
+                    vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst}
+    };
+
+    for(auto &desc : descs)
+    {
+        vk::BufferCreateInfo buffer_info;
+        buffer_info
+            .setFlags({})
+            .setSize(desc.size)
+            .setUsage(desc.usage)
+            .setSharingMode(vk::SharingMode::eExclusive);
+
+        auto buffer_tmp = allocator->CreateBuffer(buffer_info, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        if(!buffer_tmp.has_value())
+            return buffer_tmp.error();
+
+        *desc.target = buffer_tmp.value();
+    }
+
+    return vk::Result::eSuccess;
+}
+
+auto GpuCulling::create_pipeline(vk::ShaderModule cull_shader, vk::PipelineCache cache) -> vk::Result
+{
+    array<vk::DescriptorSetLayoutBinding, 3> bindings;
+    for(uint32_t i = 0; i < bindings.size(); i++)
+    {
+        bindings[i]
+            .setBinding(i)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setDescriptorCount(1)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    }
+
+    vk::DescriptorSetLayoutCreateInfo set_layout_info;
+    set_layout_info
+        .setFlags({})
+        .setBindings(bindings);
+
+    auto set_layout_tmp = device.createDescriptorSetLayout(set_layout_info);
+    if(set_layout_tmp.result != vk::Result::eSuccess)
+        return set_layout_tmp.result;
+
+    set_layout = set_layout_tmp.value;
+
+    vk::DescriptorPoolSize pool_size(vk::DescriptorType::eStorageBuffer, bindings.size());
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info
+        .setFlags({})
+        .setMaxSets(1)
+        .setPoolSizes(pool_size);
+
+    auto pool_tmp = device.createDescriptorPool(pool_info);
+    if(pool_tmp.result != vk::Result::eSuccess)
+        return pool_tmp.result;
+
+    descriptor_pool = pool_tmp.value;
+
+    vk::DescriptorSetAllocateInfo set_info;
+    set_info
+        .setDescriptorPool(descriptor_pool)
+        .setSetLayouts(set_layout);
+
+    auto set_tmp = device.allocateDescriptorSets(set_info);
+    if(set_tmp.result != vk::Result::eSuccess)
+        return set_tmp.result;
+
+    descriptor_set = set_tmp.value[0];
+
+    array<vk::DescriptorBufferInfo, 3> buffer_infos
+    {
+        vk::DescriptorBufferInfo(objects_buffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(commands_buffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(count_buffer.buffer, 0, VK_WHOLE_SIZE)
+    };
+
+    array<vk::WriteDescriptorSet, 3> writes;
+    for(uint32_t i = 0; i < writes.size(); i++)
+    {
+        writes[i]
+            .setDstSet(descriptor_set)
+            .setDstBinding(i)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setBufferInfo(buffer_infos[i]);
+    }
+
+    device.updateDescriptorSets(writes, {});
+
+    vk::PushConstantRange push_constant;
+    push_constant
+        .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+        .setSize(sizeof(CullPushConstants))
+        .setOffset(0);
+
+    vk::PipelineLayoutCreateInfo ppl_layout_info;
+    ppl_layout_info
+        .setFlags({})
+        .setSetLayouts(set_layout)
+        .setPushConstantRanges(push_constant);
+
+    auto ppl_layout_tmp = device.createPipelineLayout(ppl_layout_info);
+    if(ppl_layout_tmp.result != vk::Result::eSuccess)
+        return ppl_layout_tmp.result;
+
+    ppl_layout = ppl_layout_tmp.value;
+
+    vk::ComputePipelineCreateInfo ppl_info;
+    ppl_info
+        .setFlags({})
+        .setStage(vk::PipelineShaderStageCreateInfo()
+                    .setFlags({})
+                    .setStage(vk::ShaderStageFlagBits::eCompute)
+                    .setModule(cull_shader)
+                    .setPName("main"))
+        .setLayout(ppl_layout);
+
+    auto ppl_tmp = device.createComputePipelines(cache, ppl_info);
+    if(ppl_tmp.result != vk::Result::eSuccess)
+        return ppl_tmp.result;
+
+    ppl = ppl_tmp.value[0];
+    return vk::Result::eSuccess;
+}
+
+auto GpuCulling::reserve_staging(FrameStaging &staging, vk::DeviceSize size) -> vk::Result
+{
+    if(size <= staging.capacity)
+        return vk::Result::eSuccess;
+
+    vk::DeviceSize new_capacity = std::bit_ceil(size);
+
+    vk::BufferCreateInfo staging_info;
+    staging_info
+        .setFlags({})
+        .setSize(new_capacity)
+        .setUsage(vk::BufferUsageFlagBits::eTransferSrc)
+        .setSharingMode(vk::SharingMode::eExclusive);
+
+    auto staging_tmp = allocator->CreateBuffer(staging_info, vk::MemoryPropertyFlagBits::eHostVisible);
+    if(!staging_tmp.has_value())
+        return staging_tmp.error();
+
+    //frame slot is already waited, old staging isn't read by GPU
+    allocator->DestroyBuffer(staging.buffer);
+    staging.buffer = staging_tmp.value();
+    staging.capacity = new_capacity;
+    return vk::Result::eSuccess;
+}
+
+auto GpuCulling::mark_dirty(uint32_t id) -> void
+{
+    if(is_dirty[id])
+        return;
+
+    is_dirty[id] = true;
+    dirty_ids.push_back(id);
+}
+
+auto GpuCulling::init(vk::Device dev,
+                      DeviceAllocator &alloc,
+                      vk::ShaderModule cull_shader,
+                      vk::PipelineCache cache,
+                      uint32_t frames_count,
+                      bool draw_count_supported,
+                      uint32_t object_capacity) -> vk::Result
+{
+    device = dev;
+    allocator = &alloc;
+    has_draw_count = draw_count_supported;
+    capacity = object_capacity;
+
+    auto res = create_buffers();
+    if(res == vk::Result::eSuccess)
+        res = create_pipeline(cull_shader, cache);
+
+    if(res != vk::Result::eSuccess)
+    {
+        destroy();
+        return res;
+    }
+
+    frames_staging.resize(frames_count);
+    return vk::Result::eSuccess;
+}
+
+auto GpuCulling::destroy() -> void
+{
+    if(!allocator)
+        return;
+
+    device.destroy(ppl);
+    device.destroy(ppl_layout);
+    device.destroy(descriptor_pool);
+    device.destroy(set_layout);
+    ppl = vk::Pipeline();
+    ppl_layout = vk::PipelineLayout();
+    descriptor_pool = vk::DescriptorPool();
+    descriptor_set = vk::DescriptorSet();
+    set_layout = vk::DescriptorSetLayout();
+
+    allocator->DestroyBuffer(objects_buffer);
+    allocator->DestroyBuffer(transforms_buffer);
+    allocator->DestroyBuffer(commands_buffer);
+    allocator->DestroyBuffer(count_buffer);
+    for(auto &staging : frames_staging)
+        allocator->DestroyBuffer(staging.buffer);
+
+    frames_staging.clear();
+    objects.clear();
+    transforms.clear();
+    free_ids.clear();
+    dirty_ids.clear();
+    is_dirty.clear();
+    object_count = 0;
+    capacity = 0;
+    allocator = nullptr;
+    device = vk::Device();
+}
+
+auto GpuCulling::is_inited() const -> bool
+{
+    return allocator != nullptr;
+}
+
+auto GpuCulling::AddObject(const MeshHandle &mesh, const twv::glsl::Mat4x4 &transform, const twv::glsl::Vec4 &bounding_sphere) -> optional<uint32_t>
+{
+    if(mesh.index_count == 0)
+        return {};
+
+    uint32_t id;
+    if(!free_ids.empty())
+    {
+        id = free_ids.back();
+        free_ids.pop_back();
+    }
+    else if(object_count < capacity)
+    {
+        id = object_count++;
+        objects.emplace_back();
+        transforms.emplace_back();
+        is_dirty.push_back(false);
+    }
+    else
+        return {};
+
+    objects[id] = GpuObject
+    {
+        .bounding_sphere = bounding_sphere,
+        .index_count = mesh.index_count,
+        .first_index = mesh.first_index,
+        .vertex_offset = mesh.vertex_offset
+    };
+    transforms[id] = transform;
+    mark_dirty(id);
+
+    return id;
+}
+
+auto GpuCulling::UpdateObject(uint32_t id, const twv::glsl::Mat4x4 &transform, const twv::glsl::Vec4 &bounding_sphere) -> bool
+{
+    if(id >= object_count || objects[id].index_count == 0)
+        return false;
+
+    objects[id].bounding_sphere = bounding_sphere;
+    transforms[id] = transform;
+    mark_dirty(id);
+    return true;
+}
+
+auto GpuCulling::RemoveObject(uint32_t id) -> bool
+{
+    if(id >= object_count || objects[id].index_count == 0)
+        return false;
+
+    //zero index count is skipped by cull shader, slot is reused by next AddObject
+    objects[id] = GpuObject{};
+    mark_dirty(id);
+    free_ids.push_back(id);
+    return true;
+}
+
+auto GpuCulling::PrepareUpdates(uint32_t frame_ind) -> vk::Result
+{
+    transform_regions.clear();
+    object_regions.clear();
+    upload_frame_ind = frame_ind;
+
+    if(dirty_ids.empty())
+        return vk::Result::eSuccess;
+
+    std::sort(dirty_ids.begin(), dirty_ids.end());
+
+    //staging: [dirty transforms][dirty objects], neighbour ids are merged into one region
+    auto &staging = frames_staging[frame_ind];
+    vk::DeviceSize transforms_size = dirty_ids.size() * sizeof(twv::glsl::Mat4x4);
+    auto res = reserve_staging(staging, transforms_size + dirty_ids.size() * sizeof(GpuObject));
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    auto staging_ptr = static_cast<uint8_t *>(staging.buffer.allocation.mapped_ptr);
+    size_t run_begin = 0;
+    while(run_begin < dirty_ids.size())
+    {
+        size_t run_end = run_begin + 1;
+        while(run_end < dirty_ids.size() && dirty_ids[run_end] == dirty_ids[run_end - 1] + 1)
+            run_end++;
+
+        uint32_t first_id = dirty_ids[run_begin];
+        size_t run_len = run_end - run_begin;
+
+        vk::DeviceSize transform_src = run_begin * sizeof(twv::glsl::Mat4x4);
+        vk::DeviceSize object_src = transforms_size + run_begin * sizeof(GpuObject);
+        std::memcpy(staging_ptr + transform_src, &transforms[first_id], run_len * sizeof(twv::glsl::Mat4x4));
+        std::memcpy(staging_ptr + object_src, &objects[first_id], run_len * sizeof(GpuObject));
+
+        transform_regions.push_back(vk::BufferCopy(transform_src, first_id * sizeof(twv::glsl::Mat4x4), run_len * sizeof(twv::glsl::Mat4x4)));
+        object_regions.push_back(vk::BufferCopy(object_src, first_id * sizeof(GpuObject), run_len * sizeof(GpuObject)));
+
+        run_begin = run_end;
+    }
+
+    res = allocator->Flush(staging.buffer.allocation);
+    if(res != vk::Result::eSuccess)
+    {
+        transform_regions.clear();
+        object_regions.clear();
+        return res;
+    }
+
+    for(auto id : dirty_ids)
+        is_dirty[id] = false;
+
+    dirty_ids.clear();
+    return vk::Result::eSuccess;
+}
+
+auto GpuCulling::RecordUpdates(vk::CommandBuffer buf) -> void
+{
+    if(transform_regions.empty())
+        return;
+
+    //previous frames may still read old objects in cull shader and old transforms as instances
+    buf.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eVertexInput,
+                        vk::PipelineStageFlagBits::eTransfer,
+                        {},
+                        {},
+                        {},
+                        {});
+
+    auto staging_buffer = frames_staging[upload_frame_ind].buffer.buffer;
+    buf.copyBuffer(staging_buffer, transforms_buffer.buffer, transform_regions);
+    buf.copyBuffer(staging_buffer, objects_buffer.buffer, object_regions);
+
+    vk::MemoryBarrier upload_barrier;
+    upload_barrier
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eVertexAttributeRead);
+
+    buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eVertexInput,
+                        {},
+                        upload_barrier,
+                        {},
+                        {});
+
+    transform_regions.clear();
+    object_regions.clear();
+}
+
+auto GpuCulling::RecordCulling(vk::CommandBuffer buf, const twv::glsl::Mat4x4 &view_proj) -> void
+{
+    if(has_draw_count)
+    {
+        buf.fillBuffer(count_buffer.buffer, 0, sizeof(uint32_t), 0);
+
+        vk::MemoryBarrier clear_barrier;
+        clear_barrier
+            .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
+        buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                            vk::PipelineStageFlagBits::eComputeShader,
+                            {},
+                            clear_barrier,
+                            {},
+                            {});
+    }
+
+    if(object_count == 0)
+        return;
+
+    CullPushConstants push_constants;
+    auto planes = twv::FrustumPlanes(view_proj);
+    std::copy(planes.begin(), planes.end(), push_constants.planes);
+    push_constants.object_count = object_count;
+    push_constants.compact = (has_draw_count ? 1 : 0);
+
+    buf.bindPipeline(vk::PipelineBindPoint::eCompute, ppl);
+    buf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, ppl_layout, 0, descriptor_set, {});
+    buf.pushConstants(ppl_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPushConstants), &push_constants);
+    buf.dispatch((object_count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+}
+
+auto GpuCulling::RecordDraw(vk::CommandBuffer buf, uint32_t instance_binding) -> void
+{
+    if(object_count == 0)
+        return;
+
+    //mesh vertex and index buffers are bound by caller
+    buf.bindVertexBuffers(instance_binding, transforms_buffer.buffer, vk::DeviceSize(0));
+    if(has_draw_count)
+    {
+        buf.drawIndexedIndirectCount(commands_buffer.buffer,
+                                     0,
+                                     count_buffer.buffer,
+                                     0,
+                                     object_count,
+                                     sizeof(vk::DrawIndexedIndirectCommand));
+    }
+    else
+    {
+        //culled objects are written with zero instance count
+        buf.drawIndexedIndirect(commands_buffer.buffer, 0, object_count, sizeof(vk::DrawIndexedIndirectCommand));
+    }
+}
+
+auto GpuCulling::GetObjectCount() const -> uint32_t
+{
+    return object_count;
+}
+
+auto GpuCulling::GetCapacity() const -> uint32_t
+{
+    return capacity;
+}
+
+auto GpuCulling::IsDrawCountSupported() const -> bool
+{
+    return has_draw_count;
+}
+
+auto GpuCulling::GetCommandsBuffer() const -> vk::Buffer
+{
+    return commands_buffer.buffer;
+}
+
+auto GpuCulling::GetCountBuffer() const -> vk::Buffer
+{
+    return count_buffer.buffer;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include "VulkanInclude.h"
+#include "DeviceAllocator.h"
+#include "MeshStorage.h"
+#include "math/Mat.hpp"
+
+//GPU-driven frustum culling: objects live in device buffers, compute shader tests their bounding spheres
+//and writes survivors into indirect draw commands, so CPU cost of frame doesn't depend on objects count.
+//Only changed objects are uploaded, through per-frame staging buffer.
+class GpuCulling
+{
+public:
+    constexpr static uint32_t DEFAULT_OBJECT_CAPACITY = 1 << 17;
+    constexpr static uint32_t WORKGROUP_SIZE = 64;//local_size_x of cull shader
+
+    //cull_objects.comp bindings
+    constexpr static uint32_t OBJECTS_BINDING = 0;
+    constexpr static uint32_t COMMANDS_BINDING = 1;
+    constexpr static uint32_t COUNT_BINDING = 2;
+
+private:
+    //std430 layout of Object in cull_objects.comp
+    struct GpuObject
+    {
+        twv::glsl::Vec4 bounding_sphere;//world space center + radius
+        uint32_t index_count = 0;//0 - free slot, never drawn
+        uint32_t first_index = 0;
+        int32_t vertex_offset = 0;
+        uint32_t padding = 0;
+    };
+
+    struct CullPushConstants
+    {
+        twv::glsl::Vec4 planes[6];
+        uint32_t object_count;
+        uint32_t compact;//1 - survivors are packed and counted, 0 - every object writes own command
+    };
+
+    struct FrameStaging
+    {
+        DeviceAllocator::BufferAllocation buffer;
+        vk::DeviceSize capacity = 0;
+    };
+
+    vk::Device device;
+    DeviceAllocator *allocator = nullptr;
+    bool has_draw_count = false;
+    uint32_t capacity = 0;
+
+    DeviceAllocator::BufferAllocation objects_buffer;
+    DeviceAllocator::BufferAllocation transforms_buffer;//also per-instance vertex buffer, firstInstance = object id
+    DeviceAllocator::BufferAllocation commands_buffer;
+    DeviceAllocator::BufferAllocation count_buffer;
+
+    vk::DescriptorSetLayout set_layout;
+    vk::DescriptorPool descriptor_pool;
+    vk::DescriptorSet descriptor_set;
+    vk::PipelineLayout ppl_layout;
+    vk::Pipeline ppl;
+
+    //CPU mirror, dirty objects are copied from here
+    std::vector<GpuObject> objects;
+    std::vector<twv::glsl::Mat4x4> transforms;
+    std::vector<uint32_t> free_ids;
+    std::vector<uint32_t> dirty_ids;
+    std::vector<bool> is_dirty;
+    uint32_t object_count = 0;//high water mark of used ids
+
+    std::vector<FrameStaging> frames_staging;
+    //filled by PrepareUpdates, consumed by RecordUpdates
+    std::vector<vk::BufferCopy> transform_regions;
+    std::vector<vk::BufferCopy> object_regions;
+    uint32_t upload_frame_ind = 0;
+
+    auto create_buffers() -> vk::Result;
+    auto create_pipeline(vk::ShaderModule cull_shader, vk::PipelineCache cache) -> vk::Result;
+    auto reserve_staging(FrameStaging &staging, vk::DeviceSize size) -> vk::Result;
+    auto mark_dirty(uint32_t id) -> void;
+public:
+    GpuCulling() = default;
+    GpuCulling(const GpuCulling &gc) = delete;
+    ~GpuCulling() = default;
+
+    auto init(vk::Device dev,
+              DeviceAllocator &alloc,
+              vk::ShaderModule cull_shader,
+              vk::PipelineCache cache,
+              uint32_t frames_count,
+              bool draw_count_supported,
+              uint32_t object_capacity = DEFAULT_OBJECT_CAPACITY) -> vk::Result;
+    auto destroy() -> void;
+    auto is_inited() const -> bool;
+
+    auto AddObject(const MeshHandle &mesh, const twv::glsl::Mat4x4 &transform, const twv::glsl::Vec4 &bounding_sphere) -> std::optional<uint32_t>;
+    auto UpdateObject(uint32_t id, const twv::glsl::Mat4x4 &transform, const twv::glsl::Vec4 &bounding_sphere) -> bool;
+    auto RemoveObject(uint32_t id) -> bool;
+
+    //fills staging of frame slot, slot must be already waited
+    auto PrepareUpdates(uint32_t frame_ind) -> vk::Result;
+    //all three must be recorded in this order into the same command buffer, first two outside of renderpass.
+    //Commands and count buffers aren't synchronized with previous and next use, caller must order
+    //DrawIndirect reads against RecordCulling writes (see GetCommandsBuffer/GetCountBuffer)
+    auto RecordUpdates(vk::CommandBuffer buf) -> void;
+    auto RecordCulling(vk::CommandBuffer buf, const twv::glsl::Mat4x4 &view_proj) -> void;
+    auto RecordDraw(vk::CommandBuffer buf, uint32_t instance_binding) -> void;
+
+    auto GetObjectCount() const -> uint32_t;
+    auto GetCapacity() const -> uint32_t;
+    auto IsDrawCountSupported() const -> bool;
+    auto GetCommandsBuffer() const -> vk::Buffer;
+    auto GetCountBuffer() const -> vk::Buffer;
+};
@@ -0,0 +1,120 @@
+#include "GpuProfiler.h"
+
+auto GpuProfiler::init(vk::Device dev, float timestamp_period, uint32_t timestamp_valid_bits, uint32_t frames_count) -> vk::Result
+{
+    if(timestamp_valid_bits == 0)
+        return vk::Result::eErrorFeatureNotPresent;
+
+    device = dev;
+    ns_per_tick = timestamp_period;
+    valid_mask = (timestamp_valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << timestamp_valid_bits) - 1);
+
+    vk::QueryPoolCreateInfo pool_info;
+    pool_info
+        .setQueryType(vk::QueryType::eTimestamp)
+        .setQueryCount(MAX_SCOPES * 2);
+
+    frames.resize(frames_count);
+    for(auto &frame : frames)
+    {
+        auto pool_res = device.createQueryPool(pool_info);
+        if(pool_res.result != vk::Result::eSuccess)
+        {
+            destroy();
+            return pool_res.result;
+        }
+
+        frame.pool = pool_res.value;
+        frame.names.reserve(MAX_SCOPES);
+    }
+
+    raw_results.resize(MAX_SCOPES * 2);
+    return vk::Result::eSuccess;
+}
+
+auto GpuProfiler::destroy() -> void
+{
+    if(!device)
+        return;
+
+    for(auto &frame : frames)
+        device.destroy(frame.pool);
+
+    frames.clear();
+    raw_results.clear();
+    last_timings.clear();
+    current_frame = 0;
+    device = vk::Device();
+}
+
+auto GpuProfiler::is_inited() const -> bool
+{
+    return static_cast<bool>(device);
+}
+
+auto GpuProfiler::BeginFrame(vk::CommandBuffer buf, uint32_t frame_ind) -> vk::Result
+{
+    if(!is_inited())
+        return vk::Result::eSuccess;
+
+    current_frame = frame_ind;
+    auto &frame = frames[frame_ind];
+    if(frame.is_recorded && !frame.names.empty())
+    {
+        //previous submit of slot is done, so no wait flag: eNotReady means some scope wasn't written
+        uint32_t query_count = frame.names.size() * 2;
+        auto res = device.getQueryPoolResults(frame.pool,
+                                              0,
+                                              query_count,
+                                              query_count * sizeof(uint64_t),
+                                              raw_results.data(),
+                                              sizeof(uint64_t),
+                                              vk::QueryResultFlagBits::e64);
+        if(res == vk::Result::eSuccess)
+        {
+            last_timings.resize(frame.names.size());
+            for(size_t i = 0; i < frame.names.size(); i++)
+            {
+                uint64_t ticks = (raw_results[i * 2 + 1] - raw_results[i * 2]) & valid_mask;
+                last_timings[i].name = frame.names[i];
+                last_timings[i].ms = ticks * ns_per_tick / 1'000'000.0;
+            }
+        }
+        else if(res != vk::Result::eNotReady)
+            return res;
+    }
+
+    frame.names.clear();
+    frame.is_recorded = true;
+    buf.resetQueryPool(frame.pool, 0, MAX_SCOPES * 2);
+    return vk::Result::eSuccess;
+}
+
+auto GpuProfiler::BeginScope(vk::CommandBuffer buf, std::string_view name) -> GpuProfiler::ScopeId
+{
+    if(!is_inited())
+        return INVALID_SCOPE;
+
+    auto &frame = frames[current_frame];
+    if(frame.names.size() == MAX_SCOPES)
+        return INVALID_SCOPE;
+
+    ScopeId scope = frame.names.size();
+    frame.names.emplace_back(name);
+    buf.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame.pool, scope * 2);
+    return scope;
+}
+
+auto GpuProfiler::EndScope(vk::CommandBuffer buf, ScopeId scope) -> void
+{
+    if(scope == INVALID_SCOPE)
+        return;
+
+    //written when all previous commands are complete
+    buf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frames[current_frame].pool, scope * 2 + 1);
+}
+
+auto GpuProfiler::GetLastTimings() const -> std::span<const ScopeTiming>
+{
+    return last_timings;
+}
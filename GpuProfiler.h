@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <span>
+#include "VulkanInclude.h"
+
+//GPU timings of named scopes through timestamp queries. Every frame slot has own query pool,
+//results are read when slot is reused, i.e. after its fence is waited, so reading never stalls.
+class GpuProfiler
+{
+public:
+    constexpr static uint32_t MAX_SCOPES = 32;
+
+    using ScopeId = uint32_t;
+    constexpr static ScopeId INVALID_SCOPE = ~ScopeId(0);
+
+    struct ScopeTiming
+    {
+        std::string name;
+        double ms = 0.0;
+    };
+
+private:
+    struct FrameQueries
+    {
+        vk::QueryPool pool;
+        std::vector<std::string> names;//names[i] - scope with queries 2 * i and 2 * i + 1
+        bool is_recorded = false;
+    };
+
+    vk::Device device;
+    double ns_per_tick = 0.0;
+    uint64_t valid_mask = 0;
+
+    std::vector<FrameQueries> frames;
+    uint32_t current_frame = 0;
+    std::vector<uint64_t> raw_results;
+    std::vector<ScopeTiming> last_timings;
+public:
+    GpuProfiler() = default;
+    GpuProfiler(const GpuProfiler &gp) = delete;
+    ~GpuProfiler() = default;
+
+    //timestamp_valid_bits - of the queue profiled buffers are submitted to, 0 means no timestamps
+    auto init(vk::Device dev, float timestamp_period, uint32_t timestamp_valid_bits, uint32_t frames_count) -> vk::Result;
+    auto destroy() -> void;
+    auto is_inited() const -> bool;
+
+    //slot must be already waited: reads its previous results and records reset of its queries,
+    //must be recorded outside of renderpass before any scope of frame
+    auto BeginFrame(vk::CommandBuffer buf, uint32_t frame_ind) -> vk::Result;
+    //scopes past MAX_SCOPES are silently dropped
+    auto BeginScope(vk::CommandBuffer buf, std::string_view name) -> ScopeId;
+    auto EndScope(vk::CommandBuffer buf, ScopeId scope) -> void;
+
+    //latest resolved frame, frames in flight behind the one being recorded
+    auto GetLastTimings() const -> std::span<const ScopeTiming>;
+};
@@ -1,5 +1,9 @@
 #include <chrono>
 #include <cstring>
+#include <algorithm>
+#include <bit>
+#include <thread>
+#include <future>
 //#include "VulkanInclude.h"
 #include "GraphicsDevice.h"
 #include <limits>
@@ -19,7 +23,33 @@ using
     std::remove_reference_t,
     std::array;
 
-auto GraphicsDevice::create_swapchain(uint32_t width, uint32_t height, vk::PresentModeKHR mode) -> GraphicsDevice::Result
+struct NecessaryShaderInfo
+{
+    string_view name;
+    vk::ShaderStageFlagBits stage;
+};
+
+//stages of main pipelines, vertex shader goes first
+static constexpr array<NecessaryShaderInfo, 2> NECESSARY_SHADERS
+{
+    NecessaryShaderInfo{"vertex_shader_test.spv", vk::ShaderStageFlagBits::eVertex},
+    NecessaryShaderInfo{"fragment_shader_test.spv", vk::ShaderStageFlagBits::eFragment}
+};
+
+//combined formats must be transitioned and viewed with both aspects
+static auto depth_aspect(vk::Format format) -> vk::ImageAspectFlags
+{
+    if(format == vk::Format::eD16Unorm || format == vk::Format::eD32Sfloat || format == vk::Format::eX8D24UnormPack32)
+        return vk::ImageAspectFlagBits::eDepth;
+
+    return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+}
+
+auto GraphicsDevice::create_swapchain(uint32_t width,
+                                      uint32_t height,
+                                      vk::PresentModeKHR mode,
+                                      uint32_t image_count,
+                                      vk::SwapchainKHR old_swapchain) -> GraphicsDevice::Result
 {
     //if(draw_surface.expired())
      //   return Result::error_code::SurfaceNotConnected;
@@ -54,13 +84,11 @@ auto GraphicsDevice::create_swapchain(uint32_t width, uint32_t height, vk::Prese
 
 
     constexpr uint32_t SWAPCHAIN_IMAGES_COUNT_EXTENT = 2;
-    uint32_t swapchain_min_image_count = 0;
-    if(surface_capabilities.value.maxImageCount == 0)
-        swapchain_min_image_count = surface_capabilities.value.minImageCount + SWAPCHAIN_IMAGES_COUNT_EXTENT;
-    else if(surface_capabilities.value.minImageCount + SWAPCHAIN_IMAGES_COUNT_EXTENT > surface_capabilities.value.maxImageCount)
-        swapchain_min_image_count = surface_capabilities.value.maxImageCount;
-    else
-        swapchain_min_image_count = surface_capabilities.value.minImageCount + SWAPCHAIN_IMAGES_COUNT_EXTENT;
+    uint32_t swapchain_min_image_count = (image_count == 0 ?
+                                          surface_capabilities.value.minImageCount + SWAPCHAIN_IMAGES_COUNT_EXTENT :
+                                          std::max(image_count, surface_capabilities.value.minImageCount));
+    if(surface_capabilities.value.maxImageCount != 0)
+        swapchain_min_image_count = std::min(swapchain_min_image_count, surface_capabilities.value.maxImageCount);
 
     optional<vk::Format> swapchain_format;
     for(auto &fmt : surface_formats.value)
@@ -80,20 +108,24 @@ auto GraphicsDevice::create_swapchain(uint32_t width, uint32_t height, vk::Prese
         //return WarningLevel::FatalError("No compatible formats for swapchain was founded!");
 
 
+    //minimized window
+    if(surface_capabilities.value.maxImageExtent.width == 0 || surface_capabilities.value.maxImageExtent.height == 0)
+        return Result::error_code::DrawableAreaIsEmpty;
+
     vk::Extent2D swapchain_extent = surface_capabilities.value.currentExtent;
 
     if(swapchain_extent.width == 0 || swapchain_extent.width == 0xFFFFFFFF)
     {
-        swapchain_extent.width = width;
-        if(swapchain_extent.width > surface_capabilities.value.maxImageExtent.width)
-            swapchain_extent.width = surface_capabilities.value.maxImageExtent.width;
+        swapchain_extent.width = std::clamp(width,
+                                            surface_capabilities.value.minImageExtent.width,
+                                            surface_capabilities.value.maxImageExtent.width);
     }
 
     if(swapchain_extent.height == 0 || swapchain_extent.height == 0xFFFFFFFF)
     {
-        swapchain_extent.height = height;
-        if(swapchain_extent.height > surface_capabilities.value.maxImageExtent.height)
-            swapchain_extent.height = surface_capabilities.value.maxImageExtent.height;
+        swapchain_extent.height = std::clamp(height,
+                                             surface_capabilities.value.minImageExtent.height,
+                                             surface_capabilities.value.maxImageExtent.height);
     }
 
     vk::SharingMode swapchain_share_mode;
@@ -111,19 +143,28 @@ auto GraphicsDevice::create_swapchain(uint32_t width, uint32_t height, vk::Prese
         swapchain_queue_family.push_back(presentation_queue.value().first);
     }
 
-    bool is_present_mode_found = false;
-    for(auto &present_mode : surface_present_modes.value)
-        if(present_mode == mode)
-        {
-            is_present_mode_found = true;
-            break;
-        }
+    auto is_mode_supported = [&](vk::PresentModeKHR present_mode)
+    {
+        return std::find(surface_present_modes.value.begin(), surface_present_modes.value.end(), present_mode) != surface_present_modes.value.end();
+    };
+
+    //requested mode first, then fallback order
+    optional<vk::PresentModeKHR> chosen_mode;
+    if(is_mode_supported(mode))
+        chosen_mode = mode;
+    else
+    {
+        for(auto present_mode : PRESENT_MODE_FALLBACK)
+            if(is_mode_supported(present_mode))
+            {
+                chosen_mode = present_mode;
+                break;
+            }
+    }
 
-    //WarningLevel out_res;
-    if(!is_present_mode_found)
+    //fifo is required by spec, so this is broken surface
+    if(!chosen_mode)
         return Result::error_code::PresentModeNotSupported;
-        //mode = surface_present_modes.value.front();
-        //out_res = WarningLevel::Info(string("Passed mode doesn't supported by surface! ") + vk::to_string(mode) + string(" will be used instead!"));
 
     vk::SwapchainCreateInfoKHR swapchain_info;
     swapchain_info
@@ -139,8 +180,9 @@ auto GraphicsDevice::create_swapchain(uint32_t width, uint32_t height, vk::Prese
         .setQueueFamilyIndices(swapchain_queue_family)
         .setPreTransform(surface_capabilities.value.currentTransform)
         .setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque)
-        .setPresentMode(mode)
-        .setClipped(VK_TRUE);
+        .setPresentMode(chosen_mode.value())
+        .setClipped(VK_TRUE)
+        .setOldSwapchain(old_swapchain);
 
     auto swapchain_tmp = device.createSwapchainKHR(swapchain_info);
     if(swapchain_tmp.result != vk::Result::eSuccess)
@@ -149,7 +191,10 @@ auto GraphicsDevice::create_swapchain(uint32_t width, uint32_t height, vk::Prese
 
     auto swapchain_images_tmp = device.getSwapchainImagesKHR(swapchain_tmp.value);
     if(swapchain_images_tmp.result != vk::Result::eSuccess)
+    {
+        device.destroy(swapchain_tmp.value);
         return swapchain_images_tmp.result;
+    }
         //return out_res.concate(WarningLevel::FatalError(vk::to_string(swapchain_images_tmp.result)));
 
     swapchain_squad.swapchain = move(swapchain_tmp.value);
@@ -157,12 +202,67 @@ auto GraphicsDevice::create_swapchain(uint32_t width, uint32_t height, vk::Prese
     swapchain_squad.image_color_space = vk::ColorSpaceKHR::eVkColorspaceSrgbNonlinear;
     swapchain_squad.image_extent = swapchain_extent;
     swapchain_squad.image_format = swapchain_format.value();
+    swapchain_squad.present_mode = chosen_mode.value();
 
     return Result::error_code::Success;
 
     //return out_res.is_contain_msg_otherwise_return(WarningLevel::Ok("Swapchain is successfully created!"));
 }
 
+auto GraphicsDevice::create_offscreen_target(uint32_t width, uint32_t height, uint32_t images_count) -> GraphicsDevice::Result
+{
+    if(width == 0 || height == 0)
+        return Result::error_code::DrawableAreaIsEmpty;
+
+    vk::ImageCreateInfo image_info;
+    image_info
+        .setImageType(vk::ImageType::e2D)
+        .setFormat(OFFSCREEN_FORMAT)
+        .setExtent(vk::Extent3D(width, height, 1))
+        .setMipLevels(1)
+        .setArrayLayers(1)
+        .setSamples(vk::SampleCountFlagBits::e1)
+        .setTiling(vk::ImageTiling::eOptimal)
+        .setUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc)
+        .setSharingMode(vk::SharingMode::eExclusive)
+        .setInitialLayout(vk::ImageLayout::eUndefined);
+
+    vector<DeviceAllocator::ImageAllocation> images_tmp;
+    images_tmp.reserve(images_count);
+    for(uint32_t i = 0; i < images_count; i++)
+    {
+        auto image_tmp = allocator.CreateImage(image_info, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        if(!image_tmp.has_value())
+        {
+            for(auto &image : images_tmp)
+                allocator.DestroyImage(image);
+
+            return image_tmp.error();
+        }
+
+        images_tmp.push_back(image_tmp.value());
+    }
+
+    swapchain_squad.swapchain_images.clear();
+    for(auto &image : images_tmp)
+        swapchain_squad.swapchain_images.push_back(image.image);
+
+    swapchain_squad.image_format = OFFSCREEN_FORMAT;
+    swapchain_squad.image_extent = vk::Extent2D(width, height);
+    offscreen_images = move(images_tmp);
+
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::destroy_offscreen_target() -> void
+{
+    for(auto &image : offscreen_images)
+        deletion_queue.Push(image);
+
+    offscreen_images.clear();
+    swapchain_squad.swapchain_images.clear();
+}
+
 auto GraphicsDevice::create_renderpass() -> GraphicsDevice::Result
 {
     //if(!swapchain_squad.swapchain)
@@ -176,53 +276,76 @@ auto GraphicsDevice::create_renderpass() -> GraphicsDevice::Result
         .setLoadOp(vk::AttachmentLoadOp::eClear)
         .setStoreOp(vk::AttachmentStoreOp::eStore)
         .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
+        .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
+        //transitions from/to present layout are done by render graph
+        .setInitialLayout(vk::ImageLayout::eColorAttachmentOptimal)
+        .setFinalLayout(vk::ImageLayout::eColorAttachmentOptimal);
+
+    //D16 support is guaranteed, more precise formats are tried first
+    constexpr array<vk::Format, 4> depth_candidates
+    {
+        vk::Format::eD32Sfloat,
+        vk::Format::eD32SfloatS8Uint,
+        vk::Format::eD24UnormS8Uint,
+        vk::Format::eD16Unorm
+    };
+
+    depth_format = vk::Format::eUndefined;
+    for(auto format : depth_candidates)
+        if(parent_ph_dev.getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+        {
+            depth_format = format;
+            break;
+        }
+
+    if(depth_format == vk::Format::eUndefined)
+        return vk::Result::eErrorFormatNotSupported;
+
+    //attachments are described by pipelines and beginRendering
+    if(is_dynamic_rendering_enabled)
+        return Result::error_code::Success;
+
+    //depth isn't needed after the pass
+    vk::AttachmentDescription depth_attachment_desc;
+    depth_attachment_desc
+        .setFlags({})
+        .setFormat(depth_format)
+        .setSamples(vk::SampleCountFlagBits::e1)
+        .setLoadOp(vk::AttachmentLoadOp::eClear)
         .setStoreOp(vk::AttachmentStoreOp::eDontCare)
-        .setInitialLayout(vk::ImageLayout::eUndefined)
-        .setFinalLayout(vk::ImageLayout::ePresentSrcKHR);//change this when creating offscreen render!
+        .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
+        .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
+        .setInitialLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+        .setFinalLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
 
     vk::AttachmentReference color_attachment_ref;
     color_attachment_ref
         .setAttachment(0)//use 0 index of attachment(swapchain_color_attachment_desc) from parent renderpass
         .setLayout(vk::ImageLayout::eColorAttachmentOptimal);
 
+    vk::AttachmentReference depth_attachment_ref;
+    depth_attachment_ref
+        .setAttachment(1)
+        .setLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
     vk::SubpassDescription subpass_desc;
     subpass_desc
         .setFlags({})
         .setPipelineBindPoint(vk::PipelineBindPoint::eGraphics)
         .setInputAttachments({})
-        .setColorAttachments(color_attachment_ref);
+        .setColorAttachments(color_attachment_ref)
+        .setPDepthStencilAttachment(&depth_attachment_ref);
         //.setResolveAttachments({})
-        //.setPDepthStencilAttachment(nullptr)//use late, when creating depth image!
         //.setPreserveAttachments({});
 
-    #warning CHANGE THESE DEPENDENCIES FOR ABILITY TO USE SINGLE DEPTH BUFFER!!!! OR USE MULTIPLE DEPTH BUFFERS PER FRAME!!!!!!
-    vector<vk::SubpassDependency> deps
-    {
-        vk::SubpassDependency()
-            .setSrcSubpass(VK_SUBPASS_EXTERNAL)
-            .setDstSubpass(0)
-            .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setSrcAccessMask({})
-            .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eColorAttachmentRead)
-            .setDependencyFlags(vk::DependencyFlagBits::eByRegion),
-
-        vk::SubpassDependency()
-            .setSrcSubpass(0)
-            .setDstSubpass(VK_SUBPASS_EXTERNAL)
-            .setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eColorAttachmentRead)
-            .setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput)
-            .setDstAccessMask({})
-            .setDependencyFlags(vk::DependencyFlagBits::eByRegion),
-    };
+    array<vk::AttachmentDescription, 2> attachments{swapchain_color_attachment_desc, depth_attachment_desc};
 
+    //no external dependencies: barriers around renderpass are computed by render graph
     vk::RenderPassCreateInfo renderpass_info;
     renderpass_info
         .setFlags({})//compatibility with transform only
-        .setAttachments(swapchain_color_attachment_desc)
-        .setSubpasses(subpass_desc)
-        .setDependencies(deps);//see in future, because external - is implicit subpass
+        .setAttachments(attachments)
+        .setSubpasses(subpass_desc);
 
     auto renderpass_tmp = device.createRenderPass(renderpass_info);
     if(renderpass_tmp.result != vk::Result::eSuccess)
@@ -235,6 +358,37 @@ auto GraphicsDevice::create_renderpass() -> GraphicsDevice::Result
     //return WarningLevel::Ok("Renderpass is successfully created!");
 }
 
+auto GraphicsDevice::create_present_semaphores() -> GraphicsDevice::Result
+{
+    vector<vk::Semaphore> present_sems_tmp;
+    present_sems_tmp.reserve(swapchain_squad.swapchain_images.size());
+    for(size_t i = 0; i < swapchain_squad.swapchain_images.size(); i++)
+    {
+        auto sem_tmp = device.createSemaphore(vk::SemaphoreCreateInfo());
+        if(sem_tmp.result != vk::Result::eSuccess)
+        {
+            for(auto &sem : present_sems_tmp)
+                device.destroy(sem);
+
+            return sem_tmp.result;
+        }
+
+        present_sems_tmp.push_back(sem_tmp.value);
+    }
+
+    swapchain_squad.present_sems = move(present_sems_tmp);
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::destroy_present_semaphores() -> void
+{
+    //pending presents of old swapchain may still wait on them
+    for(auto &sem : swapchain_squad.present_sems)
+        deletion_queue.Push(sem);
+
+    swapchain_squad.present_sems.clear();
+}
+
 auto GraphicsDevice::create_swapchain_framebuffers() -> GraphicsDevice::Result
 {
     /*if(!swapchain_squad.swapchain)
@@ -279,6 +433,12 @@ auto GraphicsDevice::create_swapchain_framebuffers() -> GraphicsDevice::Result
         swapchain_images_views_tmp[i]  = created_img_view.value;
     }
 
+    if(is_dynamic_rendering_enabled)
+    {
+        swapchain_squad.swapchain_images_views = move(swapchain_images_views_tmp);
+        return Result::error_code::Success;
+    }
+
     vk::FramebufferCreateInfo swapchain_fb_info;
     swapchain_fb_info
         .setFlags({})
@@ -289,9 +449,12 @@ auto GraphicsDevice::create_swapchain_framebuffers() -> GraphicsDevice::Result
 
     vector<vk::Framebuffer> swapchain_framebuffers_tmp(swapchain_images_views_tmp.size(), vk::Framebuffer());
 
+    //single depth image is shared by all framebuffers, render graph orders its uses between frames
+    array<vk::ImageView, 2> attachments{vk::ImageView(), render_graph.GetImageView(depth_image_id)};
     for(size_t i = 0; i < swapchain_images_views_tmp.size(); i++)
     {
-        swapchain_fb_info.setAttachments(swapchain_images_views_tmp[i]);
+        attachments[0] = swapchain_images_views_tmp[i];
+        swapchain_fb_info.setAttachments(attachments);
         auto swapchain_img_view_fb = device.createFramebuffer(swapchain_fb_info);
         if(swapchain_img_view_fb.result != vk::Result::eSuccess)
         {
@@ -315,6 +478,72 @@ auto GraphicsDevice::create_swapchain_framebuffers() -> GraphicsDevice::Result
     //return WarningLevel::Ok("Swapchain framebuffers are successfully created!");
 }
 
+auto GraphicsDevice::destroy_swapchain_framebuffers() -> void
+{
+    for(auto &fb : swapchain_squad.swapchain_framebuffers)
+        deletion_queue.Push(fb);
+
+    for(auto &img_v : swapchain_squad.swapchain_images_views)
+        deletion_queue.Push(img_v);
+
+    swapchain_squad.swapchain_framebuffers.clear();
+    swapchain_squad.swapchain_images_views.clear();
+}
+
+auto GraphicsDevice::wait_frame_value(uint64_t value) -> vk::Result
+{
+    if(value == 0)
+        return vk::Result::eSuccess;
+
+    if(graphics_timeline)
+    {
+        vk::SemaphoreWaitInfo wait_info;
+        wait_info
+            .setFlags({})
+            .setSemaphores(graphics_timeline)
+            .setValues(value);
+
+        return device.waitSemaphores(wait_info, std::numeric_limits<uint64_t>::max());
+    }
+
+    //queue executes in order, so waiting every slot up to value is enough
+    vector<vk::Fence> fences;
+    fences.reserve(frames_sync.size());
+    for(auto &frame : frames_sync)
+        if(frame.submit_value != 0 && frame.submit_value <= value)
+            fences.push_back(frame.cpu_graphics_submit_fence);
+
+    if(fences.empty())
+        return vk::Result::eSuccess;
+
+    return device.waitForFences(fences, VK_TRUE, std::numeric_limits<uint64_t>::max());
+}
+
+auto GraphicsDevice::get_completed_frame_value() -> hrs::expected<uint64_t, vk::Result>
+{
+    if(graphics_timeline)
+    {
+        auto value = device.getSemaphoreCounterValue(graphics_timeline);
+        if(value.result != vk::Result::eSuccess)
+            return value.result;
+
+        return value.value;
+    }
+
+    //everything is done, except unsignaled slots and frames after them
+    uint64_t completed = frame_value;
+    for(auto &frame : frames_sync)
+    {
+        auto status = device.getFenceStatus(frame.cpu_graphics_submit_fence);
+        if(status == vk::Result::eNotReady)
+            completed = std::min(completed, frame.submit_value - 1);
+        else if(status != vk::Result::eSuccess)
+            return status;
+    }
+
+    return completed;
+}
+
 auto GraphicsDevice::load_shaders(const std::vector<LoadedShaderProps> &loaded) -> hrs::ResultDef<GraphicsDevice::Result>
 {
     //if(!device)
@@ -345,6 +574,18 @@ auto GraphicsDevice::load_shaders(const std::vector<LoadedShaderProps> &loaded)
         //return WarningLevel::FatalError(string("This shaders have been missed: ") + missed_shaders);
     }
 
+    //reflection goes first, so bad code doesn't leave modules behind
+    map<string_view, ShaderReflection> reflections;
+    for(auto &sh_ref : shader_refs)
+    {
+        auto refl = ShaderReflection::Reflect(sh_ref.first->code);
+        if(!refl.has_value())
+            return {Result::error_code::ShaderReflectionError,
+                    string(sh_ref.first->name) + ": " + string(ShaderReflection::ErrorToView(refl.error()))};
+
+        reflections.insert({shaders.find(sh_ref.first->name)->first, move(refl.value())});
+    }
+
     vk::ShaderModuleCreateInfo shader_info;
     shader_info
         .setFlags({});
@@ -370,41 +611,151 @@ auto GraphicsDevice::load_shaders(const std::vector<LoadedShaderProps> &loaded)
         shaders[string(sh_ref.first->name)] = sh_ref.second;
     }
 
+    shader_reflections = move(reflections);
+
+    for(auto &sh : optional_shaders)
+    {
+        auto it = std::find_if(loaded.begin(), loaded.end(), [&](const LoadedShaderProps &pr)
+        {
+            return (pr.name == sh.first) && (pr.code.size() != 0);
+        });
+
+        if(it == loaded.end())
+            continue;
+
+        shader_info.setCode(it->code);
+        auto shader_tmp = device.createShaderModule(shader_info);
+        if(shader_tmp.result != vk::Result::eSuccess)
+            return {shader_tmp.result};
+
+        sh.second = move(shader_tmp.value);
+    }
+
     return {Result::error_code::Success};
     //return WarningLevel::Ok("Shaders are creaated successfully!");
 }
 
-auto GraphicsDevice::create_pipeline() -> GraphicsDevice::Result
+auto GraphicsDevice::get_vertex_input() -> VertexInputDesc
 {
-    //if(!surface_renderpass)
-    //    return WarningLevel::FatalError("Renderpass isn't created yet!");
+    VertexInputDesc desc;
+    desc.bindings =
+    {
+        MeshStorage::GetVertexBindingDescription(),
+        vk::VertexInputBindingDescription()
+            .setBinding(INSTANCE_BINDING)
+            .setStride(sizeof(twv::glsl::Mat4x4))
+            .setInputRate(vk::VertexInputRate::eInstance)
+    };
+
+    auto mesh_attributes = MeshStorage::GetVertexAttributeDescriptions();
+    desc.attributes.assign(mesh_attributes.begin(), mesh_attributes.end());
+    //mat4 takes 4 locations, one per row
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        desc.attributes.push_back(vk::VertexInputAttributeDescription()
+            .setLocation(mesh_attributes.size() + i)
+            .setBinding(INSTANCE_BINDING)
+            .setFormat(vk::Format::eR32G32B32A32Sfloat)
+            .setOffset(sizeof(twv::glsl::Vec4) * i));
+    }
 
-    using namespace std::string_literals;
+    return desc;
+}
 
-    struct necessary_shaders_info
+auto GraphicsDevice::resolve_pipeline_layout(const std::map<std::string_view, ShaderReflection> &reflections, PipelineDesc &desc) -> GraphicsDevice::Result
+{
+    vector<ShaderReflection> stages;
+    stages.reserve(NECESSARY_SHADERS.size());
+    for(auto &sh : NECESSARY_SHADERS)
     {
-        string_view name;
-        vk::ShaderStageFlagBits stage;
-    };
+        auto refl_it = reflections.find(sh.name);
+        assert(refl_it != reflections.end());
+        if(refl_it->second.stage != sh.stage)
+            return Result::error_code::ShaderInterfaceMismatch;
+
+        stages.push_back(refl_it->second);
+    }
+
+    //every location read by vertex shader must be fed with the same format
+    auto vertex_input = get_vertex_input();
+    for(auto &input : stages[0].vertex_inputs)
+    {
+        auto attr_it = std::find_if(vertex_input.attributes.begin(), vertex_input.attributes.end(), [&](const vk::VertexInputAttributeDescription &attr)
+        {
+            return attr.location == input.location;
+        });
+
+        if(attr_it == vertex_input.attributes.end() || attr_it->format != input.format)
+            return Result::error_code::ShaderInterfaceMismatch;
+    }
+
+    //frame data set is owned by ring, shaders may only read its two dynamic buffers.
+    //Camera set has the only uniform block
+    bool has_camera_buffer = false;
+    for(auto &refl : stages)
+        for(auto &binding : refl.bindings)
+        {
+            if(binding.set == CAMERA_SET)
+            {
+                if(binding.binding != CAMERA_BINDING || binding.type != vk::DescriptorType::eUniformBuffer || binding.count != 1)
+                    return Result::error_code::ShaderInterfaceMismatch;
+
+                has_camera_buffer = true;
+                continue;
+            }
+
+            if(binding.set != FRAME_DATA_SET)
+                continue;
+
+            bool is_uniform = (binding.binding == FrameDataRing::UNIFORM_BINDING && binding.type == vk::DescriptorType::eUniformBuffer);
+            bool is_storage = (binding.binding == FrameDataRing::STORAGE_BINDING && binding.type == vk::DescriptorType::eStorageBuffer);
+            if(!is_uniform && !is_storage)
+                return Result::error_code::ShaderInterfaceMismatch;
+        }
 
-    constexpr array<necessary_shaders_info, 2> necessary_shaders
+    if(!layout_cache.is_inited())
+        layout_cache.init(device);
+
+    array<PipelineLayoutCache::ExternalSet, 2> external_sets
     {
-        necessary_shaders_info{"vertex_shader_test.spv", vk::ShaderStageFlagBits::eVertex},
-        necessary_shaders_info{"fragment_shader_test.spv", vk::ShaderStageFlagBits::eFragment}
+        PipelineLayoutCache::ExternalSet{FRAME_DATA_SET, frame_data_ring.GetSetLayout()},
+        PipelineLayoutCache::ExternalSet{CAMERA_SET, camera_squad.set_layout}
     };
+    auto layout_tmp = layout_cache.GetLayout(stages, external_sets);
+    if(!layout_tmp.has_value())
+        return layout_tmp.error();
+
+    //otherwise view_proj matrix is pushed by every draw
+    auto &push_constant = layout_tmp.value().push_constant;
+    if(!has_camera_buffer && (!push_constant || push_constant->offset != 0 || push_constant->size < sizeof(twv::Mat<float, 4, 4>)))
+        return Result::error_code::ShaderInterfaceMismatch;
+
+    desc.ppl_layout = layout_tmp.value().layout;
+    desc.push_stages = (push_constant ? push_constant->stageFlags : vk::ShaderStageFlags{});
+    desc.has_camera_buffer = has_camera_buffer;
+    return Result::error_code::Success;
+}
 
-#ifndef NDEBUG
-    for(auto &n_sh : necessary_shaders)
+auto GraphicsDevice::get_pipeline(PipelineDesc &desc, PipelineKind kind) -> vk::Pipeline &
+{
+    switch(kind)
     {
-        auto it = shaders.find(n_sh.name);
-        assert(it != shaders.end());
+        case PipelineKind::Prepass:
+            return desc.prepass_ppl;
+        case PipelineKind::Equal:
+            return desc.eq_ppl;
+        default:
+            return desc.ppl;
     }
-#endif
-
-    string missed_shaders;
+}
 
+auto GraphicsDevice::compile_pipeline(const std::map<std::string_view, vk::ShaderModule> &modules,
+                                      vk::PipelineLayout layout,
+                                      PipelineKind kind,
+                                      vk::PipelineCache cache) -> vk::ResultValue<vk::Pipeline>
+{
     vector<vk::PipelineShaderStageCreateInfo> shaders_info;
-    shaders_info.reserve(necessary_shaders.size());
+    shaders_info.reserve(NECESSARY_SHADERS.size());
 
     vk::PipelineShaderStageCreateInfo sh_stage_info;
     sh_stage_info
@@ -412,41 +763,23 @@ auto GraphicsDevice::create_pipeline() -> GraphicsDevice::Result
         .setPName("main");
         //.setPSpecializationInfo(nullptr);//set specialization in future!
 
-    for(auto &sh : necessary_shaders)
+    for(auto &sh : NECESSARY_SHADERS)
     {
-        auto it = shaders.find(sh.name);
-        /*if(it == shaders.end())
-        {
-            missed_shaders += sh.name;
-            missed_shaders += ' ';
-        }
-        else if(!it->second)
-        {
-            missed_shaders += sh.name;
-            missed_shaders += ' ';
-        }*/
-        //else
-        //{
+        auto it = modules.find(sh.name);
+        assert(it != modules.end());
         sh_stage_info
             .setStage(sh.stage)
             .setModule(it->second);
 
         shaders_info.push_back(sh_stage_info);
-        //}
     }
 
-    //EXPLICITLY SKIPPED!!!
-    /*if(!missed_shaders.empty())
-    {
-        missed_shaders.pop_back();
-        return WarningLevel::FatalError(string("These shaders haven't been loaded: ") + missed_shaders);
-    }*/
-
+    auto vertex_input = get_vertex_input();
     vk::PipelineVertexInputStateCreateInfo vertex_input_state_info;
     vertex_input_state_info
         .setFlags({})
-        .setVertexBindingDescriptions({})
-        .setVertexAttributeDescriptions({});//add bindings for vertex buffers in future!
+        .setVertexBindingDescriptions(vertex_input.bindings)
+        .setVertexAttributeDescriptions(vertex_input.attributes);
 
     vk::PipelineInputAssemblyStateCreateInfo input_asm_state_info;
     input_asm_state_info
@@ -454,25 +787,25 @@ auto GraphicsDevice::create_pipeline() -> GraphicsDevice::Result
         .setTopology(vk::PrimitiveTopology::eTriangleList)
         .setPrimitiveRestartEnable(VK_FALSE);
 
-    vk::Viewport viewport;
-    viewport
-        .setX(0.0f)
-        .setY(0.0f)
-        .setWidth(swapchain_squad.image_extent.width)
-        .setHeight(swapchain_squad.image_extent.height)
-        .setMinDepth(0.0f)
-		.setMaxDepth(1.0f);
-
-    vk::Rect2D scissors;
-    scissors
-        .setOffset({0, 0})
-        .setExtent(swapchain_squad.image_extent);
-
+    //viewport and scissor are dynamic, so pipeline survives swapchain recreation
     vk::PipelineViewportStateCreateInfo viewport_create_info;
     viewport_create_info
         .setFlags({})
-        .setViewports(viewport)
-        .setScissors(scissors);
+        .setViewportCount(1)
+        .setPViewports(nullptr)
+        .setScissorCount(1)
+        .setPScissors(nullptr);
+
+    array<vk::DynamicState, 2> dynamic_states
+    {
+        vk::DynamicState::eViewport,
+        vk::DynamicState::eScissor
+    };
+
+    vk::PipelineDynamicStateCreateInfo dynamic_state_info;
+    dynamic_state_info
+        .setFlags({})
+        .setDynamicStates(dynamic_states);
 
     //see depth clamping and bias in future!
     //change culling!
@@ -526,22 +859,28 @@ auto GraphicsDevice::create_pipeline() -> GraphicsDevice::Result
         .setAttachments(color_blend_attach_state_info)
         .setBlendConstants({0.0f, 0.0f, 0.0f, 0.0f});//just unused in our env.
 
-	vk::PushConstantRange push_constant;
-	push_constant
-			.setStageFlags(vk::ShaderStageFlagBits::eVertex)
-			.setSize(sizeof(twv::Mat<float, 4, 4>))
-			.setOffset(0);
+    //prepass doesn't touch color at all
+    vk::PipelineColorBlendAttachmentState prepass_blend_attach_state_info;
+    prepass_blend_attach_state_info
+        .setBlendEnable(VK_FALSE)
+        .setColorWriteMask({});
 
-    vk::PipelineLayoutCreateInfo ppl_layout_info;
-    ppl_layout_info
+    auto prepass_blend_state_info = color_blend_state_info;
+    prepass_blend_state_info.setAttachments(prepass_blend_attach_state_info);
+
+    vk::PipelineDepthStencilStateCreateInfo depth_state_info;
+    depth_state_info
         .setFlags({})
-        .setSetLayouts({})//use it in future for uniforms!
-		.setPushConstantRanges(push_constant);//use it in future for MVP ant other!
+        .setDepthTestEnable(VK_TRUE)
+        .setDepthWriteEnable(VK_TRUE)
+        .setDepthCompareOp(vk::CompareOp::eLess)
+        .setDepthBoundsTestEnable(VK_FALSE)
+        .setStencilTestEnable(VK_FALSE);
 
-    auto ppl_layout_tmp = device.createPipelineLayout(ppl_layout_info);
-    if(ppl_layout_tmp.result != vk::Result::eSuccess)
-        return ppl_layout_tmp.result;
-        //return WarningLevel::FatalError(vk::to_string(ppl_layout_tmp.result));
+    auto eq_depth_state_info = depth_state_info;
+    eq_depth_state_info
+        .setDepthWriteEnable(VK_FALSE)
+        .setDepthCompareOp(vk::CompareOp::eEqual);
 
     vk::GraphicsPipelineCreateInfo graphics_ppl_info;
     graphics_ppl_info
@@ -553,419 +892,2435 @@ auto GraphicsDevice::create_pipeline() -> GraphicsDevice::Result
         .setPViewportState(&viewport_create_info)
         .setPRasterizationState(&rasterization_state_info)
         .setPMultisampleState(&multisample_state_info)
-        .setPDepthStencilState(nullptr)//use depth in future!
+        .setPDepthStencilState(&depth_state_info)
         .setPColorBlendState(&color_blend_state_info)
-        .setPDynamicState(nullptr)//see in future when using swapchain recreation!
-        .setLayout(ppl_layout_tmp.value)
+        .setPDynamicState(&dynamic_state_info)
+        .setLayout(layout)
         .setRenderPass(surface_renderpass)
         .setSubpass(0);
 
-    auto graphics_ppl_tmp = device.createGraphicsPipelines({}, graphics_ppl_info);
-    if(graphics_ppl_tmp.result != vk::Result::eSuccess)
+    //prepass keeps color attachment with writes masked, so all kinds are begun with the same attachments
+    vk::PipelineRenderingCreateInfo rendering_info;
+    rendering_info
+        .setColorAttachmentFormats(swapchain_squad.image_format)
+        .setDepthAttachmentFormat(depth_format);
+
+    if(is_dynamic_rendering_enabled)
+        graphics_ppl_info.setPNext(&rendering_info);
+
+    //prepass runs the same vertex shader (first stage) with the same vertex input, so positions match exactly
+    switch(kind)
     {
-        device.destroy(ppl_layout_tmp.value);
-        return graphics_ppl_tmp.result;
-        //return WarningLevel::FatalError(vk::to_string(graphics_ppl_tmp.result));
+        case PipelineKind::Prepass:
+            graphics_ppl_info
+                .setStageCount(1)
+                .setPColorBlendState(&prepass_blend_state_info);
+            break;
+        case PipelineKind::Equal:
+            graphics_ppl_info.setPDepthStencilState(&eq_depth_state_info);
+            break;
+        default:
+            break;
     }
 
-    pipeline_squad.ppl_layout = move(ppl_layout_tmp.value);
-    pipeline_squad.ppl = move(graphics_ppl_tmp.value[0]);
-    return Result::error_code::Success;
-    //return WarningLevel::Ok("Graphics pipeline is created successfully!");
+    return device.createGraphicsPipeline(cache, graphics_ppl_info);
 }
 
-auto GraphicsDevice::create_frames_property() -> GraphicsDevice::Result
+auto GraphicsDevice::start_pipeline_compile(const std::map<std::string_view, vk::ShaderModule> &modules,
+                                            const PipelineDesc &layout_desc) -> std::unique_ptr<PipelineCompile>
 {
-    //if(!device)
-    //    return WarningLevel::FatalError("Device isn't created yet!");
+    if(compile_thread_pool.get_worker_count() == 0)
+        compile_thread_pool.init(std::clamp(std::thread::hardware_concurrency(), 1u, MAX_COMPILE_THREADS));
+
+    auto compile = std::make_unique<PipelineCompile>();
+    compile->modules = modules;
+    compile->pipelines.ppl_layout = layout_desc.ppl_layout;
+    compile->pipelines.push_stages = layout_desc.push_stages;
+    compile->pipelines.has_camera_buffer = layout_desc.has_camera_buffer;
+
+    //jobs start from what is already cached, so warm start stays warm
+    auto seed = std::make_shared<vector<uint8_t>>();
+    auto cache_data = device.getPipelineCacheData(pipeline_cache);
+    if(cache_data.result == vk::Result::eSuccess)
+        *seed = move(cache_data.value);
+
+    auto compile_ptr = compile.get();
+    for(size_t i = 0; i < PIPELINE_KIND_COUNT; i++)
+    {
+        compile->tasks[i] = compile_thread_pool.submit([this, compile_ptr, seed, i]() -> vk::Result
+        {
+            vk::PipelineCacheCreateInfo cache_info;
+            cache_info
+                .setFlags({})
+                .setInitialDataSize(seed->size())
+                .setPInitialData(seed->data());
+
+            auto cache_tmp = device.createPipelineCache(cache_info);
+            if(cache_tmp.result != vk::Result::eSuccess)
+                return cache_tmp.result;
+
+            compile_ptr->caches[i] = cache_tmp.value;
+            auto kind = static_cast<PipelineKind>(i);
+            auto ppl_tmp = compile_pipeline(compile_ptr->modules, compile_ptr->pipelines.ppl_layout, kind, cache_tmp.value);
+            if(ppl_tmp.result != vk::Result::eSuccess)
+                return ppl_tmp.result;
+
+            get_pipeline(compile_ptr->pipelines, kind) = ppl_tmp.value;
+            return vk::Result::eSuccess;
+        });
+    }
 
-    vk::CommandPoolCreateInfo comm_pool_info;
-    comm_pool_info
-        .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
-        .setQueueFamilyIndex(graphics_queue.value().first);
+    return compile;
+}
 
-    auto comm_pool_tmp = device.createCommandPool(comm_pool_info);
-    if(comm_pool_tmp.result != vk::Result::eSuccess)
-        return comm_pool_tmp.result;
-        //return WarningLevel::FatalError(vk::to_string(comm_pool_tmp.result));
+auto GraphicsDevice::get_compile_result(PipelineCompile &compile, PipelineKind kind, bool wait) -> std::optional<vk::Result>
+{
+    auto ind = static_cast<size_t>(kind);
+    if(compile.results[ind])
+        return compile.results[ind];
 
-    vk::CommandBufferAllocateInfo comm_buf_info;
-    comm_buf_info
-        .setCommandPool(comm_pool_tmp.value)
-        .setLevel(vk::CommandBufferLevel::ePrimary)
-        .setCommandBufferCount(FREE_FRAMES);
+    if(!wait && compile.tasks[ind].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return {};
 
-    auto comm_bufs_tmp = device.allocateCommandBuffers(comm_buf_info);
-    if(comm_bufs_tmp.result != vk::Result::eSuccess)
+    compile.results[ind] = compile.tasks[ind].get();
+    return compile.results[ind];
+}
+
+auto GraphicsDevice::finish_pipeline_compile(PipelineCompile &compile) -> vk::Result
+{
+    vk::Result first_error = vk::Result::eSuccess;
+    for(size_t i = 0; i < PIPELINE_KIND_COUNT; i++)
     {
-        device.destroyCommandPool(comm_pool_tmp.value);
-        return comm_bufs_tmp.result;
-        //return WarningLevel::FatalError(vk::to_string(comm_bufs_tmp.result));
+        auto res = get_compile_result(compile, static_cast<PipelineKind>(i), true).value();
+        if(res != vk::Result::eSuccess && first_error == vk::Result::eSuccess)
+            first_error = res;
     }
 
-    frames_comm_pool = move(comm_pool_tmp.value);
-    for(size_t i = 0; i < FREE_FRAMES; i++)
-        frames_sync[i].buf = move(comm_bufs_tmp.value[i]);
+    vector<vk::PipelineCache> caches;
+    for(auto &cache : compile.caches)
+        if(cache)
+            caches.push_back(cache);
+
+    //merged cache is only an optimization, failed merge doesn't fail compilation
+    if(!caches.empty())
+        (void)device.mergePipelineCaches(pipeline_cache, caches);
 
-    auto cleanup_prev = [this](size_t i)
+    for(auto &cache : compile.caches)
     {
-        for(size_t j = 0; j < i; j++)
-        {
-            device.destroy(frames_sync[j].cpu_graphics_submit_fence);
-            device.destroy(frames_sync[j].gpu_acquire_image_sem);
-        }
+        device.destroy(cache);
+        cache = vk::PipelineCache();
+    }
 
-        for(size_t j = 0; j < FREE_FRAMES; j++)
-            device.free(frames_comm_pool, frames_sync[j].buf);
+    return first_error;
+}
 
-        device.destroy(frames_comm_pool);
-    };
+auto GraphicsDevice::destroy_pipeline_compile(PipelineCompile &compile) -> void
+{
+    finish_pipeline_compile(compile);
+    destroy_pipelines(compile.pipelines);
+    compile.pipelines = {};
+}
 
-    vk::FenceCreateInfo fence_create_info;
-    fence_create_info.setFlags(vk::FenceCreateFlagBits::eSignaled);
-    vk::SemaphoreCreateInfo sem_create_info;
-    for(size_t i = 0; i < FREE_FRAMES; i++)
+auto GraphicsDevice::take_compiled_pipelines(bool wait_all) -> GraphicsDevice::Result
+{
+    if(!pipeline_compile)
+        return Result::error_code::Success;
+
+    bool is_done = true;
+    for(size_t i = 0; i < PIPELINE_KIND_COUNT; i++)
     {
-        auto fence_tmp = device.createFence(fence_create_info);
-        if(fence_tmp.result != vk::Result::eSuccess)
+        auto kind = static_cast<PipelineKind>(i);
+        //first frame needs only main pipeline, prepass ones are needed as soon as prepass is enabled
+        bool is_required = wait_all || kind == PipelineKind::Main || is_depth_prepass_enabled;
+        auto res = get_compile_result(*pipeline_compile, kind, is_required);
+        if(!res)
         {
-            cleanup_prev(i);
-            return fence_tmp.result;
-            //return WarningLevel::FatalError(vk::to_string(fence_tmp.result));
+            is_done = false;
+            continue;
         }
 
-        auto acquire_sem_tmp = device.createSemaphore(sem_create_info);
-        if(acquire_sem_tmp.result != vk::Result::eSuccess)
+        if(res.value() != vk::Result::eSuccess)
         {
-            cleanup_prev(i);
-            device.destroy(fence_tmp.value);
-            return acquire_sem_tmp.result;
-            //return WarningLevel::FatalError(vk::to_string(acquire_sem_tmp.result));
+            destroy_pipeline_compile(*pipeline_compile);
+            pipeline_compile.reset();
+            return res.value();
         }
 
-        auto submit_sem_tmp = device.createSemaphore(sem_create_info);
-        if(submit_sem_tmp.result != vk::Result::eSuccess)
+        auto &compiled = get_pipeline(pipeline_compile->pipelines, kind);
+        if(compiled)
         {
-            cleanup_prev(i);
-            device.destroy(fence_tmp.value);
-            device.destroy(acquire_sem_tmp.value);
-            return submit_sem_tmp.result;
-            //return WarningLevel::FatalError(vk::to_string(submit_sem_tmp.result));
+            get_pipeline(pipeline_squad, kind) = compiled;
+            compiled = vk::Pipeline();
         }
+    }
 
-        frames_sync[i].cpu_graphics_submit_fence = move(fence_tmp.value);
-        frames_sync[i].gpu_acquire_image_sem = move(acquire_sem_tmp.value);
-        frames_sync[i].gpu_graphics_submit_sem = move(submit_sem_tmp.value);
+    if(is_done)
+    {
+        finish_pipeline_compile(*pipeline_compile);
+        pipeline_compile.reset();
     }
 
     return Result::error_code::Success;
-    //return WarningLevel::Ok("Frames property is created successfully!");
-}
-
-GraphicsDevice::GraphicsDevice()
-{
-    #warning TBA!
 }
 
-GraphicsDevice::GraphicsDevice(GraphicsDevice &&gd) noexcept
+auto GraphicsDevice::create_pipeline() -> GraphicsDevice::Result
 {
-    #warning TBA!
-}
+    //if(!surface_renderpass)
+    //    return WarningLevel::FatalError("Renderpass isn't created yet!");
 
-GraphicsDevice::~GraphicsDevice()
+#ifndef NDEBUG
+    for(auto &n_sh : NECESSARY_SHADERS)
+    {
+        auto it = shaders.find(n_sh.name);
+        assert(it != shaders.end());
+    }
+#endif
+
+    PipelineDesc desc;
+    auto res = resolve_pipeline_layout(shader_reflections, desc);
+    if(res.code != Result::error_code::Success)
+        return res;
+
+    //pipelines are compiled in background while the rest of environment is created,
+    //they're taken by take_compiled_pipelines
+    pipeline_squad = desc;
+    pipeline_compile = start_pipeline_compile(shaders, desc);
+    return Result::error_code::Success;
+    //return WarningLevel::Ok("Graphics pipeline is created successfully!");
+}
+
+auto GraphicsDevice::destroy_pipeline() -> void
 {
-    if(device)
+    if(pipeline_compile)
     {
-        //see, what we can do with res?!
-        auto res = device.waitIdle();
-        if(frames_comm_pool)
+        destroy_pipeline_compile(*pipeline_compile);
+        pipeline_compile.reset();
+    }
+
+    retire_pipelines(pipeline_squad);
+    pipeline_squad = {};
+}
+
+auto GraphicsDevice::destroy_pipelines(const PipelineDesc &desc) -> void
+{
+    device.destroy(desc.ppl);
+    device.destroy(desc.prepass_ppl);
+    device.destroy(desc.eq_ppl);
+}
+
+auto GraphicsDevice::retire_pipelines(const PipelineDesc &desc) -> void
+{
+    deletion_queue.Push(desc.ppl);
+    deletion_queue.Push(desc.prepass_ppl);
+    deletion_queue.Push(desc.eq_ppl);
+
+    //handle may be reused after destruction, while static buffers are compared by handle
+    for(auto &record : static_layer.records)
+        record.is_recorded = false;
+}
+
+auto GraphicsDevice::apply_pipeline_rebuild(bool wait) -> void
+{
+    if(!pending_rebuild)
+        return;
+
+    if(!wait)
+        for(size_t i = 0; i < PIPELINE_KIND_COUNT; i++)
+            if(!get_compile_result(*pending_rebuild->compile, static_cast<PipelineKind>(i), false))
+                return;
+
+    auto rebuild = move(pending_rebuild);
+    Result rebuild_res = Result::error_code::Success;
+    auto res = finish_pipeline_compile(*rebuild->compile);
+    if(res != vk::Result::eSuccess)
+        rebuild_res = res;
+    else if(!static_layer.draws.empty() && !rebuild->compile->pipelines.has_camera_buffer)
+        rebuild_res = Result::error_code::StaticLayerNeedsCameraBuffer;
+
+    if(rebuild_res.code != Result::error_code::Success)
+    {
+        //current pipelines just stay
+        destroy_pipelines(rebuild->compile->pipelines);
+        for(auto &name : rebuild->changed)
+            device.destroy(rebuild->modules[name]);
+
+        rebuild_result = rebuild_res;
+        return;
+    }
+
+    //modules aren't referenced by pipelines after creation, unlike pipelines by recorded frames
+    retire_pipelines(pipeline_squad);
+    for(auto &name : rebuild->changed)
+    {
+        device.destroy(shaders[name]);
+        shaders[name] = rebuild->modules[name];
+    }
+
+    shader_reflections = move(rebuild->reflections);
+    pipeline_squad = rebuild->compile->pipelines;
+    rebuild_result = Result(Result::error_code::Success);
+}
+
+auto GraphicsDevice::discard_pipeline_rebuild() -> void
+{
+    if(!pending_rebuild)
+        return;
+
+    destroy_pipeline_compile(*pending_rebuild->compile);
+    for(auto &name : pending_rebuild->changed)
+        device.destroy(pending_rebuild->modules[name]);
+
+    pending_rebuild.reset();
+}
+
+auto GraphicsDevice::collect_deletions() -> vk::Result
+{
+    if(deletion_queue.GetPendingCount() == 0)
+        return vk::Result::eSuccess;
+
+    auto completed = get_completed_frame_value();
+    if(!completed.has_value())
+        return completed.error();
+
+    deletion_queue.Collect(completed.value());
+    return vk::Result::eSuccess;
+}
+
+auto GraphicsDevice::create_frames_property(uint32_t frames_count) -> GraphicsDevice::Result
+{
+    //if(!device)
+    //    return WarningLevel::FatalError("Device isn't created yet!");
+
+    frames_count = std::clamp(frames_count, 1u, MAX_FRAMES_IN_FLIGHT);
+
+    vk::CommandPoolCreateInfo comm_pool_info;
+    comm_pool_info
+        .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+        .setQueueFamilyIndex(graphics_queue.value().first);
+
+    auto comm_pool_tmp = device.createCommandPool(comm_pool_info);
+    if(comm_pool_tmp.result != vk::Result::eSuccess)
+        return comm_pool_tmp.result;
+        //return WarningLevel::FatalError(vk::to_string(comm_pool_tmp.result));
+
+    vk::CommandBufferAllocateInfo comm_buf_info;
+    comm_buf_info
+        .setCommandPool(comm_pool_tmp.value)
+        .setLevel(vk::CommandBufferLevel::ePrimary)
+        .setCommandBufferCount(frames_count);
+
+    auto comm_bufs_tmp = device.allocateCommandBuffers(comm_buf_info);
+    if(comm_bufs_tmp.result != vk::Result::eSuccess)
+    {
+        device.destroyCommandPool(comm_pool_tmp.value);
+        return comm_bufs_tmp.result;
+        //return WarningLevel::FatalError(vk::to_string(comm_bufs_tmp.result));
+    }
+
+    vector<AcquireFrameSync> frames_sync_tmp(frames_count);
+    for(size_t i = 0; i < frames_count; i++)
+        frames_sync_tmp[i].buf = move(comm_bufs_tmp.value[i]);
+
+    vk::Semaphore graphics_timeline_tmp;
+    auto cleanup_prev = [&, this]()
+    {
+        for(auto &frame : frames_sync_tmp)
         {
-            for(auto &frame : frames_sync)
+            device.destroy(frame.cpu_graphics_submit_fence);
+            device.destroy(frame.gpu_acquire_image_sem);
+            for(auto &pool : frame.record_pools)
+                device.destroy(pool);
+        }
+
+        device.destroy(graphics_timeline_tmp);
+        device.destroy(comm_pool_tmp.value);
+        record_thread_pool.stop();
+    };
+
+    //main thread is busy with its own part of the frame, so it isn't counted
+    uint32_t hardware_threads = std::thread::hardware_concurrency();
+    uint32_t record_threads = std::min(hardware_threads > 1 ? hardware_threads - 1 : 0, MAX_RECORD_THREADS);
+    record_thread_pool.init(record_threads);
+
+    //main thread buffers are needed even without workers, static layer makes subpass secondary
+    vk::CommandPoolCreateInfo record_pool_info;
+    record_pool_info
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(graphics_queue.value().first);
+
+    for(auto &frame : frames_sync_tmp)
+    {
+        for(uint32_t i = 0; i < record_threads + 1; i++)
+        {
+            auto record_pool_tmp = device.createCommandPool(record_pool_info);
+            if(record_pool_tmp.result != vk::Result::eSuccess)
             {
-                device.destroy(frame.cpu_graphics_submit_fence);
-                device.destroy(frame.gpu_graphics_submit_sem);
-                device.destroy(frame.gpu_acquire_image_sem);
-                device.free(frames_comm_pool, frame.buf);
+                cleanup_prev();
+                return record_pool_tmp.result;
+            }
+            frame.record_pools.push_back(record_pool_tmp.value);
+
+            vk::CommandBufferAllocateInfo record_buf_info;
+            record_buf_info
+                .setCommandPool(record_pool_tmp.value)
+                .setLevel(vk::CommandBufferLevel::eSecondary)
+                .setCommandBufferCount(2);
+
+            auto record_buf_tmp = device.allocateCommandBuffers(record_buf_info);
+            if(record_buf_tmp.result != vk::Result::eSuccess)
+            {
+                cleanup_prev();
+                return record_buf_tmp.result;
+            }
+            frame.record_bufs.push_back(record_buf_tmp.value[0]);
+            frame.prepass_record_bufs.push_back(record_buf_tmp.value[1]);
+        }
+    }
+
+    vk::SemaphoreTypeCreateInfo timeline_type_info(vk::SemaphoreType::eTimeline, 0);
+    if(is_timeline_semaphore_supported)
+    {
+        auto timeline_tmp = device.createSemaphore(vk::SemaphoreCreateInfo().setPNext(&timeline_type_info));
+        if(timeline_tmp.result != vk::Result::eSuccess)
+        {
+            cleanup_prev();
+            return timeline_tmp.result;
+        }
+        graphics_timeline_tmp = timeline_tmp.value;
+    }
+
+    vk::FenceCreateInfo fence_create_info;
+    fence_create_info.setFlags(vk::FenceCreateFlagBits::eSignaled);
+    vk::SemaphoreCreateInfo sem_create_info;
+    for(auto &frame : frames_sync_tmp)
+    {
+        if(!graphics_timeline_tmp)
+        {
+            auto fence_tmp = device.createFence(fence_create_info);
+            if(fence_tmp.result != vk::Result::eSuccess)
+            {
+                cleanup_prev();
+                return fence_tmp.result;
+                //return WarningLevel::FatalError(vk::to_string(fence_tmp.result));
+            }
+            frame.cpu_graphics_submit_fence = move(fence_tmp.value);
+        }
+
+        auto acquire_sem_tmp = device.createSemaphore(sem_create_info);
+        if(acquire_sem_tmp.result != vk::Result::eSuccess)
+        {
+            cleanup_prev();
+            return acquire_sem_tmp.result;
+            //return WarningLevel::FatalError(vk::to_string(acquire_sem_tmp.result));
+        }
+        frame.gpu_acquire_image_sem = move(acquire_sem_tmp.value);
+    }
+
+    frames_comm_pool = move(comm_pool_tmp.value);
+    frames_sync = move(frames_sync_tmp);
+    graphics_timeline = graphics_timeline_tmp;
+    frame_value = 0;
+    frames_in_flight = frames_count;
+    target_frame_ind = 0;
+    swapchain_squad.images_in_flight.assign(swapchain_squad.swapchain_images.size(), 0);
+
+    return Result::error_code::Success;
+    //return WarningLevel::Ok("Frames property is created successfully!");
+}
+
+auto GraphicsDevice::create_frame_data_ring(uint32_t frames_count) -> GraphicsDevice::Result
+{
+    frames_count = std::clamp(frames_count, 1u, MAX_FRAMES_IN_FLIGHT);
+    auto res = frame_data_ring.init(device, parent_ph_dev, allocator, frames_count);
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::is_pipeline_cache_compatible(std::span<const uint8_t> data) -> bool
+{
+    //VkPipelineCacheHeaderVersionOne: size, version, vendorID, deviceID, pipelineCacheUUID
+    constexpr size_t HEADER_SIZE = sizeof(uint32_t) * 4 + VK_UUID_SIZE;
+    if(data.size() < HEADER_SIZE)
+        return false;
+
+    uint32_t header[4];
+    std::memcpy(header, data.data(), sizeof(header));
+    auto props = parent_ph_dev.getProperties();
+
+    if(header[0] < HEADER_SIZE || header[0] > data.size())
+        return false;
+
+    if(header[1] != static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne))
+        return false;
+
+    if(header[2] != props.vendorID || header[3] != props.deviceID)
+        return false;
+
+    return std::memcmp(data.data() + sizeof(header), props.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+auto GraphicsDevice::create_pipeline_cache(std::span<const uint8_t> initial_data) -> GraphicsDevice::Result
+{
+    //driver must reject foreign blob by itself, but some drivers crash instead
+    is_pipeline_cache_loaded = is_pipeline_cache_compatible(initial_data);
+
+    vk::PipelineCacheCreateInfo cache_info;
+    cache_info.setFlags({});
+    if(is_pipeline_cache_loaded)
+    {
+        cache_info
+            .setInitialDataSize(initial_data.size())
+            .setPInitialData(initial_data.data());
+    }
+
+    auto cache_tmp = device.createPipelineCache(cache_info);
+    if(cache_tmp.result != vk::Result::eSuccess)
+        return cache_tmp.result;
+
+    pipeline_cache = move(cache_tmp.value);
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::reserve_instances(AcquireFrameSync &frame, uint32_t count) -> vk::Result
+{
+    if(count <= frame.instance_capacity)
+        return vk::Result::eSuccess;
+
+    uint32_t new_capacity = std::max(std::bit_ceil(count), MIN_INSTANCE_CAPACITY);
+
+    vk::BufferCreateInfo instance_info;
+    instance_info
+        .setFlags({})
+        .setSize(static_cast<vk::DeviceSize>(new_capacity) * sizeof(twv::glsl::Mat4x4))
+        .setUsage(vk::BufferUsageFlagBits::eVertexBuffer)
+        .setSharingMode(vk::SharingMode::eExclusive);
+
+    auto instance_tmp = allocator.CreateBuffer(instance_info,
+                                               vk::MemoryPropertyFlagBits::eHostVisible,
+                                               vk::MemoryPropertyFlagBits::eDeviceLocal);
+    if(!instance_tmp.has_value())
+        return instance_tmp.error();
+
+    //slot fence is already waited, so old buffer isn't used by GPU
+    allocator.DestroyBuffer(frame.instance_buffer);
+    frame.instance_buffer = instance_tmp.value();
+    frame.instance_capacity = new_capacity;
+    return vk::Result::eSuccess;
+}
+
+auto GraphicsDevice::record_draw_state(vk::CommandBuffer buf,
+                                       vk::Buffer instance_buffer,
+                                       uint32_t image_ind,
+                                       const twv::glsl::Mat4x4 &view_proj,
+                                       vk::Pipeline ppl) const -> void
+{
+    vk::Viewport viewport;
+    viewport
+        .setX(0.0f)
+        .setY(0.0f)
+        .setWidth(swapchain_squad.image_extent.width)
+        .setHeight(swapchain_squad.image_extent.height)
+        .setMinDepth(0.0f)
+		.setMaxDepth(1.0f);
+
+    vk::Rect2D scissors;
+    scissors
+        .setOffset({0, 0})
+        .setExtent(swapchain_squad.image_extent);
+
+    buf.bindPipeline(vk::PipelineBindPoint::eGraphics, ppl);
+
+    //uniform and storage offsets, draws set their own chunks
+    array<uint32_t, 2> data_offsets{frame_data_ring.GetEmptyOffset(), frame_data_ring.GetEmptyOffset()};
+    buf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                           pipeline_squad.ppl_layout,
+                           FRAME_DATA_SET,
+                           frame_data_ring.GetDescriptorSet(),
+                           data_offsets);
+    buf.setViewport(0, viewport);
+    buf.setScissor(0, scissors);
+
+    //camera set is the same for every frame of image, so buffer doesn't depend on view_proj
+    if(pipeline_squad.has_camera_buffer)
+        buf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                               pipeline_squad.ppl_layout,
+                               CAMERA_SET,
+                               camera_squad.sets[image_ind],
+                               {});
+    else
+        buf.pushConstants(pipeline_squad.ppl_layout, pipeline_squad.push_stages, 0, sizeof(twv::Mat<float, 4, 4>), &view_proj[0][0]);
+
+    //whole frame uses single vertex/index buffer pair and single instance buffer
+    buf.bindVertexBuffers(MeshStorage::VERTEX_BINDING, mesh_storage.GetVertexBuffer().buffer, vk::DeviceSize(0));
+    buf.bindIndexBuffer(mesh_storage.GetIndexBuffer().buffer, 0, MeshStorage::INDEX_TYPE);
+    if(instance_buffer)
+        buf.bindVertexBuffers(INSTANCE_BINDING, instance_buffer, vk::DeviceSize(0));
+}
+
+auto GraphicsDevice::fill_inheritance_info(uint32_t image_ind,
+                                           vk::CommandBufferInheritanceInfo &inheritance_info,
+                                           vk::CommandBufferInheritanceRenderingInfo &rendering_info) const -> void
+{
+    if(is_dynamic_rendering_enabled)
+    {
+        //main pass has no flags besides secondary contents, which isn't inherited
+        rendering_info
+            .setFlags({})
+            .setColorAttachmentFormats(swapchain_squad.image_format)
+            .setDepthAttachmentFormat(depth_format)
+            .setRasterizationSamples(vk::SampleCountFlagBits::e1);
+
+        inheritance_info.setPNext(&rendering_info);
+        return;
+    }
+
+    inheritance_info
+        .setRenderPass(surface_renderpass)
+        .setSubpass(0)
+        .setFramebuffer(swapchain_squad.swapchain_framebuffers[image_ind]);
+}
+
+auto GraphicsDevice::record_mesh_draws(vk::CommandBuffer buf, std::span<const InstancedMeshDraw> draws, uint32_t first_instance) const -> void
+{
+    //record_draw_state binds empty region
+    uint32_t empty_offset = frame_data_ring.GetEmptyOffset();
+    array<uint32_t, 2> data_offsets{empty_offset, empty_offset};
+    for(auto &draw : draws)
+    {
+        if(draw.transforms.empty())
+            continue;
+
+        //rebind only for new chunks, set itself is never updated
+        array<uint32_t, 2> draw_offsets{draw.uniform_offset.value_or(empty_offset), draw.storage_offset.value_or(empty_offset)};
+        if(draw_offsets != data_offsets)
+        {
+            data_offsets = draw_offsets;
+            buf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                   pipeline_squad.ppl_layout,
+                                   FRAME_DATA_SET,
+                                   frame_data_ring.GetDescriptorSet(),
+                                   data_offsets);
+        }
+
+        buf.drawIndexed(draw.mesh.index_count, draw.transforms.size(), draw.mesh.first_index, draw.mesh.vertex_offset, first_instance);
+        first_instance += draw.transforms.size();
+    }
+}
+
+auto GraphicsDevice::record_parallel(AcquireFrameSync &frame,
+                                     std::span<const InstancedMeshDraw> draws,
+                                     const twv::glsl::Mat4x4 &view_proj,
+                                     uint32_t image_ind,
+                                     bool has_culled_objects,
+                                     std::vector<vk::CommandBuffer> &prepass_bufs,
+                                     std::vector<vk::CommandBuffer> &main_bufs) -> vk::Result
+{
+    //slot fence is waited, so secondary buffers of this slot are free
+    for(auto &pool : frame.record_pools)
+    {
+        auto res = device.resetCommandPool(pool, {});
+        if(res != vk::Result::eSuccess)
+            return res;
+    }
+
+    vk::CommandBufferInheritanceInfo inheritance_info;
+    vk::CommandBufferInheritanceRenderingInfo rendering_info;
+    fill_inheritance_info(image_ind, inheritance_info, rendering_info);
+
+    vk::CommandBufferBeginInfo begin_info;
+    begin_info
+        .setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue)
+        .setPInheritanceInfo(&inheritance_info);
+
+    //without workers main thread buffer takes all draws
+    size_t chunks_count = std::min(frame.record_bufs.size() - 1, (draws.size() + MIN_DRAWS_PER_CHUNK - 1) / MIN_DRAWS_PER_CHUNK);
+    size_t chunk_size = (chunks_count != 0 ? (draws.size() + chunks_count - 1) / chunks_count : 0);
+    auto main_draws = (chunks_count == 0 ? draws : span<const InstancedMeshDraw>{});
+
+    vector<std::future<vk::Result>> chunk_results;
+    vector<vk::CommandBuffer> secondary_bufs;
+    chunk_results.reserve(chunks_count);
+    secondary_bufs.reserve(chunks_count + 1);
+
+    bool is_prepass = is_depth_prepass_enabled;
+    vk::Pipeline main_ppl = (is_prepass ? pipeline_squad.eq_ppl : pipeline_squad.ppl);
+
+    //instances of chunk start where previous chunk ends in instance buffer
+    uint32_t first_instance = 0;
+    for(size_t i = 0; i < chunks_count; i++)
+    {
+        size_t chunk_begin = i * chunk_size;
+        if(chunk_begin >= draws.size())
+            break;
+
+        auto chunk = draws.subspan(chunk_begin, std::min(chunk_size, draws.size() - chunk_begin));
+        auto buf = frame.record_bufs[i];
+        auto prepass_buf = frame.prepass_record_bufs[i];
+        chunk_results.push_back(record_thread_pool.submit([this, &frame, &begin_info, &view_proj, image_ind, buf, prepass_buf, chunk, first_instance, is_prepass, main_ppl]() -> vk::Result
+        {
+            //both buffers are from the pool of this task
+            if(is_prepass)
+            {
+                auto res = prepass_buf.begin(begin_info);
+                if(res != vk::Result::eSuccess)
+                    return res;
+
+                record_draw_state(prepass_buf, frame.instance_buffer.buffer, image_ind, view_proj, pipeline_squad.prepass_ppl);
+                record_mesh_draws(prepass_buf, chunk, first_instance);
+                res = prepass_buf.end();
+                if(res != vk::Result::eSuccess)
+                    return res;
             }
+
+            auto res = buf.begin(begin_info);
+            if(res != vk::Result::eSuccess)
+                return res;
+
+            record_draw_state(buf, frame.instance_buffer.buffer, image_ind, view_proj, main_ppl);
+            record_mesh_draws(buf, chunk, first_instance);
+            return buf.end();
+        }));
+
+        secondary_bufs.push_back(buf);
+        if(is_prepass)
+            prepass_bufs.push_back(prepass_buf);
+        for(auto &draw : chunk)
+            first_instance += draw.transforms.size();
+    }
+
+    //main thread records GPU culled objects meanwhile
+    vk::Result res = vk::Result::eSuccess;
+    if(has_culled_objects || !main_draws.empty())
+    {
+        auto record_main = [&](vk::CommandBuffer buf, vk::Pipeline ppl)
+        {
+            auto begin_res = buf.begin(begin_info);
+            if(begin_res != vk::Result::eSuccess)
+                return begin_res;
+
+            record_draw_state(buf, frame.instance_buffer.buffer, image_ind, view_proj, ppl);
+            record_mesh_draws(buf, main_draws, 0);
+            if(has_culled_objects)
+                gpu_culling.RecordDraw(buf, INSTANCE_BINDING);
+            return buf.end();
+        };
+
+        if(is_prepass)
+        {
+            res = record_main(frame.prepass_record_bufs.back(), pipeline_squad.prepass_ppl);
+            prepass_bufs.push_back(frame.prepass_record_bufs.back());
+        }
+
+        if(res == vk::Result::eSuccess)
+            res = record_main(frame.record_bufs.back(), main_ppl);
+
+        secondary_bufs.push_back(frame.record_bufs.back());
+    }
+
+    //every task must be finished before locals go out of scope
+    for(auto &chunk_res : chunk_results)
+    {
+        auto recorded = chunk_res.get();
+        if(recorded != vk::Result::eSuccess)
+            res = recorded;
+    }
+
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    main_bufs.insert(main_bufs.end(), secondary_bufs.begin(), secondary_bufs.end());
+    return vk::Result::eSuccess;
+}
+
+auto GraphicsDevice::record_static_layer(uint32_t image_ind,
+                                         const twv::glsl::Mat4x4 &view_proj,
+                                         std::vector<vk::CommandBuffer> &prepass_bufs,
+                                         std::vector<vk::CommandBuffer> &main_bufs) -> vk::Result
+{
+    auto &record = static_layer.records[image_ind];
+    bool is_prepass = is_depth_prepass_enabled;
+    vk::Pipeline main_ppl = (is_prepass ? pipeline_squad.eq_ppl : pipeline_squad.ppl);
+    vk::Pipeline prepass_ppl = (is_prepass ? pipeline_squad.prepass_ppl : vk::Pipeline());
+
+    //layer is refused without camera set, pushed view_proj would be baked into buffers
+    bool is_up_to_date = record.is_recorded &&
+                         pipeline_squad.has_camera_buffer &&
+                         record.version == static_layer.version &&
+                         record.ppl == main_ppl &&
+                         record.prepass_ppl == prepass_ppl;
+
+    if(!is_up_to_date)
+    {
+        vk::CommandBufferInheritanceInfo inheritance_info;
+        vk::CommandBufferInheritanceRenderingInfo rendering_info;
+        fill_inheritance_info(image_ind, inheritance_info, rendering_info);
+
+        //previous frame of the image is completed, so buffers aren't pending and may be reset by begin
+        vk::CommandBufferBeginInfo begin_info;
+        begin_info
+            .setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue)
+            .setPInheritanceInfo(&inheritance_info);
+
+        auto record_buf = [&](vk::CommandBuffer buf, vk::Pipeline ppl)
+        {
+            auto begin_res = buf.begin(begin_info);
+            if(begin_res != vk::Result::eSuccess)
+                return begin_res;
+
+            record_draw_state(buf, static_layer.instance_buffer.buffer, image_ind, view_proj, ppl);
+            record_mesh_draws(buf, static_layer.draws, 0);
+            return buf.end();
+        };
+
+        record.is_recorded = false;
+        if(is_prepass)
+        {
+            auto res = record_buf(record.prepass_buf, prepass_ppl);
+            if(res != vk::Result::eSuccess)
+                return res;
+
+            static_layer.record_count++;
         }
 
-        device.destroy(frames_comm_pool);
+        auto res = record_buf(record.buf, main_ppl);
+        if(res != vk::Result::eSuccess)
+            return res;
+
+        static_layer.record_count++;
+        record.is_recorded = true;
+        record.version = static_layer.version;
+        record.ppl = main_ppl;
+        record.prepass_ppl = prepass_ppl;
+    }
+
+    if(is_prepass)
+        prepass_bufs.push_back(record.prepass_buf);
+
+    main_bufs.push_back(record.buf);
+    return vk::Result::eSuccess;
+}
+
+auto GraphicsDevice::create_mesh_storage() -> GraphicsDevice::Result
+{
+    vk::CommandPoolCreateInfo upload_pool_info;
+    upload_pool_info
+        .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(graphics_queue.value().first);
+
+    auto upload_pool_tmp = device.createCommandPool(upload_pool_info);
+    if(upload_pool_tmp.result != vk::Result::eSuccess)
+        return upload_pool_tmp.result;
+
+    auto families = get_upload_queue_families();
+    auto res = mesh_storage.init(allocator, families);
+    if(res != vk::Result::eSuccess)
+    {
+        device.destroy(upload_pool_tmp.value);
+        return res;
+    }
+
+    upload_comm_pool = move(upload_pool_tmp.value);
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::create_gpu_culling() -> GraphicsDevice::Result
+{
+    auto cull_shader = optional_shaders.find("cull_objects.comp.spv");
+    if(!is_gpu_culling_supported || !cull_shader->second)
+        return Result::error_code::Success;
+
+    //plain multi draw indirect can't take more than maxDrawIndirectCount commands
+    auto limits = parent_ph_dev.getProperties().limits;
+    uint32_t capacity = std::min(GpuCulling::DEFAULT_OBJECT_CAPACITY, limits.maxDrawIndirectCount);
+
+    auto res = gpu_culling.init(device,
+                                allocator,
+                                cull_shader->second,
+                                pipeline_cache,
+                                frames_in_flight,
+                                is_draw_indirect_count_supported,
+                                capacity);
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::create_uploader() -> GraphicsDevice::Result
+{
+    if(!is_timeline_semaphore_supported)
+        return Result::error_code::Success;
+
+    //without transfer-only family uploads share graphics queue, but CPU still doesn't wait for them
+    auto &queue = (transfer_queue ? transfer_queue.value() : graphics_queue.value());
+    auto res = uploader.init(device,
+                             parent_ph_dev,
+                             allocator,
+                             StagingUploader::QueueDesc{.family = queue.first, .queue = queue.second},
+                             graphics_queue.value().first);
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::create_async_compute() -> GraphicsDevice::Result
+{
+    //without timeline semaphores passes are recorded into graphics buffer, so they stay on graphics family
+    auto &queue = (compute_queue && is_timeline_semaphore_supported ? compute_queue.value() : graphics_queue.value());
+    auto res = async_compute.init(device,
+                                  ComputeQueue::QueueDesc{.family = queue.first, .queue = queue.second},
+                                  graphics_queue.value().first,
+                                  is_timeline_semaphore_supported);
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::create_gpu_profiler() -> GraphicsDevice::Result
+{
+    auto queue_props = parent_ph_dev.getQueueFamilyProperties();
+    uint32_t valid_bits = queue_props[graphics_queue.value().first].timestampValidBits;
+    if(valid_bits == 0)
+        return Result::error_code::Success;
+
+    auto res = gpu_profiler.init(device, parent_ph_dev.getProperties().limits.timestampPeriod, valid_bits, frames_in_flight);
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::create_render_graph() -> GraphicsDevice::Result
+{
+    if(!render_graph.is_inited())
+        render_graph.init(device, allocator, &deletion_queue);
+
+    render_graph.Reset();
+
+    //image is replaced by acquired one every frame, acquire semaphore is waited at color output stage
+    vk::ImageSubresourceRange color_range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    if(is_headless)
+    {
+        //offscreen image of slot was last used by its previous frame: render or readback copy
+        swapchain_image_id = render_graph.ImportImage("offscreen",
+                                                      swapchain_squad.swapchain_images[0],
+                                                      color_range,
+                                                      RenderGraph::Access{vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer,
+                                                                          {},
+                                                                          vk::ImageLayout::eUndefined});
+    }
+    else
+    {
+        swapchain_image_id = render_graph.ImportImage("swapchain",
+                                                      swapchain_squad.swapchain_images[0],
+                                                      color_range,
+                                                      RenderGraph::Access{vk::PipelineStageFlagBits::eColorAttachmentOutput, {}, vk::ImageLayout::eUndefined},
+                                                      RenderGraph::Access{vk::PipelineStageFlagBits::eBottomOfPipe, {}, vk::ImageLayout::ePresentSrcKHR});
+    }
+
+    //previous frame's indirect draws are the last users of cull output
+    RenderGraph::Access indirect_read{vk::PipelineStageFlagBits::eDrawIndirect, vk::AccessFlagBits::eIndirectCommandRead};
+    optional<RenderGraph::ResourceId> commands_id;
+    optional<RenderGraph::ResourceId> count_id;
+    if(gpu_culling.is_inited())
+    {
+        commands_id = render_graph.ImportBuffer("cull_commands", gpu_culling.GetCommandsBuffer(), indirect_read);
+        count_id = render_graph.ImportBuffer("cull_count", gpu_culling.GetCountBuffer(), indirect_read);
+
+        RenderGraph::Access cull_write{vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+                                       vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite};
+        render_graph.AddPass("cull", [&](RenderGraph::PassBuilder &builder)
+        {
+            builder
+                .Write(commands_id.value(), cull_write)
+                .Write(count_id.value(), cull_write);
+        },
+        [this](vk::CommandBuffer buf)
+        {
+            auto scope = gpu_profiler.BeginScope(buf, "upload");
+            gpu_culling.RecordUpdates(buf);
+            gpu_profiler.EndScope(buf, scope);
+
+            scope = gpu_profiler.BeginScope(buf, "cull");
+            gpu_culling.RecordCulling(buf, *record_context.view_proj);
+            gpu_profiler.EndScope(buf, scope);
+        });
+    }
+
+    depth_image_id = render_graph.CreateImage("depth", RenderGraph::ImageDesc
+    {
+        .format = depth_format,
+        .extent = swapchain_squad.image_extent,
+        .aspect = depth_aspect(depth_format)
+    });
+
+    render_graph.AddPass("main", [&](RenderGraph::PassBuilder &builder)
+    {
+        builder
+            .Write(swapchain_image_id,
+                   RenderGraph::Access{vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                       vk::AccessFlagBits::eColorAttachmentWrite,
+                                       vk::ImageLayout::eColorAttachmentOptimal})
+            .Write(depth_image_id,
+                   RenderGraph::Access{vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+                                       vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                                       vk::ImageLayout::eDepthStencilAttachmentOptimal});
+        if(commands_id)
+        {
+            builder
+                .Read(commands_id.value(), indirect_read)
+                .Read(count_id.value(), indirect_read);
+        }
+    },
+    [this](vk::CommandBuffer buf)
+    {
+        auto scope = gpu_profiler.BeginScope(buf, "main");
+        record_main_pass(buf);
+        gpu_profiler.EndScope(buf, scope);
+    });
+
+    if(is_headless)
+    {
+        render_graph.AddPass("readback", [&](RenderGraph::PassBuilder &builder)
+        {
+            builder
+                .Read(swapchain_image_id,
+                      RenderGraph::Access{vk::PipelineStageFlagBits::eTransfer,
+                                          vk::AccessFlagBits::eTransferRead,
+                                          vk::ImageLayout::eTransferSrcOptimal})
+                .SetSideEffects();
+        },
+        [this](vk::CommandBuffer buf)
+        {
+            if(!record_context.is_readback)
+                return;
+
+            auto scope = gpu_profiler.BeginScope(buf, "readback");
+
+            vk::BufferImageCopy region;
+            region
+                .setBufferOffset(0)
+                .setBufferRowLength(0)
+                .setBufferImageHeight(0)
+                .setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+                .setImageOffset({0, 0, 0})
+                .setImageExtent(vk::Extent3D(swapchain_squad.image_extent.width, swapchain_squad.image_extent.height, 1));
+
+            buf.copyImageToBuffer(swapchain_squad.swapchain_images[record_context.image_ind],
+                                  vk::ImageLayout::eTransferSrcOptimal,
+                                  record_context.frame->readback_buffer.buffer,
+                                  region);
+
+            //fence wait alone doesn't make transfer writes visible to host
+            vk::MemoryBarrier host_barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+            buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eHost,
+                                {},
+                                host_barrier,
+                                {},
+                                {});
+            gpu_profiler.EndScope(buf, scope);
+        });
+    }
+
+    auto res = render_graph.Compile();
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::create_static_layer() -> GraphicsDevice::Result
+{
+    if(!camera_squad.set_layout)
+    {
+        auto camera_binding = vk::DescriptorSetLayoutBinding()
+            .setBinding(CAMERA_BINDING)
+            .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+            .setDescriptorCount(1)
+            .setStageFlags(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment);
+
+        vk::DescriptorSetLayoutCreateInfo set_layout_info;
+        set_layout_info
+            .setFlags({})
+            .setBindings(camera_binding);
+
+        auto set_layout_tmp = device.createDescriptorSetLayout(set_layout_info);
+        if(set_layout_tmp.result != vk::Result::eSuccess)
+            return set_layout_tmp.result;
+
+        camera_squad.set_layout = set_layout_tmp.value;
+    }
+
+    //buffers of different images are re-recorded independently
+    if(!static_layer.comm_pool)
+    {
+        vk::CommandPoolCreateInfo comm_pool_info;
+        comm_pool_info
+            .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+            .setQueueFamilyIndex(graphics_queue.value().first);
+
+        auto comm_pool_tmp = device.createCommandPool(comm_pool_info);
+        if(comm_pool_tmp.result != vk::Result::eSuccess)
+            return comm_pool_tmp.result;
+
+        static_layer.comm_pool = comm_pool_tmp.value;
+    }
+
+    uint32_t images_count = swapchain_squad.swapchain_images.size();
+    vk::DeviceSize alignment = parent_ph_dev.getProperties().limits.minUniformBufferOffsetAlignment;
+    camera_squad.stride = (sizeof(twv::glsl::Mat4x4) + alignment - 1) / alignment * alignment;
+
+    vk::BufferCreateInfo camera_info;
+    camera_info
+        .setFlags({})
+        .setSize(camera_squad.stride * images_count)
+        .setUsage(vk::BufferUsageFlagBits::eUniformBuffer)
+        .setSharingMode(vk::SharingMode::eExclusive);
+
+    auto camera_tmp = allocator.CreateBuffer(camera_info,
+                                             vk::MemoryPropertyFlagBits::eHostVisible,
+                                             vk::MemoryPropertyFlagBits::eDeviceLocal);
+    if(!camera_tmp.has_value())
+        return camera_tmp.error();
+
+    camera_squad.buffer = camera_tmp.value();
+
+    vk::DescriptorPoolSize pool_size(vk::DescriptorType::eUniformBuffer, images_count);
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info
+        .setFlags({})
+        .setMaxSets(images_count)
+        .setPoolSizes(pool_size);
+
+    auto pool_tmp = device.createDescriptorPool(pool_info);
+    if(pool_tmp.result != vk::Result::eSuccess)
+    {
+        destroy_static_layer();
+        return pool_tmp.result;
+    }
+
+    camera_squad.descriptor_pool = pool_tmp.value;
+
+    vector<vk::DescriptorSetLayout> set_layouts(images_count, camera_squad.set_layout);
+    vk::DescriptorSetAllocateInfo set_info;
+    set_info
+        .setDescriptorPool(camera_squad.descriptor_pool)
+        .setSetLayouts(set_layouts);
+
+    auto sets_tmp = device.allocateDescriptorSets(set_info);
+    if(sets_tmp.result != vk::Result::eSuccess)
+    {
+        destroy_static_layer();
+        return sets_tmp.result;
+    }
+
+    camera_squad.sets = move(sets_tmp.value);
+
+    vector<vk::DescriptorBufferInfo> buffer_infos;
+    vector<vk::WriteDescriptorSet> writes;
+    buffer_infos.reserve(images_count);
+    writes.reserve(images_count);
+    for(uint32_t i = 0; i < images_count; i++)
+    {
+        buffer_infos.push_back(vk::DescriptorBufferInfo(camera_squad.buffer.buffer, camera_squad.stride * i, sizeof(twv::glsl::Mat4x4)));
+        writes.push_back(vk::WriteDescriptorSet()
+            .setDstSet(camera_squad.sets[i])
+            .setDstBinding(CAMERA_BINDING)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+            .setBufferInfo(buffer_infos.back()));
+    }
+
+    device.updateDescriptorSets(writes, {});
+
+    vk::CommandBufferAllocateInfo static_buf_info;
+    static_buf_info
+        .setCommandPool(static_layer.comm_pool)
+        .setLevel(vk::CommandBufferLevel::eSecondary)
+        .setCommandBufferCount(images_count * 2);
+
+    auto static_bufs_tmp = device.allocateCommandBuffers(static_buf_info);
+    if(static_bufs_tmp.result != vk::Result::eSuccess)
+    {
+        destroy_static_layer();
+        return static_bufs_tmp.result;
+    }
+
+    static_layer.records.resize(images_count);
+    for(uint32_t i = 0; i < images_count; i++)
+    {
+        static_layer.records[i].buf = static_bufs_tmp.value[i * 2];
+        static_layer.records[i].prepass_buf = static_bufs_tmp.value[i * 2 + 1];
+    }
+
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::destroy_static_layer() -> void
+{
+    vector<vk::CommandBuffer> static_bufs;
+    static_bufs.reserve(static_layer.records.size() * 2);
+    for(auto &record : static_layer.records)
+    {
+        static_bufs.push_back(record.buf);
+        static_bufs.push_back(record.prepass_buf);
+    }
+
+    if(!static_bufs.empty())
+        deletion_queue.Push(DeletionQueue::CommandBuffers{static_layer.comm_pool, move(static_bufs)});
+
+    static_layer.records.clear();
+
+    //sets are freed with their pool
+    deletion_queue.Push(camera_squad.descriptor_pool);
+    deletion_queue.Push(camera_squad.buffer);
+    camera_squad.descriptor_pool = vk::DescriptorPool();
+    camera_squad.buffer = {};
+    camera_squad.sets.clear();
+}
+
+auto GraphicsDevice::record_main_pass(vk::CommandBuffer buf) -> void
+{
+    auto &ctx = record_context;
+
+    array<vk::ClearValue, 2> clear_values
+    {
+        vk::ClearValue().setColor(vk::ClearColorValue(array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f})),
+        vk::ClearValue().setDepthStencil(vk::ClearDepthStencilValue(1.0f, 0))
+    };
+
+    auto render_area = vk::Rect2D()
+        .setOffset({0, 0})
+        .setExtent(swapchain_squad.image_extent);
+
+    //big draw lists are split between record threads, each chunk goes to own secondary buffer.
+    //Static layer is replayed from secondary buffers, so the rest of subpass must be secondary too
+    bool has_static_draws = !static_layer.draws.empty();
+    bool is_parallel_record = record_thread_pool.get_worker_count() != 0 && ctx.draws.size() >= PARALLEL_RECORD_THRESHOLD;
+    bool is_secondary = has_static_draws || is_parallel_record;
+
+    //render graph has already moved attachments to attachment layouts, same as renderpass expects
+    if(is_dynamic_rendering_enabled)
+    {
+        vk::RenderingAttachmentInfo color_attachment_info;
+        color_attachment_info
+            .setImageView(swapchain_squad.swapchain_images_views[ctx.image_ind])
+            .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setStoreOp(vk::AttachmentStoreOp::eStore)
+            .setClearValue(clear_values[0]);
+
+        vk::RenderingAttachmentInfo depth_attachment_info;
+        depth_attachment_info
+            .setImageView(render_graph.GetImageView(depth_image_id))
+            .setImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setStoreOp(vk::AttachmentStoreOp::eDontCare)
+            .setClearValue(clear_values[1]);
+
+        vk::RenderingInfo rendering_info;
+        rendering_info
+            .setFlags(is_secondary ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers : vk::RenderingFlags())
+            .setRenderArea(render_area)
+            .setLayerCount(1)
+            .setColorAttachments(color_attachment_info)
+            .setPDepthAttachment(&depth_attachment_info);
+
+        buf.beginRendering(rendering_info);
+    }
+    else
+    {
+        vk::RenderPassBeginInfo renderpass_begin_info;
+        renderpass_begin_info
+            .setRenderPass(surface_renderpass)
+            .setFramebuffer(swapchain_squad.swapchain_framebuffers[ctx.image_ind])
+            .setRenderArea(render_area)
+            .setClearValues(clear_values);
+
+        buf.beginRenderPass(renderpass_begin_info, is_secondary ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline);
+    }
+
+    if(is_secondary)
+    {
+        vector<vk::CommandBuffer> prepass_bufs;
+        vector<vk::CommandBuffer> main_bufs;
+        if(has_static_draws)
+            ctx.result = record_static_layer(ctx.image_ind, *ctx.view_proj, prepass_bufs, main_bufs);
+
+        if(ctx.result == vk::Result::eSuccess && (!ctx.draws.empty() || ctx.has_culled_objects))
+            ctx.result = record_parallel(*ctx.frame, ctx.draws, *ctx.view_proj, ctx.image_ind, ctx.has_culled_objects, prepass_bufs, main_bufs);
+
+        //depth of every draw is written before any draw is shaded
+        prepass_bufs.insert(prepass_bufs.end(), main_bufs.begin(), main_bufs.end());
+        if(ctx.result == vk::Result::eSuccess && !prepass_bufs.empty())
+            buf.executeCommands(prepass_bufs);
+    }
+    else
+    {
+        if(ctx.draws.empty() && !ctx.has_culled_objects)
+        {
+            record_draw_state(buf, ctx.frame->instance_buffer.buffer, ctx.image_ind, *ctx.view_proj, pipeline_squad.ppl);
+            buf.draw(3, 1, 0, 0);
+        }
+        else
+        {
+            auto record_scene = [&](vk::Pipeline ppl)
+            {
+                record_draw_state(buf, ctx.frame->instance_buffer.buffer, ctx.image_ind, *ctx.view_proj, ppl);
+                record_mesh_draws(buf, ctx.draws, 0);
+
+                //GPU culled objects don't cost anything on CPU here
+                if(ctx.has_culled_objects)
+                    gpu_culling.RecordDraw(buf, INSTANCE_BINDING);
+            };
+
+            //same subpass: depth writes of prepass are ordered before tests of main draws
+            if(is_depth_prepass_enabled)
+            {
+                record_scene(pipeline_squad.prepass_ppl);
+                record_scene(pipeline_squad.eq_ppl);
+            }
+            else
+                record_scene(pipeline_squad.ppl);
+        }
+    }
+
+    if(is_dynamic_rendering_enabled)
+        buf.endRendering();
+    else
+        buf.endRenderPass();
+}
+
+auto GraphicsDevice::get_upload_queue_families() -> std::vector<uint32_t>
+{
+    if(!uploader.is_inited())
+        return {};
+
+    return uploader.GetQueueFamilies();
+}
+
+auto GraphicsDevice::upload_buffer(const DeviceAllocator::BufferAllocation &dst, vk::DeviceSize offset, std::span<const uint8_t> data) -> vk::Result
+{
+    if(data.empty())
+        return vk::Result::eSuccess;
+
+    //host visible device local memory(UMA, ReBAR, software rasterizers) is written directly
+    if(dst.allocation.mapped_ptr)
+    {
+        std::memcpy(static_cast<uint8_t *>(dst.allocation.mapped_ptr) + offset, data.data(), data.size());
+        return allocator.Flush(dst.allocation, offset, data.size());
+    }
+
+    if(uploader.is_inited())
+    {
+        return uploader.UploadBuffer(dst.buffer, offset, data, vk::PipelineStageFlagBits::eVertexInput);
+    }
+
+    //no timeline semaphores, so copy is just waited
+    vk::BufferCreateInfo staging_info;
+    staging_info
+        .setFlags({})
+        .setSize(data.size())
+        .setUsage(vk::BufferUsageFlagBits::eTransferSrc)
+        .setSharingMode(vk::SharingMode::eExclusive);
+
+    auto staging = allocator.CreateBuffer(staging_info, vk::MemoryPropertyFlagBits::eHostVisible);
+    if(!staging.has_value())
+        return staging.error();
+
+    std::memcpy(staging.value().allocation.mapped_ptr, data.data(), data.size());
+    auto res = allocator.Flush(staging.value().allocation);
+    if(res != vk::Result::eSuccess)
+    {
+        allocator.DestroyBuffer(staging.value());
+        return res;
+    }
+
+    vk::CommandBufferAllocateInfo comm_buf_info;
+    comm_buf_info
+        .setCommandPool(upload_comm_pool)
+        .setLevel(vk::CommandBufferLevel::ePrimary)
+        .setCommandBufferCount(1);
+
+    auto comm_buf = device.allocateCommandBuffers(comm_buf_info);
+    if(comm_buf.result != vk::Result::eSuccess)
+    {
+        allocator.DestroyBuffer(staging.value());
+        return comm_buf.result;
+    }
+
+    auto fence = device.createFence(vk::FenceCreateInfo());
+    if(fence.result != vk::Result::eSuccess)
+    {
+        device.free(upload_comm_pool, comm_buf.value);
+        allocator.DestroyBuffer(staging.value());
+        return fence.result;
+    }
+
+    auto cleanup = [&, this]()
+    {
+        device.destroy(fence.value);
+        device.free(upload_comm_pool, comm_buf.value);
+        allocator.DestroyBuffer(staging.value());
+    };
+
+    auto &buf = comm_buf.value[0];
+    res = buf.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    if(res != vk::Result::eSuccess)
+    {
+        cleanup();
+        return res;
+    }
+
+    buf.copyBuffer(staging.value().buffer, dst.buffer, vk::BufferCopy(0, offset, data.size()));
+
+    vk::MemoryBarrier upload_barrier;
+    upload_barrier
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead);
+
+    buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eVertexInput,
+                        {},
+                        upload_barrier,
+                        {},
+                        {});
+
+    res = buf.end();
+    if(res != vk::Result::eSuccess)
+    {
+        cleanup();
+        return res;
+    }
+
+    res = graphics_queue.value().second.submit(vk::SubmitInfo().setCommandBuffers(buf), fence.value);
+    if(res != vk::Result::eSuccess)
+    {
+        cleanup();
+        return res;
+    }
+
+    res = device.waitForFences(fence.value, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    cleanup();
+    return res;
+}
+
+GraphicsDevice::GraphicsDevice()
+{
+    #warning TBA!
+}
+
+GraphicsDevice::GraphicsDevice(GraphicsDevice &&gd) noexcept
+{
+    #warning TBA!
+}
+
+GraphicsDevice::~GraphicsDevice()
+{
+    record_thread_pool.stop();
+    if(device)
+    {
+        //see, what we can do with res?!
+        auto res = device.waitIdle();
+        discard_pipeline_rebuild();
+
+        //everything is completed, objects released from now on are destroyed in place
+        deletion_queue.Collect(frame_value);
+        deletion_queue.SetReleaseValue(0);
+
+        if(frames_comm_pool)
+        {
+            for(auto &frame : frames_sync)
+            {
+                for(auto &pool : frame.record_pools)
+                    device.destroy(pool);
+                allocator.DestroyBuffer(frame.instance_buffer);
+                allocator.DestroyBuffer(frame.readback_buffer);
+                device.destroy(frame.cpu_graphics_submit_fence);
+                device.destroy(frame.gpu_acquire_image_sem);
+                device.free(frames_comm_pool, frame.buf);
+            }
+        }
+
+        device.destroy(graphics_timeline);
+        device.destroy(frames_comm_pool);
+        frame_data_ring.destroy();
+
+        destroy_static_layer();
+        device.destroy(static_layer.comm_pool);
+        allocator.DestroyBuffer(static_layer.instance_buffer);
+
+        render_graph.destroy();
+        gpu_profiler.destroy();
+        gpu_culling.destroy();
+        uploader.destroy();
+        async_compute.destroy();
+        mesh_storage.destroy();
+        device.destroy(upload_comm_pool);
+
+        destroy_pipeline();
+        compile_thread_pool.stop();
+        layout_cache.destroy();
+        device.destroy(camera_squad.set_layout);
+        device.destroy(pipeline_cache);
+        for(auto &sh : shaders)
+            device.destroy(sh.second);
+        for(auto &sh : optional_shaders)
+            device.destroy(sh.second);
+
+        destroy_swapchain_framebuffers();
+        destroy_offscreen_target();
+
+        device.destroy(surface_renderpass);
+
+        device.destroy(swapchain_squad.swapchain);
+        destroy_present_semaphores();
+
+        deletion_queue.destroy();
+        allocator.destroy();
+
+        device.destroy();
+        //no cleanup!!!
+    }
+    parent_ph_dev = vk::PhysicalDevice();
+    draw_surface.reset();
+    #warning TBA!
+}
+
+auto GraphicsDevice::init(vk::PhysicalDevice &ph_dev) -> hrs::ResultDef<GraphicsDevice::Result>
+{
+    if(!is_headless && draw_surface.expired())
+        return {Result::error_code::SurfaceNotConnected};
+        //return WarningLevel::FatalError("Surface isn't connected yet!");
+    if(!ph_dev)
+        return {Result::error_code::PhysicalDeviceExpired};
+        //return WarningLevel::FatalError("PhysicalDevice isn't created yet!");
+
+    uint32_t queue_families_count = 0;
+    auto queue_props = ph_dev.getQueueFamilyProperties();
+
+    optional<uint32_t> graphics_presentation_queue_opt;
+    optional<uint32_t>  graphics_queue_opt;
+    optional<uint32_t>  presentation_queue_opt;
+    vk::Result res;
+    for(size_t i = 0; i < queue_props.size(); i++)
+    {
+        if(queue_props[i].queueFlags & vk::QueueFlagBits::eGraphics)
+        {
+            //nothing is presented, any graphics family fits
+            if(is_headless)
+            {
+                graphics_presentation_queue_opt = i;
+                break;
+            }
+
+            auto surface_supported = ph_dev.getSurfaceSupportKHR(i, *draw_surface.lock().get());
+            if(surface_supported.result != vk::Result::eSuccess)
+                return {surface_supported.result};
+                //return WarningLevel::FatalError(vk::to_string(surface_supported.result));
+
+            if(surface_supported.value)
+            {
+                graphics_presentation_queue_opt = i;
+                break;
+            }
+        }
+    }
+
+    if(!graphics_presentation_queue_opt)//we don't have queue that supports both presentation and rendering
+    {
+        for(size_t i = 0; i < queue_props.size(); i++)
+        {
+            if(queue_props[i].queueFlags & vk::QueueFlagBits::eGraphics)
+            {
+                graphics_queue_opt = i;
+                break;
+            }
+        }
+
+        if(!graphics_queue_opt)
+            return {Result::error_code::NoGraphicsQueue};
+            //return WarningLevel::FatalError("No one queue is supporting VK_QUEUE_GRAPHICS_BIT!");
+
+        for(size_t i = 0; i < queue_props.size(); i++)
+        {
+
+            auto surface_supported = ph_dev.getSurfaceSupportKHR(i, *draw_surface.lock().get());
+            if(surface_supported.result != vk::Result::eSuccess)
+                return {surface_supported.result};
+                //return WarningLevel::FatalError(vk::to_string(res));
+
+            if(surface_supported.value)
+            {
+                presentation_queue_opt = i;
+                break;
+            }
+        }
+
+        if(!presentation_queue_opt)
+            return {Result::error_code::NoPresentationQueue};
+            //return WarningLevel::FatalError("No one queue is supporting presentation!");
+    }
+
+    vector<vk::DeviceQueueCreateInfo> queue_infos;
+    float queue_priority[] = {1.0f};
+
+    if(graphics_presentation_queue_opt)
+    {
+        vk::DeviceQueueCreateInfo graphics_presentation_queue_info;
+        graphics_presentation_queue_info
+            .setFlags({})
+            .setQueueFamilyIndex(graphics_presentation_queue_opt.value())
+            .setQueueCount(1)
+            .setQueuePriorities(queue_priority);
+
+        queue_infos.push_back(graphics_presentation_queue_info);
+    }
+    else
+    {
+        queue_infos.reserve(2);
+        vk::DeviceQueueCreateInfo graphics_queue_info;
+        graphics_queue_info
+            .setFlags({})
+            .setQueueFamilyIndex(graphics_queue_opt.value())
+            .setQueueCount(1)
+            .setQueuePriorities(queue_priority);
+
+        vk::DeviceQueueCreateInfo presentation_queue_info;
+        presentation_queue_info
+            .setFlags({})
+            .setQueueFamilyIndex(presentation_queue_opt.value())
+            .setQueueCount(1)
+            .setQueuePriorities(queue_priority);
+
+        queue_infos.push_back(graphics_queue_info);
+        queue_infos.push_back(presentation_queue_info);
+    }
+
+    //transfer-only family is usually backed by DMA engine and works in parallel with rendering
+    optional<uint32_t> transfer_queue_opt;
+    for(size_t i = 0; i < queue_props.size(); i++)
+    {
+        auto flags = queue_props[i].queueFlags;
+        if((flags & vk::QueueFlagBits::eTransfer) && !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)))
+        {
+            transfer_queue_opt = i;
+            break;
+        }
+    }
+
+    if(transfer_queue_opt)
+    {
+        vk::DeviceQueueCreateInfo transfer_queue_info;
+        transfer_queue_info
+            .setFlags({})
+            .setQueueFamilyIndex(transfer_queue_opt.value())
+            .setQueueCount(1)
+            .setQueuePriorities(queue_priority);
+
+        queue_infos.push_back(transfer_queue_info);
+    }
+
+    //compute family without graphics runs dispatches in parallel with rendering
+    optional<uint32_t> compute_queue_opt;
+    for(size_t i = 0; i < queue_props.size(); i++)
+    {
+        auto flags = queue_props[i].queueFlags;
+        if((flags & vk::QueueFlagBits::eCompute) && !(flags & vk::QueueFlagBits::eGraphics))
+        {
+            compute_queue_opt = i;
+            break;
+        }
+    }
+
+    //presentation may be supported by such family, then queue is already requested
+    if(compute_queue_opt && compute_queue_opt != presentation_queue_opt)
+    {
+        vk::DeviceQueueCreateInfo compute_queue_info;
+        compute_queue_info
+            .setFlags({})
+            .setQueueFamilyIndex(compute_queue_opt.value())
+            .setQueueCount(1)
+            .setQueuePriorities(queue_priority);
+
+        queue_infos.push_back(compute_queue_info);
+    }
+
+    string missed_exts;
+
+    vector<const char *> extensions;
+    if(!is_headless)
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+    auto ext_props = ph_dev.enumerateDeviceExtensionProperties();
+    if(ext_props.result != vk::Result::eSuccess)
+        return {ext_props.result};
+        //return WarningLevel::FatalError(vk::to_string(ext_props.result));
+
+	for(auto &ext : extensions)
+	{
+		auto res = std::find_if(ext_props.value.begin(), ext_props.value.end(), [&](const vk::ExtensionProperties &ext_prop)
+			{
+				if(string_view(ext) == ext_prop.extensionName)
+					return true;
+
+                return false;
+			});
+
+		if(res == ext_props.value.end())
+		{
+			missed_exts += ext;
+			missed_exts.push_back(' ');
+		}
+	}
+
+	if(!missed_exts.empty())
+	{
+		missed_exts.pop_back();
+        return {Result::error_code::ExtensionNotSupported, string("These extensions are not supported: ") + missed_exts};
+		//return WarningLevel::FatalError(string("These extensions are not supported: " + missed_exts));
+	}
+
+
+    //instance is created with max supported version, so device can't be used above it
+    uint32_t api_version = VK_API_VERSION_1_0;
+    auto instance_version = vk::enumerateInstanceVersion();
+    if(instance_version.result == vk::Result::eSuccess)
+        api_version = std::min(instance_version.value, ph_dev.getProperties().apiVersion);
+
+    //GPU culling: compute shader writes indirect commands with firstInstance = object id
+    auto supported_features = ph_dev.getFeatures();
+	vk::PhysicalDeviceFeatures enabled_features;
+    enabled_features
+        .setMultiDrawIndirect(supported_features.multiDrawIndirect)
+        .setDrawIndirectFirstInstance(supported_features.drawIndirectFirstInstance);
+
+    vk::DeviceCreateInfo device_info;
+    device_info
+        .setFlags({})
+        .setQueueCreateInfos(queue_infos)
+        .setPEnabledLayerNames({})
+        .setPEnabledExtensionNames(extensions)
+        .setPEnabledFeatures(&enabled_features);
+
+    //drawIndexedIndirectCount is used only as core 1.2 function, static loader doesn't export KHR one
+    vk::PhysicalDeviceVulkan12Features enabled_features12;
+    vk::PhysicalDeviceVulkan13Features enabled_features13;
+    vk::PhysicalDeviceFeatures2 enabled_features2;
+    if(api_version >= VK_API_VERSION_1_2)
+    {
+        auto supported_chain = ph_dev.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+        auto &supported_features12 = supported_chain.get<vk::PhysicalDeviceVulkan12Features>();
+        enabled_features12
+            .setDrawIndirectCount(supported_features12.drawIndirectCount)
+            .setTimelineSemaphore(supported_features12.timelineSemaphore);
+
+        //beginRendering is used only as core 1.3 function, same as drawIndexedIndirectCount
+        if(api_version >= VK_API_VERSION_1_3)
+        {
+            auto supported_chain13 = ph_dev.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan13Features>();
+            enabled_features13.setDynamicRendering(supported_chain13.get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering);
+            enabled_features12.setPNext(&enabled_features13);
+        }
+
+        enabled_features2
+            .setFeatures(enabled_features)
+            .setPNext(&enabled_features12);
+
+        device_info
+            .setPEnabledFeatures(nullptr)
+            .setPNext(&enabled_features2);
+    }
+
+    auto created_device = ph_dev.createDevice(device_info);
+    if(created_device.result != vk::Result::eSuccess)
+        return {created_device.result};
+        //return WarningLevel::FatalError(vk::to_string(created_device.result));
+
+    device = move(created_device.value);
+
+    parent_ph_dev = ph_dev;
+    allocator.init(device, parent_ph_dev);
+    deletion_queue.init(device, allocator);
+    is_gpu_culling_supported = enabled_features.multiDrawIndirect && enabled_features.drawIndirectFirstInstance;
+    is_draw_indirect_count_supported = enabled_features12.drawIndirectCount;
+    is_timeline_semaphore_supported = enabled_features12.timelineSemaphore;
+    is_dynamic_rendering_enabled = enabled_features13.dynamicRendering;
+    vk::Queue recv_queue;
+    if(graphics_presentation_queue_opt)
+    {
+        graphics_queue_opt = graphics_presentation_queue_opt;
+        presentation_queue_opt = graphics_presentation_queue_opt;
+    }
+
+    recv_queue = device.getQueue(graphics_queue_opt.value(), 0);
+    graphics_queue = {graphics_queue_opt.value(), recv_queue};
+
+    recv_queue = device.getQueue(presentation_queue_opt.value(), 0);
+    presentation_queue = {presentation_queue_opt.value(), recv_queue};
+
+    if(transfer_queue_opt)
+    {
+        recv_queue = device.getQueue(transfer_queue_opt.value(), 0);
+        transfer_queue = {transfer_queue_opt.value(), recv_queue};
+    }
+
+    if(compute_queue_opt)
+    {
+        recv_queue = device.getQueue(compute_queue_opt.value(), 0);
+        compute_queue = {compute_queue_opt.value(), recv_queue};
+    }
+
+    return {Result::error_code::Success};
+    //return WarningLevel::Ok("Graphics device was successfully inited!");
+}
+
+auto GraphicsDevice::is_inited() -> bool
+{
+    return device;
+}
+
+auto GraphicsDevice::connect_surface(std::weak_ptr<vk::SurfaceKHR> sur) -> GraphicsDevice::Result
+{
+    if(!draw_surface.expired())
+        return Result::error_code::SurfaceAlreadyConnected;
+        //return WarningLevel::FatalError("Drawing surface is already connected!");
+
+    if(sur.expired())
+        return Result::error_code::SurfaceNotExist;
+        //return WarningLevel::FatalError("Passed surface is expired!");
+
+    draw_surface = sur;
+    return Result::error_code::Success;
+    //return WarningLevel::Ok("Surface is connected successfully");
+}
+
+auto GraphicsDevice::EnableHeadless() -> GraphicsDevice::Result
+{
+    if(!draw_surface.expired())
+        return Result::error_code::SurfaceAlreadyConnected;
+
+    if(device)
+        return vk::Result::eErrorInitializationFailed;
+
+    is_headless = true;
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::IsHeadless() -> bool
+{
+    return is_headless;
+}
+
+auto GraphicsDevice::RequestReadback() -> GraphicsDevice::Result
+{
+    if(!is_headless)
+        return Result::error_code::HeadlessOnly;
+
+    if(!is_env_created)
+        return Result::error_code::EnvironmentNotCreated;
+
+    is_readback_requested = true;
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::TryGetReadback(std::vector<uint8_t> &pixels) -> hrs::expected<bool, GraphicsDevice::Result>
+{
+    if(!is_headless)
+        return Result(Result::error_code::HeadlessOnly);
+
+    if(!pending_readback_slot)
+        return false;
+
+    //slot isn't waited here, frame is taken only when it's already done
+    auto &frame = frames_sync[pending_readback_slot.value()];
+    auto completed = get_completed_frame_value();
+    if(!completed.has_value())
+        return Result(completed.error());
+
+    if(completed.value() < frame.submit_value)
+        return false;
+
+    vk::DeviceSize size = vk::DeviceSize(swapchain_squad.image_extent.width) * swapchain_squad.image_extent.height * 4;
+    auto res = allocator.Invalidate(frame.readback_buffer.allocation, 0, size);
+    if(res != vk::Result::eSuccess)
+        return Result(res);
+
+    auto pixels_ptr = static_cast<const uint8_t *>(frame.readback_buffer.allocation.mapped_ptr);
+    pixels.assign(pixels_ptr, pixels_ptr + size);
+    pending_readback_slot.reset();
+    return true;
+}
+
+auto GraphicsDevice::WaitReadback(std::vector<uint8_t> &pixels) -> hrs::expected<bool, GraphicsDevice::Result>
+{
+    if(!is_headless)
+        return Result(Result::error_code::HeadlessOnly);
+
+    if(!pending_readback_slot)
+        return false;
+
+    auto res = wait_frame_value(frames_sync[pending_readback_slot.value()].submit_value);
+    if(res != vk::Result::eSuccess)
+        return Result(res);
+
+    return TryGetReadback(pixels);
+}
+
+auto GraphicsDevice::is_surface_connected() -> bool
+{
+    return !draw_surface.expired();
+}
+
+auto GraphicsDevice::QueryShaders() -> std::vector<std::string_view>
+{
+    vector<string_view> shaders_names;
+    shaders_names.reserve(shaders.size());
+    for(auto &sh : shaders)
+        shaders_names.push_back(sh.first);
+    return shaders_names;
+}
+
+auto GraphicsDevice::QueryOptionalShaders() -> std::vector<std::string_view>
+{
+    vector<string_view> shaders_names;
+    shaders_names.reserve(optional_shaders.size());
+    for(auto &sh : optional_shaders)
+        shaders_names.push_back(sh.first);
+    return shaders_names;
+}
+
+#warning no cleanup here!
+auto GraphicsDevice::CreateWorkEnv(const DrawableAreaParams &params, const std::vector<LoadedShaderProps> &loaded, uint32_t frames_count,
+                                   std::span<const uint8_t> pipeline_cache_data) -> hrs::ResultDef<GraphicsDevice::Result>
+{
+    Result res;
+    if(is_headless)
+        res = create_offscreen_target(params.width, params.height, std::clamp(frames_count, 1u, MAX_FRAMES_IN_FLIGHT));
+    else
+    {
+        res = create_swapchain(params.width, params.height, params.mode, params.image_count);
+        if(res.code == Result::error_code::Success)
+            res = create_present_semaphores();
+    }
+
+    if(res.code != Result::error_code::Success)
+        return res;
+
+    res = create_renderpass();
+    if(res.code != Result::error_code::Success)
+        return res;
+
+    auto res_def = load_shaders(loaded);
+    if(res_def.error.code != Result::error_code::Success)
+        return res_def;
+
+    if(!pipeline_cache)
+    {
+        res = create_pipeline_cache(pipeline_cache_data);
+        if(res.code != Result::error_code::Success)
+            return res;
+    }
+
+    res = create_frame_data_ring(frames_count);
+    if(res.code != Result::error_code::Success)
+        return res;
+
+    //camera set layout is part of pipeline layout
+    res = create_static_layer();
+    if(res.code != Result::error_code::Success)
+        return res;
+
+    res = create_pipeline();
+    if(res.code != Result::error_code::Success)
+        return res;
+
+    res = create_frames_property(frames_count);
+    if(res.code != Result::error_code::Success)
+        return res;
 
-        device.destroy(pipeline_squad.ppl);
-        device.destroy(pipeline_squad.ppl_layout);
-        for(auto &sh : shaders)
-            device.destroy(sh.second);
+    //mesh storage is shared with transfer family of uploader
+    res = create_uploader();
+    if(res.code != Result::error_code::Success)
+        return res;
+
+    res = create_mesh_storage();
+    if(res.code != Result::error_code::Success)
+        return res;
 
-        for(auto &fb: swapchain_squad.swapchain_framebuffers)
-            device.destroy(fb);
+    res = create_async_compute();
+    if(res.code != Result::error_code::Success)
+        return res;
 
-        device.destroy(surface_renderpass);
+    res = create_gpu_culling();
+    if(res.code != Result::error_code::Success)
+        return res;
 
-        for(auto &img_v: swapchain_squad.swapchain_images_views)
-            device.destroy(img_v);
+    res = create_gpu_profiler();
+    if(res.code != Result::error_code::Success)
+        return res;
 
-        device.destroy(swapchain_squad.swapchain);
+    res = create_render_graph();
+    if(res.code != Result::error_code::Success)
+        return res;
 
-        device.destroy();
-        //no cleanup!!!
-    }
-    parent_ph_dev = vk::PhysicalDevice();
-    draw_surface.reset();
-    #warning TBA!
+    res = create_swapchain_framebuffers();
+    if(res.code != Result::error_code::Success)
+        return res;
+
+    //everything above overlaps with pipeline compilation, now first frame needs its pipelines
+    res = take_compiled_pipelines(false);
+    if(res.code != Result::error_code::Success)
+        return res;
+
+    drawable_area_params = params;
+    is_drawable_area_out_of_date = false;
+    is_env_created = true;
+
+    return {Result::error_code::Success};
+    //return WarningLevel::Ok("Environment created!");
 }
 
-auto GraphicsDevice::init(vk::PhysicalDevice &ph_dev) -> hrs::ResultDef<GraphicsDevice::Result>
+auto GraphicsDevice::RecreateDrawableArea(const DrawableAreaParams &params) -> GraphicsDevice::Result
 {
-    if(draw_surface.expired())
-        return {Result::error_code::SurfaceNotConnected};
-        //return WarningLevel::FatalError("Surface isn't connected yet!");
-    if(!ph_dev)
-        return {Result::error_code::PhysicalDeviceExpired};
-        //return WarningLevel::FatalError("PhysicalDevice isn't created yet!");
+    if(!is_env_created)
+        return Result::error_code::EnvironmentNotCreated;
 
-    uint32_t queue_families_count = 0;
-    auto queue_props = ph_dev.getQueueFamilyProperties();
+    //frames in flight may still use old images, views and framebuffers, they're destroyed through deletion queue
 
-    optional<uint32_t> graphics_presentation_queue_opt;
-    optional<uint32_t>  graphics_queue_opt;
-    optional<uint32_t>  presentation_queue_opt;
-    vk::Result res;
-    for(size_t i = 0; i < queue_props.size(); i++)
+    //offscreen format never changes, so only images and things sized by them are recreated
+    if(is_headless)
     {
-        if(queue_props[i].queueFlags & vk::QueueFlagBits::eGraphics)
+        destroy_static_layer();
+        destroy_swapchain_framebuffers();
+        destroy_offscreen_target();
+        for(auto &frame : frames_sync)
         {
-            auto surface_supported = ph_dev.getSurfaceSupportKHR(i, *draw_surface.lock().get());
-            if(surface_supported.result != vk::Result::eSuccess)
-                return {surface_supported.result};
-                //return WarningLevel::FatalError(vk::to_string(surface_supported.result));
+            deletion_queue.Push(frame.readback_buffer);
+            frame.readback_buffer = {};
+        }
+        pending_readback_slot.reset();
 
-            if(surface_supported.value)
-            {
-                graphics_presentation_queue_opt = i;
-                break;
-            }
+        auto res = create_offscreen_target(params.width, params.height, frames_in_flight);
+        if(res.code == Result::error_code::Success)
+            res = create_render_graph();
+        if(res.code == Result::error_code::Success)
+            res = create_swapchain_framebuffers();
+        if(res.code == Result::error_code::Success)
+            res = create_static_layer();
+
+        if(res.code != Result::error_code::Success)
+        {
+            is_env_created = false;
+            return res;
         }
+
+        swapchain_squad.images_in_flight.assign(swapchain_squad.swapchain_images.size(), 0);
+        drawable_area_params = params;
+        is_drawable_area_out_of_date = false;
+        return Result::error_code::Success;
     }
 
-    if(!graphics_presentation_queue_opt)//we don't have queue that supports both presentation and rendering
+    auto old_swapchain = swapchain_squad.swapchain;
+    auto old_format = swapchain_squad.image_format;
+    auto res = create_swapchain(params.width, params.height, params.mode, params.image_count, old_swapchain);
+    if(res.code == Result::error_code::DrawableAreaIsEmpty)
     {
-        for(size_t i = 0; i < queue_props.size(); i++)
+        //keep old swapchain until window is restored
+        drawable_area_params = params;
+        is_drawable_area_out_of_date = true;
+        return Result::error_code::Success;
+    }
+
+    //old swapchain is retired even if creation failed
+    destroy_static_layer();
+    destroy_swapchain_framebuffers();
+    destroy_present_semaphores();
+    deletion_queue.Push(old_swapchain);
+
+    if(res.code != Result::error_code::Success)
+    {
+        swapchain_squad.swapchain = vk::SwapchainKHR();
+        is_env_created = false;
+        return res;
+    }
+
+    //image count may change with swapchain
+    res = create_present_semaphores();
+    if(res.code != Result::error_code::Success)
+    {
+        is_env_created = false;
+        return res;
+    }
+
+    //pipelines depend only on attachment formats, through renderpass or rendering info
+    if(old_format != swapchain_squad.image_format)
+    {
+        //pending pipelines are built against old renderpass, shaders of rebuild are taken anyway
+        apply_pipeline_rebuild(true);
+        destroy_pipeline();
+        deletion_queue.Push(surface_renderpass);
+        surface_renderpass = vk::RenderPass();
+
+        res = create_renderpass();
+        if(res.code != Result::error_code::Success)
         {
-            if(queue_props[i].queueFlags & vk::QueueFlagBits::eGraphics)
-            {
-                graphics_queue_opt = i;
-                break;
-            }
+            is_env_created = false;
+            return res;
         }
 
-        if(!graphics_queue_opt)
-            return {Result::error_code::NoGraphicsQueue};
-            //return WarningLevel::FatalError("No one queue is supporting VK_QUEUE_GRAPHICS_BIT!");
+        res = create_pipeline();
+        if(res.code == Result::error_code::Success)
+            res = take_compiled_pipelines(false);
 
-        for(size_t i = 0; i < queue_props.size(); i++)
+        if(res.code != Result::error_code::Success)
         {
+            is_env_created = false;
+            return res;
+        }
+    }
 
-            auto surface_supported = ph_dev.getSurfaceSupportKHR(i, *draw_surface.lock().get());
-            if(surface_supported.result != vk::Result::eSuccess)
-                return {surface_supported.result};
-                //return WarningLevel::FatalError(vk::to_string(res));
+    //transient images follow drawable area size, framebuffers take depth view from graph
+    res = create_render_graph();
+    if(res.code != Result::error_code::Success)
+    {
+        is_env_created = false;
+        return res;
+    }
 
-            if(surface_supported.value)
-            {
-                presentation_queue_opt = i;
-                break;
-            }
-        }
+    res = create_swapchain_framebuffers();
+    if(res.code == Result::error_code::Success)
+        res = create_static_layer();
 
-        if(!presentation_queue_opt)
-            return {Result::error_code::NoPresentationQueue};
-            //return WarningLevel::FatalError("No one queue is supporting presentation!");
+    if(res.code != Result::error_code::Success)
+    {
+        is_env_created = false;
+        return res;
     }
 
-    vector<vk::DeviceQueueCreateInfo> queue_infos;
-    float queue_priority[] = {1.0f};
+    swapchain_squad.images_in_flight.assign(swapchain_squad.swapchain_images.size(), 0);
+    drawable_area_params = params;
+    is_drawable_area_out_of_date = false;
 
-    if(graphics_presentation_queue_opt)
+    return Result::error_code::Success;
+}
+
+auto GraphicsDevice::GetDrawableAreaParams() -> DrawableAreaParams
+{
+    return drawable_area_params;
+}
+
+auto GraphicsDevice::GetPresentMode() -> vk::PresentModeKHR
+{
+    return swapchain_squad.present_mode;
+}
+
+auto GraphicsDevice::GetSwapchainImageCount() -> uint32_t
+{
+    return swapchain_squad.swapchain_images.size();
+}
+
+auto GraphicsDevice::AddMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices) -> hrs::expected<MeshHandle, GraphicsDevice::Result>
+{
+    if(!is_env_created)
+        return Result(Result::error_code::EnvironmentNotCreated);
+
+    auto mesh = mesh_storage.AllocateMesh(static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(indices.size()));
+    if(!mesh)
+        return Result(vk::Result::eErrorOutOfPoolMemory);
+
+    auto res = upload_buffer(mesh_storage.GetVertexBuffer(),
+                             static_cast<vk::DeviceSize>(mesh->vertex_offset) * sizeof(Vertex),
+                             span<const uint8_t>(reinterpret_cast<const uint8_t *>(vertices.data()), vertices.size_bytes()));
+    if(res != vk::Result::eSuccess)
     {
-        vk::DeviceQueueCreateInfo graphics_presentation_queue_info;
-        graphics_presentation_queue_info
-            .setFlags({})
-            .setQueueFamilyIndex(graphics_presentation_queue_opt.value())
-            .setQueueCount(1)
-            .setQueuePriorities(queue_priority);
+        mesh_storage.FreeMesh(mesh.value());
+        return Result(res);
+    }
 
-        queue_infos.push_back(graphics_presentation_queue_info);
+    res = upload_buffer(mesh_storage.GetIndexBuffer(),
+                        static_cast<vk::DeviceSize>(mesh->first_index) * sizeof(uint32_t),
+                        span<const uint8_t>(reinterpret_cast<const uint8_t *>(indices.data()), indices.size_bytes()));
+    if(res != vk::Result::eSuccess)
+    {
+        mesh_storage.FreeMesh(mesh.value());
+        return Result(res);
     }
-    else
+
+    return mesh.value();
+}
+
+auto GraphicsDevice::RemoveMesh(const MeshHandle &mesh) -> GraphicsDevice::Result
+{
+    if(!is_env_created)
+        return Result::error_code::EnvironmentNotCreated;
+
+    //ranges may be still read by frames in flight
+    deletion_queue.Push(DeletionQueue::Callback([this, mesh]()
     {
-        queue_infos.reserve(2);
-        vk::DeviceQueueCreateInfo graphics_queue_info;
-        graphics_queue_info
-            .setFlags({})
-            .setQueueFamilyIndex(graphics_queue_opt.value())
-            .setQueueCount(1)
-            .setQueuePriorities(queue_priority);
+        mesh_storage.FreeMesh(mesh);
+    }));
 
-        vk::DeviceQueueCreateInfo presentation_queue_info;
-        graphics_queue_info
-            .setFlags({})
-            .setQueueFamilyIndex(presentation_queue_opt.value())
-            .setQueueCount(1)
-            .setQueuePriorities(queue_priority);
+    return Result::error_code::Success;
+}
 
-        queue_infos.push_back(graphics_queue_info);
-        queue_infos.push_back(presentation_queue_info);
-    }
+auto GraphicsDevice::AddCulledObject(const MeshHandle &mesh, const twv::glsl::Mat4x4 &transform, const twv::glsl::Vec4 &bounding_sphere) -> hrs::expected<uint32_t, GraphicsDevice::Result>
+{
+    if(!gpu_culling.is_inited())
+        return Result(Result::error_code::GpuCullingNotAvailable);
 
-    string missed_exts;
+    auto id = gpu_culling.AddObject(mesh, transform, bounding_sphere);
+    if(!id)
+        return Result(vk::Result::eErrorOutOfPoolMemory);
 
-    vector<const char *> extensions
-    {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-    };
+    return id.value();
+}
 
-    auto ext_props = ph_dev.enumerateDeviceExtensionProperties();
-    if(ext_props.result != vk::Result::eSuccess)
-        return {ext_props.result};
-        //return WarningLevel::FatalError(vk::to_string(ext_props.result));
+auto GraphicsDevice::UpdateCulledObject(uint32_t id, const twv::glsl::Mat4x4 &transform, const twv::glsl::Vec4 &bounding_sphere) -> GraphicsDevice::Result
+{
+    if(!gpu_culling.is_inited())
+        return Result::error_code::GpuCullingNotAvailable;
 
-	for(auto &ext : extensions)
-	{
-		auto res = std::find_if(ext_props.value.begin(), ext_props.value.end(), [&](const vk::ExtensionProperties &ext_prop)
-			{
-				if(string_view(ext) == ext_prop.extensionName)
-					return true;
+    if(!gpu_culling.UpdateObject(id, transform, bounding_sphere))
+        return Result::error_code::InvalidObjectId;
 
-                return false;
-			});
+    return Result::error_code::Success;
+}
 
-		if(res == ext_props.value.end())
-		{
-			missed_exts += ext;
-			missed_exts.push_back(' ');
-		}
-	}
+auto GraphicsDevice::RemoveCulledObject(uint32_t id) -> GraphicsDevice::Result
+{
+    if(!gpu_culling.is_inited())
+        return Result::error_code::GpuCullingNotAvailable;
 
-	if(!missed_exts.empty())
-	{
-		missed_exts.pop_back();
-        return {Result::error_code::ExtensionNotSupported, string("These extensions are not supported: ") + missed_exts};
-		//return WarningLevel::FatalError(string("These extensions are not supported: " + missed_exts));
-	}
+    if(!gpu_culling.RemoveObject(id))
+        return Result::error_code::InvalidObjectId;
 
+    return Result::error_code::Success;
+}
 
-	vk::PhysicalDeviceFeatures enabled_features;//Use for future!
+auto GraphicsDevice::AllocateFrameData(vk::DeviceSize size) -> hrs::expected<FrameDataRing::Chunk, GraphicsDevice::Result>
+{
+    if(!is_env_created)
+        return Result(Result::error_code::EnvironmentNotCreated);
 
-    vk::DeviceCreateInfo device_info;
-    device_info
-        .setFlags({})
-        .setQueueCreateInfos(queue_infos)
-        .setPEnabledLayerNames({})
-        .setPEnabledExtensionNames(extensions)
-        .setPEnabledFeatures(&enabled_features);
+    //first chunk of the frame waits until GPU releases region of the slot
+    if(!frame_data_ring.IsFrameBegun())
+    {
+        auto res = wait_frame_value(frames_sync[target_frame_ind].submit_value);
+        if(res != vk::Result::eSuccess)
+            return Result(res);
 
-    auto created_device = ph_dev.createDevice(device_info);
-    if(created_device.result != vk::Result::eSuccess)
-        return {created_device.result};
-        //return WarningLevel::FatalError(vk::to_string(created_device.result));
+        frame_data_ring.BeginFrame(target_frame_ind);
+    }
 
-    device = move(created_device.value);
+    auto chunk = frame_data_ring.Allocate(size);
+    if(!chunk)
+        return Result(vk::Result::eErrorOutOfPoolMemory);
 
-    parent_ph_dev = ph_dev;
-    vk::Queue recv_queue;
-    if(graphics_presentation_queue_opt)
+    return chunk.value();
+}
+
+auto GraphicsDevice::SetStaticDraws(std::span<const InstancedMeshDraw> draws) -> GraphicsDevice::Result
+{
+    if(!is_env_created)
+        return Result::error_code::EnvironmentNotCreated;
+
+    //chunks live only for one frame of one slot
+    for(auto &draw : draws)
+        if(draw.uniform_offset || draw.storage_offset)
+            return Result::error_code::StaticDrawHasFrameData;
+
+    //pushed view_proj would be baked into buffers and they'd be re-recorded every frame
+    if(!draws.empty() && !pipeline_squad.has_camera_buffer)
+        return Result::error_code::StaticLayerNeedsCameraBuffer;
+
+    //instance buffer may be used by frames in flight, static buffers are re-recorded only for completed images
+    deletion_queue.Push(static_layer.instance_buffer);
+    static_layer.instance_buffer = {};
+    static_layer.transforms.clear();
+    static_layer.draws.clear();
+    static_layer.version++;
+
+    size_t instances_count = 0;
+    for(auto &draw : draws)
+        instances_count += draw.transforms.size();
+
+    if(instances_count == 0)
+        return Result::error_code::Success;
+
+    //reserved, so spans of draws stay valid
+    static_layer.transforms.reserve(instances_count);
+    for(auto &draw : draws)
     {
-        graphics_queue_opt = graphics_presentation_queue_opt;
-        presentation_queue_opt = graphics_presentation_queue_opt;
+        if(draw.transforms.empty())
+            continue;
+
+        auto first = static_layer.transforms.end();
+        static_layer.transforms.insert(first, draw.transforms.begin(), draw.transforms.end());
+        static_layer.draws.push_back(InstancedMeshDraw
+        {
+            .mesh = draw.mesh,
+            .transforms = span<const twv::glsl::Mat4x4>(static_layer.transforms.end() - draw.transforms.size(), static_layer.transforms.end())
+        });
     }
 
-    recv_queue = device.getQueue(graphics_queue_opt.value(), 0);
-    graphics_queue = {graphics_queue_opt.value(), recv_queue};
+    auto families = get_upload_queue_families();
+    vk::BufferCreateInfo instance_info;
+    instance_info
+        .setFlags({})
+        .setSize(static_cast<vk::DeviceSize>(instances_count) * sizeof(twv::glsl::Mat4x4))
+        .setUsage(vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst)
+        .setSharingMode(families.size() > 1 ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive)
+        .setQueueFamilyIndices(families);
 
-    recv_queue = device.getQueue(presentation_queue_opt.value(), 0);
-    presentation_queue = {presentation_queue_opt.value(), recv_queue};
+    auto instance_tmp = allocator.CreateBuffer(instance_info, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    if(!instance_tmp.has_value())
+    {
+        static_layer.transforms.clear();
+        static_layer.draws.clear();
+        return instance_tmp.error();
+    }
+
+    static_layer.instance_buffer = instance_tmp.value();
+    auto res = upload_buffer(static_layer.instance_buffer,
+                             0,
+                             span<const uint8_t>(reinterpret_cast<const uint8_t *>(static_layer.transforms.data()),
+                                                 static_layer.transforms.size() * sizeof(twv::glsl::Mat4x4)));
+    if(res != vk::Result::eSuccess)
+    {
+        allocator.DestroyBuffer(static_layer.instance_buffer);
+        static_layer.transforms.clear();
+        static_layer.draws.clear();
+        return res;
+    }
 
-    return {Result::error_code::Success};
-    //return WarningLevel::Ok("Graphics device was successfully inited!");
+    return Result::error_code::Success;
 }
 
-auto GraphicsDevice::is_inited() -> bool
+auto GraphicsDevice::GetStaticRecordCount() -> uint64_t
 {
-    return device;
+    return static_layer.record_count;
 }
 
-auto GraphicsDevice::connect_surface(std::weak_ptr<vk::SurfaceKHR> sur) -> GraphicsDevice::Result
+auto GraphicsDevice::CreateComputePipeline(std::span<const uint32_t> code) -> hrs::expected<ComputePipeline, GraphicsDevice::Result>
 {
-    if(!draw_surface.expired())
-        return Result::error_code::SurfaceAlreadyConnected;
-        //return WarningLevel::FatalError("Drawing surface is already connected!");
+    if(!device)
+        return Result(Result::error_code::DeviceNotCreated);
 
-    if(sur.expired())
-        return Result::error_code::SurfaceNotExist;
-        //return WarningLevel::FatalError("Passed surface is expired!");
+    auto refl = ShaderReflection::Reflect(code);
+    if(!refl.has_value())
+        return Result(Result::error_code::ShaderReflectionError);
 
-    draw_surface = sur;
-    return Result::error_code::Success;
-    //return WarningLevel::Ok("Surface is connected successfully");
-}
+    if(refl.value().stage != vk::ShaderStageFlagBits::eCompute)
+        return Result(Result::error_code::ShaderInterfaceMismatch);
 
-auto GraphicsDevice::is_surface_connected() -> bool
-{
-    return !draw_surface.expired();
+    if(!layout_cache.is_inited())
+        layout_cache.init(device);
+
+    auto layout_tmp = layout_cache.GetLayout(span<const ShaderReflection>(&refl.value(), 1));
+    if(!layout_tmp.has_value())
+        return Result(layout_tmp.error());
+
+    vk::ShaderModuleCreateInfo module_info;
+    module_info
+        .setFlags({})
+        .setCode(code);
+
+    auto module_tmp = device.createShaderModule(module_info);
+    if(module_tmp.result != vk::Result::eSuccess)
+        return Result(module_tmp.result);
+
+    vk::ComputePipelineCreateInfo ppl_info;
+    ppl_info
+        .setFlags({})
+        .setStage(vk::PipelineShaderStageCreateInfo()
+                    .setFlags({})
+                    .setStage(vk::ShaderStageFlagBits::eCompute)
+                    .setModule(module_tmp.value)
+                    .setPName("main"))
+        .setLayout(layout_tmp.value().layout);
+
+    //module isn't needed after creation
+    auto ppl_tmp = device.createComputePipelines(pipeline_cache, ppl_info);
+    device.destroy(module_tmp.value);
+    if(ppl_tmp.result != vk::Result::eSuccess)
+        return Result(ppl_tmp.result);
+
+    auto &layout = layout_tmp.value();
+    return ComputePipeline
+    {
+        .ppl = ppl_tmp.value[0],
+        .layout = layout.layout,
+        .set_layouts = move(layout.set_layouts),
+        .push_constant = layout.push_constant
+    };
 }
 
-auto GraphicsDevice::QueryShaders() -> std::vector<std::string_view>
+auto GraphicsDevice::DestroyComputePipeline(const ComputePipeline &ppl) -> void
 {
-    vector<string_view> shaders_names;
-    shaders_names.reserve(shaders.size());
-    for(auto &sh : shaders)
-        shaders_names.push_back(sh.first);
-    return shaders_names;
+    deletion_queue.Push(ppl.ppl);
 }
 
-#warning no cleanup here!
-auto GraphicsDevice::CreateWorkEnv(const DrawableAreaParams &params, const std::vector<LoadedShaderProps> &loaded) -> hrs::ResultDef<GraphicsDevice::Result>
+auto GraphicsDevice::AddComputePass(ComputeQueue::RecordFunc &&record, vk::PipelineStageFlags graphics_stages, bool is_after_graphics) -> GraphicsDevice::Result
 {
-    auto res = create_swapchain(params.width, params.height, params.mode);
-    if(res.code != Result::error_code::Success)
-        return res;
-
-    res = create_renderpass();
-    if(res.code != Result::error_code::Success)
-        return res;
-
-    res = create_swapchain_framebuffers();
-    if(res.code != Result::error_code::Success)
-        return res;
-
-    auto res_def = load_shaders(loaded);
-    if(res_def.error.code != Result::error_code::Success)
-        return res;
+    if(!is_env_created)
+        return Result::error_code::EnvironmentNotCreated;
 
-    res = create_pipeline();
-    if(res.code != Result::error_code::Success)
-        return res;
+    async_compute.AddPass(move(record), graphics_stages, is_after_graphics);
+    return Result::error_code::Success;
+}
 
-    res = create_frames_property();
-    if(res.code != Result::error_code::Success)
-        return res;
+auto GraphicsDevice::IsAsyncComputeEnabled() -> bool
+{
+    return async_compute.IsAsync() && compute_queue.has_value();
+}
 
-    is_env_created = true;
+auto GraphicsDevice::GetComputeQueueFamilies() -> std::vector<uint32_t>
+{
+    return async_compute.GetQueueFamilies();
+}
 
-    return {Result::error_code::Success};
-    //return WarningLevel::Ok("Environment created!");
+auto GraphicsDevice::Draw(const twv::glsl::Mat4x4 &model) -> GraphicsDevice::Result
+{
+    return DrawInstanced(model, {});
 }
 
-auto GraphicsDevice::RecreateDrawableArea(const DrawableAreaParams &params) -> GraphicsDevice::Result
+auto GraphicsDevice::Draw(const twv::glsl::Mat4x4 &model, std::span<const MeshHandle> meshes) -> GraphicsDevice::Result
 {
+    //every mesh is single instance with identity transform, model goes through push constant
+    static const twv::glsl::Mat4x4 identity = twv::glsl::Mat4x4::identity();
+
+    vector<InstancedMeshDraw> draws;
+    draws.reserve(meshes.size());
+    for(auto &mesh : meshes)
+        draws.push_back(InstancedMeshDraw{.mesh = mesh, .transforms = span<const twv::glsl::Mat4x4>(&identity, 1)});
 
+    return DrawInstanced(model, draws);
 }
 
-auto GraphicsDevice::Draw(const twv::glsl::Mat4x4 &model) -> GraphicsDevice::Result
+auto GraphicsDevice::DrawInstanced(const twv::glsl::Mat4x4 &view_proj, std::span<const InstancedMeshDraw> draws) -> GraphicsDevice::Result
 {
     if(!is_env_created)
         return Result::error_code::EnvironmentNotCreated;
 
+    //frame may be skipped without ExplicitBlindDraw
+    last_frame_timings = FrameTimings{};
+
+    //frame boundary: nothing recorded yet uses current pipelines
+    auto take_res = take_compiled_pipelines(false);
+    if(take_res.code != Result::error_code::Success)
+        return take_res;
+
+    apply_pipeline_rebuild(false);
+    auto release_res = collect_deletions();
+    if(release_res != vk::Result::eSuccess)
+        return release_res;
+
     /*if(!frames_comm_pool)
         return WarningLevel::FatalError("Frames property isn't allocated yet!");
 
@@ -973,8 +3328,31 @@ auto GraphicsDevice::Draw(const twv::glsl::Mat4x4 &model) -> GraphicsDevice::Res
         return WarningLevel::FatalError("Pipeline isn't allocated yet!");
     */
 
-	auto blind_res = ExplicitBlindDraw(model);
-    if(blind_res != vk::Result::eSuccess)
+    if(is_drawable_area_out_of_date)
+    {
+        auto recreate_res = RecreateDrawableArea(drawable_area_params);
+        if(recreate_res.code != Result::error_code::Success)
+            return recreate_res;
+
+        //window is minimized, just skip frame
+        if(is_drawable_area_out_of_date)
+        {
+            //data of skipped frame is dropped, next frame starts region from scratch
+            auto end_res = frame_data_ring.EndFrame();
+            if(end_res != vk::Result::eSuccess)
+                return end_res;
+
+            return Result::error_code::Success;
+        }
+    }
+
+	auto blind_res = ExplicitBlindDraw(view_proj, draws);
+    if(blind_res == vk::Result::eErrorOutOfDateKHR || blind_res == vk::Result::eSuboptimalKHR)
+    {
+        is_drawable_area_out_of_date = true;
+        return Result::error_code::Success;
+    }
+    else if(blind_res != vk::Result::eSuccess)
         return blind_res;
         //return WarningLevel::FatalError(vk::to_string(blind_res));
 
@@ -982,86 +3360,321 @@ auto GraphicsDevice::Draw(const twv::glsl::Mat4x4 &model) -> GraphicsDevice::Res
     //return WarningLevel::Ok();
 }
 
-auto GraphicsDevice::ExplicitBlindDraw(const twv::glsl::Mat4x4 &model) -> vk::Result
+auto GraphicsDevice::release_acquired_image(AcquireFrameSync &frame, bool is_fence_reset) -> void
+{
+    if(is_headless && !is_fence_reset)
+        return;
+
+    //frame already fails, its error is returned, so errors here are ignored
+    if(!graphics_timeline && !is_fence_reset)
+    {
+        //device is lost if even reset fails, nothing can be waited anymore
+        if(device.resetFences(frame.cpu_graphics_submit_fence) != vk::Result::eSuccess)
+            return;
+    }
+
+    vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eAllCommands;
+    uint64_t submit_value = frame_value + 1;
+    vk::TimelineSemaphoreSubmitInfo timeline_info;
+    timeline_info.setSignalSemaphoreValues(submit_value);
+
+    vk::SubmitInfo submit_info;
+    if(!is_headless)
+        submit_info
+            .setWaitSemaphores(frame.gpu_acquire_image_sem)
+            .setWaitDstStageMask(wait_stage);
+
+    if(graphics_timeline)
+        submit_info
+            .setPNext(&timeline_info)
+            .setSignalSemaphores(graphics_timeline);
+
+    //empty submit is numbered like a frame, so next use of the slot waits it instead of idling queue now
+    auto res = graphics_queue.value().second.submit(submit_info, graphics_timeline ? vk::Fence() : frame.cpu_graphics_submit_fence);
+    if(res == vk::Result::eSuccess)
+    {
+        frame_value = submit_value;
+        frame.submit_value = submit_value;
+        deletion_queue.SetReleaseValue(submit_value);
+    }
+
+    //image is never presented, recreated swapchain gives it back
+    if(!is_headless)
+        is_drawable_area_out_of_date = true;
+}
+
+auto GraphicsDevice::ExplicitBlindDraw(const twv::glsl::Mat4x4 &view_proj, std::span<const InstancedMeshDraw> draws) -> vk::Result
 {
+    auto &frame = frames_sync[target_frame_ind];
+
+    using clock = std::chrono::steady_clock;
+    auto ms_since = [](clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    };
+
+    last_frame_timings = FrameTimings{};
+    auto stage_start = clock::now();
+
     //add timeout check!
-    auto res = device.waitForFences(frames_sync[target_frame_ind].cpu_graphics_submit_fence, VK_FALSE, std::numeric_limits<uint64_t>::max());
+    auto res = wait_frame_value(frame.submit_value);
+    last_frame_timings.fence_wait = ms_since(stage_start);
     if(res != vk::Result::eSuccess)
         return res;
 
-    res = device.resetFences(frames_sync[target_frame_ind].cpu_graphics_submit_fence);
+    if(!frame_data_ring.IsFrameBegun())
+        frame_data_ring.BeginFrame(target_frame_ind);
+
+    //everything that may fail without image goes before acquire, slot is free already
+    uint32_t instances_count = 0;
+    for(auto &draw : draws)
+        instances_count += draw.transforms.size();
+
+    res = reserve_instances(frame, instances_count);
     if(res != vk::Result::eSuccess)
         return res;
 
-    auto acquired_img_ind = device.acquireNextImageKHR(swapchain_squad.swapchain, std::numeric_limits<uint64_t>::max(), frames_sync[target_frame_ind].gpu_acquire_image_sem, {});
-    if(acquired_img_ind.result != vk::Result::eSuccess)
-        return res;
+    bool is_readback = is_headless && is_readback_requested;
+    if(is_readback && !frame.readback_buffer.buffer)
+    {
+        vk::BufferCreateInfo readback_info;
+        readback_info
+            .setSize(vk::DeviceSize(swapchain_squad.image_extent.width) * swapchain_squad.image_extent.height * 4)
+            .setUsage(vk::BufferUsageFlagBits::eTransferDst)
+            .setSharingMode(vk::SharingMode::eExclusive);
+
+        auto readback_tmp = allocator.CreateBuffer(readback_info,
+                                                   vk::MemoryPropertyFlagBits::eHostVisible,
+                                                   vk::MemoryPropertyFlagBits::eHostCached);
+        if(!readback_tmp.has_value())
+            return readback_tmp.error();
+
+        frame.readback_buffer = readback_tmp.value();
+    }
+
+    auto instance_ptr = static_cast<twv::glsl::Mat4x4 *>(frame.instance_buffer.allocation.mapped_ptr);
+    for(auto &draw : draws)
+    {
+        std::memcpy(instance_ptr, draw.transforms.data(), draw.transforms.size_bytes());
+        instance_ptr += draw.transforms.size();
+    }
+
+    if(instances_count != 0)
+    {
+        res = allocator.Flush(frame.instance_buffer.allocation, 0, instances_count * sizeof(twv::glsl::Mat4x4));
+        if(res != vk::Result::eSuccess)
+            return res;
+    }
+
+    //headless device owns one image per slot, nothing to acquire
+    vk::ResultValue<uint32_t> acquired_img_ind(vk::Result::eSuccess, target_frame_ind % swapchain_squad.swapchain_images.size());
+    if(!is_headless)
+    {
+        //suboptimal image is still acquired and semaphore will be signaled, so draw it and recreate after present
+        stage_start = clock::now();
+        acquired_img_ind = device.acquireNextImageKHR(swapchain_squad.swapchain, std::numeric_limits<uint64_t>::max(), frame.gpu_acquire_image_sem, {});
+        last_frame_timings.acquire = ms_since(stage_start);
+        if(acquired_img_ind.result != vk::Result::eSuccess && acquired_img_ind.result != vk::Result::eSuboptimalKHR)
+        {
+            //frame is dropped with its data
+            frame_data_ring.EndFrame();
+            return acquired_img_ind.result;
+        }
+    }
+
+    //from here acquire semaphore is signaled and must be waited by some submit
+    bool is_fence_reset = false;
+    auto abandon_frame = [&](vk::Result err)
+    {
+        release_acquired_image(frame, is_fence_reset);
+        return err;
+    };
+
+    //image may be still owned by another slot if swapchain returns images out of order
+    auto &image_value = swapchain_squad.images_in_flight[acquired_img_ind.value];
+    if(image_value > frame.submit_value)
+    {
+        stage_start = clock::now();
+        res = wait_frame_value(image_value);
+        last_frame_timings.fence_wait += ms_since(stage_start);
+        if(res != vk::Result::eSuccess)
+            return abandon_frame(res);
+    }
+
+    stage_start = clock::now();
+
+    //image isn't used by GPU now, so its camera region is free
+    if(pipeline_squad.has_camera_buffer)
+    {
+        vk::DeviceSize camera_offset = camera_squad.stride * acquired_img_ind.value;
+        std::memcpy(static_cast<uint8_t *>(camera_squad.buffer.allocation.mapped_ptr) + camera_offset, &view_proj[0][0], sizeof(twv::glsl::Mat4x4));
+        res = allocator.Flush(camera_squad.buffer.allocation, camera_offset, sizeof(twv::glsl::Mat4x4));
+        if(res != vk::Result::eSuccess)
+            return abandon_frame(res);
+    }
+
+    if(gpu_culling.is_inited())
+    {
+        res = gpu_culling.PrepareUpdates(target_frame_ind);
+        if(res != vk::Result::eSuccess)
+            return abandon_frame(res);
+    }
+
+    res = frame_data_ring.EndFrame();
+    if(res != vk::Result::eSuccess)
+        return abandon_frame(res);
+
+    //uploads requested since previous frame go out before this frame is recorded
+    if(uploader.is_inited())
+    {
+        res = uploader.Submit();
+        if(res != vk::Result::eSuccess)
+            return abandon_frame(res);
+    }
+
+    //compute batch goes out first, so it overlaps with graphics work submitted before
+    if(async_compute.IsAsync())
+    {
+        res = async_compute.Submit(graphics_timeline, frame_value);
+        if(res != vk::Result::eSuccess)
+            return abandon_frame(res);
+    }
+
+    //reset only when submit is guaranteed, otherwise next wait on this slot will never return
+    if(!graphics_timeline)
+    {
+        res = device.resetFences(frame.cpu_graphics_submit_fence);
+        if(res != vk::Result::eSuccess)
+            return abandon_frame(res);
+
+        is_fence_reset = true;
+    }
 
     vk::CommandBufferBeginInfo comm_buf_begin_info;
     comm_buf_begin_info
         .setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);//see in future!
 
+    res = frame.buf.begin(comm_buf_begin_info);
+    if(res != vk::Result::eSuccess)
+        return abandon_frame(res);
 
-    vk::RenderPassBeginInfo renderpass_begin_info;
-    renderpass_begin_info
-        .setRenderPass(surface_renderpass)
-        .setFramebuffer(swapchain_squad.swapchain_framebuffers[acquired_img_ind.value])
-        .setRenderArea
-        (
-            vk::Rect2D()
-                .setOffset({0, 0})
-                .setExtent(swapchain_squad.image_extent)
-        )
-        .setClearValues
-        (
-            vk::ClearValue()
-                .setColor(vk::ClearValue().color = {0.0f, 0.0f, 0.0f, 1.0f})//add depth!
-        );
-
-    res = frames_sync[target_frame_ind].buf.begin(comm_buf_begin_info);
+    res = gpu_profiler.BeginFrame(frame.buf, target_frame_ind);
     if(res != vk::Result::eSuccess)
-        return res;
+        return abandon_frame(res);
+
+    StagingUploader::GraphicsWait upload_wait;
+    if(uploader.is_inited())
+        upload_wait = uploader.RecordAcquires(frame.buf);
+
+    ComputeQueue::GraphicsWait compute_wait;
+    if(async_compute.IsAsync())
+        compute_wait = async_compute.TakeGraphicsWait();
+    else if(async_compute.is_inited())
+        async_compute.RecordInline(frame.buf);
+
+    bool has_culled_objects = gpu_culling.is_inited() && gpu_culling.GetObjectCount() != 0;
+    record_context = RecordContext{&frame, draws, &view_proj, acquired_img_ind.value, has_culled_objects, is_readback};
+    render_graph.SetImportedImage(swapchain_image_id, swapchain_squad.swapchain_images[acquired_img_ind.value]);
+    render_graph.Execute(frame.buf);
+    if(record_context.result != vk::Result::eSuccess)
+        return abandon_frame(record_context.result);
+
+    res = frame.buf.end();
+    if(res != vk::Result::eSuccess)
+        return abandon_frame(res);
 
-    frames_sync[target_frame_ind].buf.beginRenderPass(renderpass_begin_info, vk::SubpassContents::eInline);
-    frames_sync[target_frame_ind].buf.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline_squad.ppl);
-	frames_sync[target_frame_ind].buf.pushConstants(pipeline_squad.ppl_layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(twv::Mat<float, 4, 4>), &model[0][0]);
-	frames_sync[target_frame_ind].buf.draw(3, 1, 0, 0);
-    frames_sync[target_frame_ind].buf.endRenderPass();
+    vector<vk::Semaphore> wait_sems;
+    vector<vk::PipelineStageFlags> stages;
+    vector<uint64_t> wait_values;//ignored for binary semaphores
+    if(!is_headless)
+    {
+        wait_sems.push_back(frame.gpu_acquire_image_sem);
+        stages.push_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+        wait_values.push_back(0);
+    }
 
-    res = frames_sync[target_frame_ind].buf.end();
-    if(res != vk::Result::eSuccess)
-        return res;
+    if(upload_wait.value != 0)
+    {
+        wait_sems.push_back(uploader.GetTimelineSemaphore());
+        stages.push_back(upload_wait.stages);
+        wait_values.push_back(upload_wait.value);
+    }
+
+    if(compute_wait.value != 0)
+    {
+        wait_sems.push_back(async_compute.GetTimelineSemaphore());
+        stages.push_back(compute_wait.stages);
+        wait_values.push_back(compute_wait.value);
+    }
+
+    //nobody waits for headless frames on GPU
+    uint64_t submit_value = frame_value + 1;
+    vector<vk::Semaphore> signal_sems;
+    vector<uint64_t> signal_values;//ignored for binary semaphores
+    if(!is_headless)
+    {
+        signal_sems.push_back(swapchain_squad.present_sems[acquired_img_ind.value]);
+        signal_values.push_back(0);
+    }
+
+    if(graphics_timeline)
+    {
+        signal_sems.push_back(graphics_timeline);
+        signal_values.push_back(submit_value);
+    }
 
-    vk::PipelineStageFlags stages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
+    vk::TimelineSemaphoreSubmitInfo timeline_info;
+    timeline_info
+        .setWaitSemaphoreValues(wait_values)
+        .setSignalSemaphoreValues(signal_values);
 
     vk::SubmitInfo graphics_submit_info;
     graphics_submit_info
-        .setCommandBuffers(frames_sync[target_frame_ind].buf)
+        .setPNext(upload_wait.value != 0 || compute_wait.value != 0 || graphics_timeline ? &timeline_info : nullptr)
+        .setCommandBuffers(frame.buf)
         .setWaitDstStageMask(stages)
-        .setWaitSemaphores(frames_sync[target_frame_ind].gpu_acquire_image_sem)
-        .setSignalSemaphores(frames_sync[target_frame_ind].gpu_graphics_submit_sem);
+        .setWaitSemaphores(wait_sems)
+        .setSignalSemaphores(signal_sems);
 
-    res = graphics_queue.value().second.submit(graphics_submit_info, frames_sync[target_frame_ind].cpu_graphics_submit_fence);
+    last_frame_timings.record = ms_since(stage_start);
+    stage_start = clock::now();
+    res = graphics_queue.value().second.submit(graphics_submit_info, frame.cpu_graphics_submit_fence);
+    last_frame_timings.submit = ms_since(stage_start);
     if(res != vk::Result::eSuccess)
-        return res;
+        return abandon_frame(res);
 
-    /*res = frames_sync[target_frame_ind].buf.reset();
-    if(res != vk::Result::eSuccess)
-        return WarningLevel::FatalError(vk::to_string(res));*/
+    frame_value = submit_value;
+    frame.submit_value = submit_value;
+    image_value = submit_value;
+    deletion_queue.SetReleaseValue(submit_value);
+
+    if(is_readback)
+    {
+        is_readback_requested = false;
+        pending_readback_slot = target_frame_ind;
+    }
+
+    //frame is already submitted, so slot must be advanced even if presentation fails
+    target_frame_ind++;
+    target_frame_ind = target_frame_ind % frames_in_flight;
+
+    if(is_headless)
+        return vk::Result::eSuccess;
 
     vk::PresentInfoKHR present_info;
     present_info
-        .setWaitSemaphores(frames_sync[target_frame_ind].gpu_graphics_submit_sem)
+        .setWaitSemaphores(swapchain_squad.present_sems[acquired_img_ind.value])
         .setSwapchains(swapchain_squad.swapchain)
         .setImageIndices(acquired_img_ind.value);
 
-
+    stage_start = clock::now();
     res = presentation_queue.value().second.presentKHR(present_info);
+    last_frame_timings.present = ms_since(stage_start);
     if(res != vk::Result::eSuccess)
         return res;
 
-    target_frame_ind++;
-    target_frame_ind = target_frame_ind % FREE_FRAMES;
+    if(acquired_img_ind.result == vk::Result::eSuboptimalKHR)
+        return vk::Result::eSuboptimalKHR;
 
     return vk::Result::eSuccess;
 }
@@ -1070,3 +3683,174 @@ auto GraphicsDevice::IsEnvCreated() -> bool
 {
    return is_env_created;
 }
+
+auto GraphicsDevice::GetFramesInFlight() -> uint32_t
+{
+    return frames_in_flight;
+}
+
+auto GraphicsDevice::GetSubmittedFrameValue() -> uint64_t
+{
+    return frame_value;
+}
+
+auto GraphicsDevice::GetCompletedFrameValue() -> hrs::expected<uint64_t, GraphicsDevice::Result>
+{
+    auto completed = get_completed_frame_value();
+    if(!completed.has_value())
+        return Result(completed.error());
+
+    return completed.value();
+}
+
+auto GraphicsDevice::GetPendingDeletionCount() -> size_t
+{
+    return deletion_queue.GetPendingCount();
+}
+
+auto GraphicsDevice::IsPipelineCacheLoaded() -> bool
+{
+    return is_pipeline_cache_loaded;
+}
+
+auto GraphicsDevice::ReloadShaders(const std::vector<LoadedShaderProps> &loaded) -> hrs::ResultDef<GraphicsDevice::Result>
+{
+    if(!is_env_created)
+        return {Result::error_code::EnvironmentNotCreated};
+
+    //startup pipelines and older rebuild are finished first, so nothing is lost or mixed
+    auto take_res = take_compiled_pipelines(true);
+    if(take_res.code != Result::error_code::Success)
+        return {take_res};
+
+    apply_pipeline_rebuild(true);
+
+    auto rebuild = std::make_unique<PipelineRebuild>();
+    rebuild->modules = shaders;
+    rebuild->reflections = shader_reflections;
+    auto cleanup = [&, this]()
+    {
+        for(auto &name : rebuild->changed)
+            device.destroy(rebuild->modules[name]);
+    };
+
+    vk::ShaderModuleCreateInfo shader_info;
+    shader_info.setFlags({});
+    for(auto &sh : loaded)
+    {
+        auto it = shaders.find(sh.name);
+        if(it == shaders.end())
+            continue;
+
+        if(sh.code.empty())
+        {
+            cleanup();
+            return {Result::error_code::NoDesiredShaders, string("This shader has been missed: ") + string(sh.name)};
+        }
+
+        auto refl = ShaderReflection::Reflect(sh.code);
+        if(!refl.has_value())
+        {
+            cleanup();
+            return {Result::error_code::ShaderReflectionError,
+                    string(sh.name) + ": " + string(ShaderReflection::ErrorToView(refl.error()))};
+        }
+
+        shader_info.setCode(sh.code);
+        auto shader_tmp = device.createShaderModule(shader_info);
+        if(shader_tmp.result != vk::Result::eSuccess)
+        {
+            cleanup();
+            return {shader_tmp.result};
+        }
+
+        rebuild->modules[it->first] = shader_tmp.value;
+        rebuild->reflections.insert_or_assign(it->first, move(refl.value()));
+        rebuild->changed.push_back(it->first);
+    }
+
+    if(rebuild->changed.empty())
+        return {Result::error_code::Success};
+
+    //layout cache isn't thread safe, so only compilation goes to workers
+    PipelineDesc layout_desc;
+    auto res = resolve_pipeline_layout(rebuild->reflections, layout_desc);
+    if(res.code != Result::error_code::Success)
+    {
+        cleanup();
+        return {res};
+    }
+
+    rebuild->compile = start_pipeline_compile(rebuild->modules, layout_desc);
+    pending_rebuild = move(rebuild);
+    return {Result::error_code::Success};
+}
+
+auto GraphicsDevice::IsPipelineRebuildPending() -> bool
+{
+    return static_cast<bool>(pending_rebuild);
+}
+
+auto GraphicsDevice::TakePipelineRebuildResult() -> std::optional<GraphicsDevice::Result>
+{
+    auto res = rebuild_result;
+    rebuild_result.reset();
+    return res;
+}
+
+auto GraphicsDevice::IsGpuCullingEnabled() -> bool
+{
+    return gpu_culling.is_inited();
+}
+
+auto GraphicsDevice::IsDynamicRenderingEnabled() -> bool
+{
+    return is_dynamic_rendering_enabled;
+}
+
+auto GraphicsDevice::IsGpuProfilerEnabled() -> bool
+{
+    return gpu_profiler.is_inited();
+}
+
+auto GraphicsDevice::SetDepthPrepass(bool enable) -> void
+{
+    is_depth_prepass_enabled = enable;
+}
+
+auto GraphicsDevice::IsDepthPrepassEnabled() -> bool
+{
+    return is_depth_prepass_enabled;
+}
+
+auto GraphicsDevice::GetGpuTimings() -> std::span<const GpuProfiler::ScopeTiming>
+{
+    return gpu_profiler.GetLastTimings();
+}
+
+auto GraphicsDevice::GetLastFrameTimings() -> const GraphicsDevice::FrameTimings &
+{
+    return last_frame_timings;
+}
+
+auto GraphicsDevice::GetMemoryStatistics() -> DeviceAllocator::Statistics
+{
+    return allocator.GetStatistics();
+}
+
+auto GraphicsDevice::GetPipelineCacheData() -> hrs::expected<std::vector<uint8_t>, GraphicsDevice::Result>
+{
+    if(!pipeline_cache)
+        return Result(Result::error_code::EnvironmentNotCreated);
+
+    //caches of compile jobs are merged only when all of them are done
+    auto take_res = take_compiled_pipelines(true);
+    if(take_res.code != Result::error_code::Success)
+        return take_res;
+
+    auto data = device.getPipelineCacheData(pipeline_cache);
+    if(data.result != vk::Result::eSuccess)
+        return Result(data.result);
+
+    return move(data.value);
+}
@@ -3,9 +3,23 @@
 #include "VulkanContext.h"
 #include <memory>
 #include <optional>
+#include <array>
 #include <map>
+#include <future>
 #include "VulkanDeviceDriver.h"
+#include "DeviceAllocator.h"
+#include "MeshStorage.h"
+#include "GpuCulling.h"
+#include "FrameDataRing.h"
+#include "StagingUploader.h"
+#include "ComputeQueue.h"
+#include "RenderGraph.h"
+#include "GpuProfiler.h"
+#include "ShaderReflection.h"
+#include "PipelineLayoutCache.h"
+#include "DeletionQueue.h"
 #include "utils/expected.hpp"
+#include "utils/ThreadPool.hpp"
 #include "math/Mat.hpp"
 
 class GraphicsDevice : public VulkanDeviceDriver
@@ -17,11 +31,51 @@ public:
         std::span<uint32_t> code;
     };
 
+    //transforms are laid out as push constant matrix and are read by vertex shader from per-instance binding
+    //uniform and storage offsets are FrameDataRing::Chunk offsets of current frame,
+    //draws without them are bound to zeroed region no frame writes
+    struct InstancedMeshDraw
+    {
+        MeshHandle mesh;
+        std::span<const twv::glsl::Mat4x4> transforms;
+        std::optional<uint32_t> uniform_offset;
+        std::optional<uint32_t> storage_offset;
+    };
+
+    //layout is owned by layout cache, set layouts index is set number
+    struct ComputePipeline
+    {
+        vk::Pipeline ppl;
+        vk::PipelineLayout layout;
+        std::vector<vk::DescriptorSetLayout> set_layouts;
+        std::optional<vk::PushConstantRange> push_constant;
+    };
+
+    //CPU time of ExplicitBlindDraw stages, milliseconds
+    struct FrameTimings
+    {
+        double fence_wait = 0.0;//slot fence and fence of image owner
+        double acquire = 0.0;
+        double record = 0.0;//instance data, uploads and command recording
+        double submit = 0.0;
+        double present = 0.0;
+    };
+
+    //mode is preferred one, unsupported mode falls back through PRESENT_MODE_FALLBACK
     struct DrawableAreaParams
     {
         uint32_t width;
         uint32_t height;
         vk::PresentModeKHR mode;
+        uint32_t image_count = 0;//0 - minImageCount + 2, clamped by surface limits
+    };
+
+    //mailbox doesn't tear and doesn't block, immediate doesn't block, fifo is always supported
+    constexpr static std::array<vk::PresentModeKHR, 3> PRESENT_MODE_FALLBACK
+    {
+        vk::PresentModeKHR::eMailbox,
+        vk::PresentModeKHR::eImmediate,
+        vk::PresentModeKHR::eFifo
     };
 
     struct Result
@@ -47,7 +101,15 @@ public:
             ExtensionNotSupported,
             SurfaceAlreadyConnected,
             SurfaceNotExist,
-            EnvironmentNotCreated
+            EnvironmentNotCreated,
+            DrawableAreaIsEmpty,
+            GpuCullingNotAvailable,
+            InvalidObjectId,
+            HeadlessOnly,
+            ShaderReflectionError,
+            ShaderInterfaceMismatch,
+            StaticDrawHasFrameData,
+            StaticLayerNeedsCameraBuffer
             //SwapchainNotCreated,
             //RenderPassNotCreated,
             //PipelineNotCreated,
@@ -75,6 +137,22 @@ public:
 
     static_assert(hrs::ResultType<Result>);
 
+    constexpr static uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+    constexpr static uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+    constexpr static uint32_t INSTANCE_BINDING = 1;
+    constexpr static uint32_t MIN_INSTANCE_CAPACITY = 1024;
+    constexpr static uint32_t FRAME_DATA_SET = 0;
+    //shaders that read view_proj from this uniform block instead of push constant get static layer for free
+    constexpr static uint32_t CAMERA_SET = 1;
+    constexpr static uint32_t CAMERA_BINDING = 0;
+    constexpr static uint32_t MAX_RECORD_THREADS = 8;
+    constexpr static uint32_t MAX_COMPILE_THREADS = 8;
+    //smaller draw lists are recorded inline, thread hop costs more than recording
+    constexpr static size_t PARALLEL_RECORD_THRESHOLD = 512;
+    constexpr static size_t MIN_DRAWS_PER_CHUNK = 256;
+    //guaranteed to support color attachment and transfer source usage
+    constexpr static vk::Format OFFSCREEN_FORMAT = vk::Format::eR8G8B8A8Unorm;
+
 private:
     vk::Device device;
     std::weak_ptr<vk::SurfaceKHR> draw_surface;
@@ -82,6 +160,27 @@ private:
 
     std::optional<std::pair<uint32_t, vk::Queue>> graphics_queue;
     std::optional<std::pair<uint32_t, vk::Queue>> presentation_queue;
+    //transfer-only family, if device has it
+    std::optional<std::pair<uint32_t, vk::Queue>> transfer_queue;
+    //compute family without graphics, if device has it
+    std::optional<std::pair<uint32_t, vk::Queue>> compute_queue;
+
+    DeviceAllocator allocator;
+    MeshStorage mesh_storage;
+    vk::CommandPool upload_comm_pool;
+    //async uploads need timeline semaphores, otherwise upload_buffer waits for every copy
+    StagingUploader uploader;
+    bool is_timeline_semaphore_supported = false;
+    //compute passes of frame, submitted before graphics submit that waits on them
+    ComputeQueue async_compute;
+
+    //enabled only if device has features for it and cull shader is loaded
+    GpuCulling gpu_culling;
+    bool is_gpu_culling_supported = false;
+    bool is_draw_indirect_count_supported = false;
+
+    //disabled if graphics queue has no timestamps
+    GpuProfiler gpu_profiler;
 
     struct SwapchainDesc
     {
@@ -90,12 +189,36 @@ private:
         vk::Format image_format;
         vk::Extent2D image_extent;
         vk::ColorSpaceKHR image_color_space;
+        vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;//negotiated one
         std::vector<vk::Framebuffer> swapchain_framebuffers;
         std::vector<vk::ImageView> swapchain_images_views;
+        //frame value of the last frame that used image, swapchain images count isn't equal to frames in flight
+        std::vector<uint64_t> images_in_flight;
+        //signaled by graphics submit, waited by present. Presentation holds it until image is acquired again,
+        //not until slot is free, so it's per image
+        std::vector<vk::Semaphore> present_sems;
 
     } swapchain_squad;
 
+    //headless device renders into offscreen images (one per frame slot) instead of swapchain ones,
+    //they are exposed through swapchain_squad, so the draw path is the same
+    bool is_headless = false;
+    std::vector<DeviceAllocator::ImageAllocation> offscreen_images;
+    bool is_readback_requested = false;
+    std::optional<uint32_t> pending_readback_slot;
+
+    DrawableAreaParams drawable_area_params;
+    //set by acquire/present, swapchain is recreated lazily before next frame
+    bool is_drawable_area_out_of_date = false;
+
+    //null with dynamic rendering, pipelines and secondary buffers take attachment formats instead
     vk::RenderPass surface_renderpass;
+    //core 1.3 only, static loader doesn't export KHR entry points
+    bool is_dynamic_rendering_enabled = false;
+
+    //passed to every pipeline creation, blob is validated against device before use
+    vk::PipelineCache pipeline_cache;
+    bool is_pipeline_cache_loaded = false;
 
     std::map<std::string_view, vk::ShaderModule> shaders
     {
@@ -103,37 +226,258 @@ private:
         {"fragment_shader_test.spv", {}},
     };
 
+    //missing optional shaders just disable features that use them
+    std::map<std::string_view, vk::ShaderModule> optional_shaders
+    {
+        {"cull_objects.comp.spv", {}},
+    };
+
+    //interface of necessary shaders, layouts and vertex input are checked against it
+    std::map<std::string_view, ShaderReflection> shader_reflections;
+    PipelineLayoutCache layout_cache;
+
+    //all pipelines share layout and vertex input, so depth written by prepass_ppl is bit exact for eq_ppl
     struct PipelineDesc
     {
-        vk::PipelineLayout ppl_layout;
-        vk::Pipeline ppl;
+        vk::PipelineLayout ppl_layout;//owned by layout_cache
+        vk::ShaderStageFlags push_stages;
+        bool has_camera_buffer = false;//view_proj is read from camera set, not pushed
+        vk::Pipeline ppl;//depth test and write
+        vk::Pipeline prepass_ppl;//depth only, no fragment shader
+        vk::Pipeline eq_ppl;//after prepass: eEqual test, no depth write
     } pipeline_squad;
 
-    constexpr static uint32_t FREE_FRAMES = 1;
+    struct VertexInputDesc
+    {
+        std::vector<vk::VertexInputBindingDescription> bindings;
+        std::vector<vk::VertexInputAttributeDescription> attributes;
+    };
+
+    enum class PipelineKind : uint8_t
+    {
+        Main = 0,
+        Prepass = 1,
+        Equal = 2,
+
+        PIPELINE_KIND_ENUM_MAX
+    };
+
+    constexpr static size_t PIPELINE_KIND_COUNT = static_cast<size_t>(PipelineKind::PIPELINE_KIND_ENUM_MAX);
+
+    //one job per pipeline, every job compiles into its own cache seeded from pipeline_cache,
+    //caches are merged back on the owning thread when all jobs are done
+    struct PipelineCompile
+    {
+        std::map<std::string_view, vk::ShaderModule> modules;
+        std::array<std::future<vk::Result>, PIPELINE_KIND_COUNT> tasks;
+        std::array<std::optional<vk::Result>, PIPELINE_KIND_COUNT> results;//taken from tasks
+        PipelineDesc pipelines;//written by jobs, ones moved to pipeline_squad are reset
+        std::array<vk::PipelineCache, PIPELINE_KIND_COUNT> caches;//written by jobs
+    };
+
+    //startup compile, pipelines first frame doesn't need are taken later
+    std::unique_ptr<PipelineCompile> pipeline_compile;
+    hrs::ThreadPool compile_thread_pool;
+
+    //shader hot reload: pipelines are compiled by workers and swapped in at the start of next frame after they're done
+    struct PipelineRebuild
+    {
+        std::unique_ptr<PipelineCompile> compile;
+        std::map<std::string_view, vk::ShaderModule> modules;//new modules of changed shaders, current ones of others
+        std::map<std::string_view, ShaderReflection> reflections;
+        std::vector<std::string_view> changed;
+    };
+    std::unique_ptr<PipelineRebuild> pending_rebuild;
+    std::optional<Result> rebuild_result;//of the last finished rebuild, until it's taken
+
+    //released objects (replaced pipelines, old swapchain things, static layer buffers, mesh ranges)
+    //live until frames in flight that could use them are completed
+    DeletionQueue deletion_queue;
+
+    //depth attachment is transient image of render graph
+    vk::Format depth_format = vk::Format::eUndefined;
+    RenderGraph::ResourceId depth_image_id = 0;
+    bool is_depth_prepass_enabled = false;
 
     vk::CommandPool frames_comm_pool;
 
+    //one slot per frame in flight, CPU records slot N while GPU still works on slot N - 1
     struct AcquireFrameSync
     {
-        vk::Fence cpu_graphics_submit_fence;
+        vk::Fence cpu_graphics_submit_fence;//only without timeline semaphores
+        uint64_t submit_value = 0;//frame value of the last submit of slot
+        //binary ones, swapchain doesn't take timeline semaphores
         vk::Semaphore gpu_acquire_image_sem;
-        vk::Semaphore gpu_graphics_submit_sem;
         vk::CommandBuffer buf;
+
+        //transient resources, reused only after submit_value is reached
+        DeviceAllocator::BufferAllocation instance_buffer;
+        uint32_t instance_capacity = 0;
+
+        //one pool and two secondary buffers (main and depth prepass) per record task,
+        //the last ones are used by main thread
+        std::vector<vk::CommandPool> record_pools;
+        std::vector<vk::CommandBuffer> record_bufs;
+        std::vector<vk::CommandBuffer> prepass_record_bufs;
+
+        //headless only, allocated by first readback request
+        DeviceAllocator::BufferAllocation readback_buffer;
     };
 
-    std::array<AcquireFrameSync, FREE_FRAMES> frames_sync;
+    std::vector<AcquireFrameSync> frames_sync;
+
+    //view_proj of camera buffer shaders, one region and set per swapchain image.
+    //Region is written when its image is drawn, previous frame of the image is already completed then
+    struct CameraDesc
+    {
+        vk::DescriptorSetLayout set_layout;
+        vk::DescriptorPool descriptor_pool;
+        DeviceAllocator::BufferAllocation buffer;
+        vk::DeviceSize stride = 0;
+        std::vector<vk::DescriptorSet> sets;
+    } camera_squad;
+
+    //secondary buffers of static draws for one framebuffer, replayed until something they were recorded with changes
+    struct StaticRecord
+    {
+        vk::CommandBuffer buf;
+        vk::CommandBuffer prepass_buf;
+        bool is_recorded = false;
+        uint64_t version = 0;
+        vk::Pipeline ppl;
+        vk::Pipeline prepass_ppl;
+    };
+
+    //draws that don't change between frames, their instances live in own device local buffer.
+    //Secondary buffers don't inherit push constants, so layer works only with camera set shaders
+    struct StaticLayer
+    {
+        std::vector<twv::glsl::Mat4x4> transforms;
+        std::vector<InstancedMeshDraw> draws;//point into transforms, bound to empty frame data region
+        DeviceAllocator::BufferAllocation instance_buffer;
+        uint64_t version = 0;//bumped by every SetStaticDraws
+        vk::CommandPool comm_pool;
+        std::vector<StaticRecord> records;//index is swapchain image
+        uint64_t record_count = 0;
+    } static_layer;
+
+    //every graphics submit gets next frame value, GPU progress is value of graphics_timeline.
+    //Without timeline semaphores progress is derived from fences of slots
+    vk::Semaphore graphics_timeline;
+    uint64_t frame_value = 0;//last submitted
+    FrameDataRing frame_data_ring;
+    hrs::ThreadPool record_thread_pool;
+
+    //frame passes and their synchronization, renderpass itself has no external dependencies
+    RenderGraph render_graph;
+    RenderGraph::ResourceId swapchain_image_id = 0;
+
+    //what graph passes record in current ExplicitBlindDraw
+    struct RecordContext
+    {
+        AcquireFrameSync *frame = nullptr;
+        std::span<const InstancedMeshDraw> draws;
+        const twv::glsl::Mat4x4 *view_proj = nullptr;
+        uint32_t image_ind = 0;
+        bool has_culled_objects = false;
+        bool is_readback = false;
+        vk::Result result = vk::Result::eSuccess;//pass record functions can't return errors
+    } record_context;
+
+    FrameTimings last_frame_timings;
+    uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
 
     uint32_t target_frame_ind = 0;
 
     bool is_env_created = false;
 
 private:
-    auto create_swapchain(uint32_t width, uint32_t height, vk::PresentModeKHR mode = vk::PresentModeKHR::eFifo) -> Result;
+    auto create_swapchain(uint32_t width,
+                          uint32_t height,
+                          vk::PresentModeKHR mode = vk::PresentModeKHR::eFifo,
+                          uint32_t image_count = 0,
+                          vk::SwapchainKHR old_swapchain = {}) -> Result;
+    auto create_offscreen_target(uint32_t width, uint32_t height, uint32_t images_count) -> Result;
+    auto destroy_offscreen_target() -> void;
     auto create_renderpass() -> Result;
+    //one per swapchain image, waited by present of that image
+    auto create_present_semaphores() -> Result;
+    auto destroy_present_semaphores() -> void;
+    //with dynamic rendering only image views are created
     auto create_swapchain_framebuffers() -> Result;
+    auto destroy_swapchain_framebuffers() -> void;
+    auto wait_frame_value(uint64_t value) -> vk::Result;
+    auto get_completed_frame_value() -> hrs::expected<uint64_t, vk::Result>;
+    auto reserve_instances(AcquireFrameSync &frame, uint32_t count) -> vk::Result;
+    //error path of frame after acquire: empty submit consumes acquire semaphore and becomes slot's frame value
+    auto release_acquired_image(AcquireFrameSync &frame, bool is_fence_reset) -> void;
+    auto record_draw_state(vk::CommandBuffer buf,
+                           vk::Buffer instance_buffer,
+                           uint32_t image_ind,
+                           const twv::glsl::Mat4x4 &view_proj,
+                           vk::Pipeline ppl) const -> void;
+    //rendering_info must outlive use of inheritance_info
+    auto fill_inheritance_info(uint32_t image_ind,
+                               vk::CommandBufferInheritanceInfo &inheritance_info,
+                               vk::CommandBufferInheritanceRenderingInfo &rendering_info) const -> void;
+    auto record_mesh_draws(vk::CommandBuffer buf, std::span<const InstancedMeshDraw> draws, uint32_t first_instance) const -> void;
+    //secondary buffers are appended in execution order, prepass ones must be executed before main ones
+    auto record_parallel(AcquireFrameSync &frame,
+                         std::span<const InstancedMeshDraw> draws,
+                         const twv::glsl::Mat4x4 &view_proj,
+                         uint32_t image_ind,
+                         bool has_culled_objects,
+                         std::vector<vk::CommandBuffer> &prepass_bufs,
+                         std::vector<vk::CommandBuffer> &main_bufs) -> vk::Result;
+    //re-records static buffers of image only if they're out of date
+    auto record_static_layer(uint32_t image_ind,
+                             const twv::glsl::Mat4x4 &view_proj,
+                             std::vector<vk::CommandBuffer> &prepass_bufs,
+                             std::vector<vk::CommandBuffer> &main_bufs) -> vk::Result;
     auto load_shaders(const std::vector<LoadedShaderProps> &loaded) -> hrs::ResultDef<GraphicsDevice::Result>;
+    //layout is resolved on creating thread, pipelines may be built on any thread
+    static auto get_vertex_input() -> VertexInputDesc;
+    auto resolve_pipeline_layout(const std::map<std::string_view, ShaderReflection> &reflections, PipelineDesc &desc) -> Result;
+    static auto get_pipeline(PipelineDesc &desc, PipelineKind kind) -> vk::Pipeline &;
+    auto compile_pipeline(const std::map<std::string_view, vk::ShaderModule> &modules,
+                          vk::PipelineLayout layout,
+                          PipelineKind kind,
+                          vk::PipelineCache cache) -> vk::ResultValue<vk::Pipeline>;
+    auto start_pipeline_compile(const std::map<std::string_view, vk::ShaderModule> &modules,
+                                const PipelineDesc &layout_desc) -> std::unique_ptr<PipelineCompile>;
+    //nullopt - job isn't done and wait is false
+    auto get_compile_result(PipelineCompile &compile, PipelineKind kind, bool wait) -> std::optional<vk::Result>;
+    //waits all jobs and merges their caches, returns the first error of jobs
+    auto finish_pipeline_compile(PipelineCompile &compile) -> vk::Result;
+    auto destroy_pipeline_compile(PipelineCompile &compile) -> void;
+    //moves compiled startup pipelines to pipeline_squad, waits the ones current frame needs or all
+    auto take_compiled_pipelines(bool wait_all) -> Result;
     auto create_pipeline() -> Result;
-    auto create_frames_property() -> Result;
+    auto destroy_pipeline() -> void;
+    auto destroy_pipelines(const PipelineDesc &desc) -> void;
+    //pipelines that frames in flight may use go to deletion queue
+    auto retire_pipelines(const PipelineDesc &desc) -> void;
+    //wait - block until pending rebuild is done, otherwise it's applied only if already done
+    auto apply_pipeline_rebuild(bool wait) -> void;
+    auto discard_pipeline_rebuild() -> void;
+    auto collect_deletions() -> vk::Result;
+    auto create_frames_property(uint32_t frames_count) -> Result;
+    auto create_frame_data_ring(uint32_t frames_count) -> Result;
+    auto create_pipeline_cache(std::span<const uint8_t> initial_data) -> Result;
+    auto create_mesh_storage() -> Result;
+    auto create_gpu_culling() -> Result;
+    auto create_uploader() -> Result;
+    auto create_async_compute() -> Result;
+    auto create_gpu_profiler() -> Result;
+    auto create_render_graph() -> Result;
+    //per image camera regions and static buffers, layout and pool are created once
+    auto create_static_layer() -> Result;
+    auto destroy_static_layer() -> void;
+    auto record_main_pass(vk::CommandBuffer buf) -> void;
+    //buffers written by upload_buffer must be concurrent between these families
+    auto get_upload_queue_families() -> std::vector<uint32_t>;
+    auto upload_buffer(const DeviceAllocator::BufferAllocation &dst, vk::DeviceSize offset, std::span<const uint8_t> data) -> vk::Result;
+    auto is_pipeline_cache_compatible(std::span<const uint8_t> data) -> bool;
 public:
     GraphicsDevice();
     GraphicsDevice(const GraphicsDevice &gd) = delete;
@@ -148,13 +492,81 @@ public:
     auto connect_surface(std::weak_ptr<vk::SurfaceKHR> sur) -> Result;
     auto is_surface_connected() -> bool;
 
+    //must be called before init, headless device doesn't need surface and never presents
+    auto EnableHeadless() -> Result;
+    auto IsHeadless() -> bool;
+    //next drawn frame is copied into host memory, TryGetReadback returns it once GPU is done with it
+    auto RequestReadback() -> Result;
+    //false - nothing is ready yet, pixels are tightly packed OFFSCREEN_FORMAT texels
+    auto TryGetReadback(std::vector<uint8_t> &pixels) -> hrs::expected<bool, Result>;
+    //blocks until requested frame is done, false - no readback was drawn
+    auto WaitReadback(std::vector<uint8_t> &pixels) -> hrs::expected<bool, Result>;
+
     //
     auto QueryShaders() -> std::vector<std::string_view>;
-    auto CreateWorkEnv(const DrawableAreaParams &params, const std::vector<LoadedShaderProps> &loaded) -> hrs::ResultDef<Result>;
+    auto QueryOptionalShaders() -> std::vector<std::string_view>;
+    auto CreateWorkEnv(const DrawableAreaParams &params, const std::vector<LoadedShaderProps> &loaded, uint32_t frames_count = DEFAULT_FRAMES_IN_FLIGHT,
+                       std::span<const uint8_t> pipeline_cache_data = {}) -> hrs::ResultDef<Result>;
     auto RecreateDrawableArea(const DrawableAreaParams &params) -> Result;
+    auto GetDrawableAreaParams() -> DrawableAreaParams;
+    //mode swapchain is actually created with
+    auto GetPresentMode() -> vk::PresentModeKHR;
+    auto GetSwapchainImageCount() -> uint32_t;
+	auto AddMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices) -> hrs::expected<MeshHandle, Result>;
+	auto RemoveMesh(const MeshHandle &mesh) -> Result;
+	auto AddCulledObject(const MeshHandle &mesh, const twv::glsl::Mat4x4 &transform, const twv::glsl::Vec4 &bounding_sphere) -> hrs::expected<uint32_t, Result>;
+	auto UpdateCulledObject(uint32_t id, const twv::glsl::Mat4x4 &transform, const twv::glsl::Vec4 &bounding_sphere) -> Result;
+	auto RemoveCulledObject(uint32_t id) -> Result;
+	auto AllocateFrameData(vk::DeviceSize size) -> hrs::expected<FrameDataRing::Chunk, Result>;
 	auto Draw(const twv::glsl::Mat4x4 &model) -> Result;
-	auto ExplicitBlindDraw(const twv::glsl::Mat4x4 &model) -> vk::Result;
+	auto Draw(const twv::glsl::Mat4x4 &model, std::span<const MeshHandle> meshes) -> Result;
+	auto DrawInstanced(const twv::glsl::Mat4x4 &view_proj, std::span<const InstancedMeshDraw> draws) -> Result;
+	auto ExplicitBlindDraw(const twv::glsl::Mat4x4 &view_proj, std::span<const InstancedMeshDraw> draws = {}) -> vk::Result;
+	//replaces static layer, it's drawn every frame before draws of DrawInstanced.
+	//Buffers are replayed by any frame slot, so draws with frame data offsets are rejected with StaticDrawHasFrameData
+	//and layer is left unchanged. Pipelines must read camera from CAMERA_SET, otherwise StaticLayerNeedsCameraBuffer
+	//is returned, same for shader rebuilds dropping the camera set while layer isn't empty.
+	//Meshes must live while they're in the layer. Empty draws clear the layer
+	auto SetStaticDraws(std::span<const InstancedMeshDraw> draws) -> Result;
+	//secondary buffers recorded by static layer so far
+	auto GetStaticRecordCount() -> uint64_t;
+	//layout is built from reflection, dispatch with ComputeQueue::RecordDispatch
+	auto CreateComputePipeline(std::span<const uint32_t> code) -> hrs::expected<ComputePipeline, Result>;
+	//pipeline may be used by frames in flight, it goes to deletion queue
+	auto DestroyComputePipeline(const ComputePipeline &ppl) -> void;
+	//pass is recorded into the next ExplicitBlindDraw, see ComputeQueue::AddPass
+	auto AddComputePass(ComputeQueue::RecordFunc &&record, vk::PipelineStageFlags graphics_stages, bool is_after_graphics = false) -> Result;
+	//passes run on separate compute family, otherwise they're serialized with graphics work
+	auto IsAsyncComputeEnabled() -> bool;
+	//families for concurrent sharing of resources that compute passes use
+	auto GetComputeQueueFamilies() -> std::vector<uint32_t>;
     auto IsEnvCreated() -> bool;
+    auto GetFramesInFlight() -> uint32_t;
+    //resources used by frame are free when its value (submitted value at the time of use) is completed
+    auto GetSubmittedFrameValue() -> uint64_t;
+    auto GetCompletedFrameValue() -> hrs::expected<uint64_t, Result>;
+    //objects waiting for their frames to complete
+    auto GetPendingDeletionCount() -> size_t;
+    auto IsPipelineCacheLoaded() -> bool;
+    //only necessary shaders are reloaded, optional ones are owned by their features.
+    //New pipelines are compiled in background, current ones are used until next frame after it's done
+    auto ReloadShaders(const std::vector<LoadedShaderProps> &loaded) -> hrs::ResultDef<Result>;
+    auto IsPipelineRebuildPending() -> bool;
+    //result of the finished rebuild, once
+    auto TakePipelineRebuildResult() -> std::optional<Result>;
+    auto IsGpuCullingEnabled() -> bool;
+    //main pass is begun with image views directly, no renderpass and framebuffers exist
+    auto IsDynamicRenderingEnabled() -> bool;
+    auto IsGpuProfilerEnabled() -> bool;
+    //depth of all draws is written before shading, main pass then shades only visible fragments
+    auto SetDepthPrepass(bool enable) -> void;
+    auto IsDepthPrepassEnabled() -> bool;
+    //per pass timings of latest finished frame, empty if profiler is disabled
+    auto GetGpuTimings() -> std::span<const GpuProfiler::ScopeTiming>;
+    //stages of last ExplicitBlindDraw, stages it didn't reach are zero
+    auto GetLastFrameTimings() -> const FrameTimings &;
+    auto GetMemoryStatistics() -> DeviceAllocator::Statistics;
+    auto GetPipelineCacheData() -> hrs::expected<std::vector<uint8_t>, Result>;
 };
 
 constexpr auto GraphicsDevice::Result::message() const -> std::string_view
@@ -204,6 +616,30 @@ constexpr auto GraphicsDevice::Result::message() const -> std::string_view
         case Result::error_code::EnvironmentNotCreated:
             res = "Work environment isn't created yet";
             break;
+        case Result::error_code::DrawableAreaIsEmpty:
+            res = "Drawable area has zero size";
+            break;
+        case Result::error_code::GpuCullingNotAvailable:
+            res = "GPU culling isn't supported by device or cull shader isn't loaded";
+            break;
+        case Result::error_code::InvalidObjectId:
+            res = "Object with this id doesn't exist";
+            break;
+        case Result::error_code::HeadlessOnly:
+            res = "Operation is available only for headless device";
+            break;
+        case Result::error_code::ShaderReflectionError:
+            res = "Shader code can't be reflected";
+            break;
+        case Result::error_code::ShaderInterfaceMismatch:
+            res = "Shader interface doesn't match data provided by device";
+            break;
+        case Result::error_code::StaticDrawHasFrameData:
+            res = "Static draws can't use per-frame data chunks";
+            break;
+        case Result::error_code::StaticLayerNeedsCameraBuffer:
+            res = "Static layer needs shaders reading camera from camera set, pushed camera re-records it every frame";
+            break;
     }
 
     return res;
@@ -249,6 +685,30 @@ constexpr auto GraphicsDevice::Result::to_view() const -> std::string_view
         case Result::error_code::EnvironmentNotCreated:
             res = "EnvironmentNotCreated";
             break;
+        case Result::error_code::DrawableAreaIsEmpty:
+            res = "DrawableAreaIsEmpty";
+            break;
+        case Result::error_code::GpuCullingNotAvailable:
+            res = "GpuCullingNotAvailable";
+            break;
+        case Result::error_code::InvalidObjectId:
+            res = "InvalidObjectId";
+            break;
+        case Result::error_code::HeadlessOnly:
+            res = "HeadlessOnly";
+            break;
+        case Result::error_code::ShaderReflectionError:
+            res = "ShaderReflectionError";
+            break;
+        case Result::error_code::ShaderInterfaceMismatch:
+            res = "ShaderInterfaceMismatch";
+            break;
+        case Result::error_code::StaticDrawHasFrameData:
+            res = "StaticDrawHasFrameData";
+            break;
+        case Result::error_code::StaticLayerNeedsCameraBuffer:
+            res = "StaticLayerNeedsCameraBuffer";
+            break;
     }
 
     return res;
@@ -0,0 +1,138 @@
+#include "MeshStorage.h"
+#include <cstddef>
+
+using
+    std::optional,
+    std::array;
+
+auto MeshStorage::init(DeviceAllocator &alloc,
+                       std::span<const uint32_t> queue_families,
+                       uint32_t vertex_capacity,
+                       uint32_t index_capacity) -> vk::Result
+{
+    auto sharing_mode = (queue_families.size() > 1 ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive);
+    vk::BufferCreateInfo vertex_info;
+    vertex_info
+        .setFlags({})
+        .setSize(static_cast<vk::DeviceSize>(vertex_capacity) * sizeof(Vertex))
+        .setUsage(vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst)
+        .setSharingMode(sharing_mode)
+        .setQueueFamilyIndices(queue_families);
+
+    auto vertex_tmp = alloc.CreateBuffer(vertex_info, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    if(!vertex_tmp.has_value())
+        return vertex_tmp.error();
+
+    vk::BufferCreateInfo index_info;
+    index_info
+        .setFlags({})
+        .setSize(static_cast<vk::DeviceSize>(index_capacity) * sizeof(uint32_t))
+        .setUsage(vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst)
+        .setSharingMode(sharing_mode)
+        .setQueueFamilyIndices(queue_families);
+
+    auto index_tmp = alloc.CreateBuffer(index_info, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    if(!index_tmp.has_value())
+    {
+        alloc.DestroyBuffer(vertex_tmp.value());
+        return index_tmp.error();
+    }
+
+    allocator = &alloc;
+    vertex_buffer = vertex_tmp.value();
+    index_buffer = index_tmp.value();
+    vertex_ranges.init(vertex_capacity);
+    index_ranges.init(index_capacity);
+
+    return vk::Result::eSuccess;
+}
+
+auto MeshStorage::destroy() -> void
+{
+    if(!allocator)
+        return;
+
+    allocator->DestroyBuffer(vertex_buffer);
+    allocator->DestroyBuffer(index_buffer);
+    vertex_ranges.init(0);
+    index_ranges.init(0);
+    allocator = nullptr;
+}
+
+auto MeshStorage::is_inited() const -> bool
+{
+    return allocator != nullptr;
+}
+
+//empty part of a mesh is an empty range at 0, it owns nothing in the allocator
+auto MeshStorage::AllocateMesh(uint32_t vertex_count, uint32_t index_count) -> optional<MeshHandle>
+{
+    optional<size_t> vertex_offset = (vertex_count == 0 ? optional<size_t>(0) : vertex_ranges.allocate(vertex_count));
+    if(!vertex_offset)
+        return {};
+
+    optional<size_t> first_index = (index_count == 0 ? optional<size_t>(0) : index_ranges.allocate(index_count));
+    if(!first_index)
+    {
+        if(vertex_count != 0)
+            vertex_ranges.free(vertex_offset.value());
+        return {};
+    }
+
+    return MeshHandle
+    {
+        .first_index = static_cast<uint32_t>(first_index.value()),
+        .vertex_offset = static_cast<int32_t>(vertex_offset.value()),
+        .index_count = index_count,
+        .vertex_count = vertex_count
+    };
+}
+
+auto MeshStorage::FreeMesh(const MeshHandle &mesh) -> void
+{
+    if(mesh.vertex_count != 0)
+        vertex_ranges.free(static_cast<size_t>(mesh.vertex_offset));
+
+    if(mesh.index_count != 0)
+        index_ranges.free(mesh.first_index);
+}
+
+auto MeshStorage::GetVertexBuffer() const -> const DeviceAllocator::BufferAllocation &
+{
+    return vertex_buffer;
+}
+
+auto MeshStorage::GetIndexBuffer() const -> const DeviceAllocator::BufferAllocation &
+{
+    return index_buffer;
+}
+
+auto MeshStorage::GetVertexBindingDescription() -> vk::VertexInputBindingDescription
+{
+    return vk::VertexInputBindingDescription()
+        .setBinding(VERTEX_BINDING)
+        .setStride(sizeof(Vertex))
+        .setInputRate(vk::VertexInputRate::eVertex);
+}
+
+auto MeshStorage::GetVertexAttributeDescriptions() -> array<vk::VertexInputAttributeDescription, 3>
+{
+    return
+    {
+        vk::VertexInputAttributeDescription()
+            .setLocation(0)
+            .setBinding(VERTEX_BINDING)
+            .setFormat(vk::Format::eR32G32B32Sfloat)
+            .setOffset(offsetof(Vertex, position)),
+        vk::VertexInputAttributeDescription()
+            .setLocation(1)
+            .setBinding(VERTEX_BINDING)
+            .setFormat(vk::Format::eR32G32B32Sfloat)
+            .setOffset(offsetof(Vertex, normal)),
+        vk::VertexInputAttributeDescription()
+            .setLocation(2)
+            .setBinding(VERTEX_BINDING)
+            .setFormat(vk::Format::eR32G32Sfloat)
+            .setOffset(offsetof(Vertex, uv))
+    };
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <span>
+#include "VulkanInclude.h"
+#include "DeviceAllocator.h"
+#include "utils/RangeAllocator.hpp"
+#include "math/Vec.hpp"
+
+struct Vertex
+{
+    twv::glsl::Vec3 position;
+    twv::glsl::Vec3 normal;
+    twv::glsl::Vec2 uv;
+};
+
+//Arguments for drawIndexed inside shared vertex/index buffers
+struct MeshHandle
+{
+    uint32_t first_index = 0;
+    int32_t vertex_offset = 0;
+    uint32_t index_count = 0;
+    uint32_t vertex_count = 0;
+};
+
+//All static meshes live in one vertex and one index buffer, so they are bound once per frame
+class MeshStorage
+{
+public:
+    constexpr static uint32_t DEFAULT_VERTEX_CAPACITY = 1 << 20;
+    constexpr static uint32_t DEFAULT_INDEX_CAPACITY = 1 << 22;
+    constexpr static vk::IndexType INDEX_TYPE = vk::IndexType::eUint32;
+    constexpr static uint32_t VERTEX_BINDING = 0;
+
+private:
+    DeviceAllocator *allocator = nullptr;
+    DeviceAllocator::BufferAllocation vertex_buffer;
+    DeviceAllocator::BufferAllocation index_buffer;
+    hrs::RangeAllocator vertex_ranges;
+    hrs::RangeAllocator index_ranges;
+
+public:
+    MeshStorage() = default;
+    MeshStorage(const MeshStorage &ms) = delete;
+    ~MeshStorage() = default;
+
+    //buffers are shared concurrently if more than one family writes or reads them
+    auto init(DeviceAllocator &alloc,
+              std::span<const uint32_t> queue_families = {},
+              uint32_t vertex_capacity = DEFAULT_VERTEX_CAPACITY,
+              uint32_t index_capacity = DEFAULT_INDEX_CAPACITY) -> vk::Result;
+    auto destroy() -> void;
+    auto is_inited() const -> bool;
+
+    //zero counts give empty ranges at 0, nullopt only if storage is full
+    auto AllocateMesh(uint32_t vertex_count, uint32_t index_count) -> std::optional<MeshHandle>;
+    auto FreeMesh(const MeshHandle &mesh) -> void;
+
+    auto GetVertexBuffer() const -> const DeviceAllocator::BufferAllocation &;
+    auto GetIndexBuffer() const -> const DeviceAllocator::BufferAllocation &;
+
+    static auto GetVertexBindingDescription() -> vk::VertexInputBindingDescription;
+    static auto GetVertexAttributeDescriptions() -> std::array<vk::VertexInputAttributeDescription, 3>;
+};
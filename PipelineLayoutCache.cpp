@@ -0,0 +1,247 @@
+#include "PipelineLayoutCache.h"
+#include <algorithm>
+#include <functional>
+
+using
+    std::vector,
+    std::optional,
+    std::span;
+
+namespace
+{
+    auto hash_combine(size_t seed, size_t value) -> size_t
+    {
+        return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+    }
+
+    auto binding_equal(const vk::DescriptorSetLayoutBinding &l, const vk::DescriptorSetLayoutBinding &r) -> bool
+    {
+        return l.binding == r.binding &&
+               l.descriptorType == r.descriptorType &&
+               l.descriptorCount == r.descriptorCount &&
+               l.stageFlags == r.stageFlags;
+    }
+
+    auto range_equal(const optional<vk::PushConstantRange> &l, const optional<vk::PushConstantRange> &r) -> bool
+    {
+        if(l.has_value() != r.has_value())
+            return false;
+
+        if(!l)
+            return true;
+
+        return l->stageFlags == r->stageFlags && l->offset == r->offset && l->size == r->size;
+    }
+}
+
+auto PipelineLayoutCache::SetLayoutKey::operator==(const SetLayoutKey &key) const -> bool
+{
+    return std::equal(bindings.begin(), bindings.end(), key.bindings.begin(), key.bindings.end(), binding_equal);
+}
+
+auto PipelineLayoutCache::PipelineLayoutKey::operator==(const PipelineLayoutKey &key) const -> bool
+{
+    return set_layouts == key.set_layouts && range_equal(push_constant, key.push_constant);
+}
+
+auto PipelineLayoutCache::KeyHash::operator()(const SetLayoutKey &key) const -> size_t
+{
+    size_t seed = key.bindings.size();
+    for(auto &binding : key.bindings)
+    {
+        seed = hash_combine(seed, binding.binding);
+        seed = hash_combine(seed, static_cast<size_t>(binding.descriptorType));
+        seed = hash_combine(seed, binding.descriptorCount);
+        seed = hash_combine(seed, static_cast<VkShaderStageFlags>(binding.stageFlags));
+    }
+
+    return seed;
+}
+
+auto PipelineLayoutCache::KeyHash::operator()(const PipelineLayoutKey &key) const -> size_t
+{
+    size_t seed = key.set_layouts.size();
+    for(auto &layout : key.set_layouts)
+        seed = hash_combine(seed, std::hash<VkDescriptorSetLayout>{}(static_cast<VkDescriptorSetLayout>(layout)));
+
+    if(key.push_constant)
+    {
+        seed = hash_combine(seed, static_cast<VkShaderStageFlags>(key.push_constant->stageFlags));
+        seed = hash_combine(seed, key.push_constant->offset);
+        seed = hash_combine(seed, key.push_constant->size);
+    }
+
+    return seed;
+}
+
+auto PipelineLayoutCache::get_set_layout(SetLayoutKey &&key) -> hrs::expected<vk::DescriptorSetLayout, vk::Result>
+{
+    auto it = set_layouts.find(key);
+    if(it != set_layouts.end())
+        return it->second;
+
+    vk::DescriptorSetLayoutCreateInfo set_layout_info;
+    set_layout_info
+        .setFlags({})
+        .setBindings(key.bindings);
+
+    auto set_layout_tmp = device.createDescriptorSetLayout(set_layout_info);
+    if(set_layout_tmp.result != vk::Result::eSuccess)
+        return set_layout_tmp.result;
+
+    set_layouts.insert({std::move(key), set_layout_tmp.value});
+    return set_layout_tmp.value;
+}
+
+auto PipelineLayoutCache::get_pipeline_layout(PipelineLayoutKey &&key) -> hrs::expected<vk::PipelineLayout, vk::Result>
+{
+    auto it = pipeline_layouts.find(key);
+    if(it != pipeline_layouts.end())
+        return it->second;
+
+    vk::PipelineLayoutCreateInfo ppl_layout_info;
+    ppl_layout_info
+        .setFlags({})
+        .setSetLayouts(key.set_layouts);
+
+    if(key.push_constant)
+        ppl_layout_info.setPushConstantRanges(key.push_constant.value());
+
+    auto ppl_layout_tmp = device.createPipelineLayout(ppl_layout_info);
+    if(ppl_layout_tmp.result != vk::Result::eSuccess)
+        return ppl_layout_tmp.result;
+
+    pipeline_layouts.insert({std::move(key), ppl_layout_tmp.value});
+    return ppl_layout_tmp.value;
+}
+
+auto PipelineLayoutCache::init(vk::Device dev) -> void
+{
+    device = dev;
+}
+
+auto PipelineLayoutCache::destroy() -> void
+{
+    if(!device)
+        return;
+
+    for(auto &ppl_layout : pipeline_layouts)
+        device.destroy(ppl_layout.second);
+
+    for(auto &set_layout : set_layouts)
+        device.destroy(set_layout.second);
+
+    pipeline_layouts.clear();
+    set_layouts.clear();
+    device = vk::Device();
+}
+
+auto PipelineLayoutCache::is_inited() const -> bool
+{
+    return static_cast<bool>(device);
+}
+
+auto PipelineLayoutCache::GetLayout(std::span<const ShaderReflection> stages,
+                                    std::span<const ExternalSet> external_sets,
+                                    std::span<const BindingOverride> overrides) -> hrs::expected<Layout, vk::Result>
+{
+    //sets[set] - merged bindings of all stages
+    vector<vector<vk::DescriptorSetLayoutBinding>> sets;
+    optional<vk::PushConstantRange> push_constant;
+    for(auto &stage : stages)
+    {
+        for(auto &refl_binding : stage.bindings)
+        {
+            if(sets.size() <= refl_binding.set)
+                sets.resize(refl_binding.set + 1);
+
+            auto type = refl_binding.type;
+            auto override_it = std::find_if(overrides.begin(), overrides.end(), [&](const BindingOverride &ov)
+            {
+                return ov.set == refl_binding.set && ov.binding == refl_binding.binding;
+            });
+
+            if(override_it != overrides.end())
+                type = override_it->type;
+
+            auto &set = sets[refl_binding.set];
+            auto binding_it = std::find_if(set.begin(), set.end(), [&](const vk::DescriptorSetLayoutBinding &b)
+            {
+                return b.binding == refl_binding.binding;
+            });
+
+            if(binding_it == set.end())
+                set.push_back(vk::DescriptorSetLayoutBinding(refl_binding.binding, type, refl_binding.count, stage.stage));
+            else if(binding_it->descriptorType != type || binding_it->descriptorCount != refl_binding.count)
+                return vk::Result::eErrorInitializationFailed;//stages disagree about binding
+            else
+                binding_it->stageFlags |= stage.stage;
+        }
+
+        if(stage.push_constant)
+        {
+            if(!push_constant)
+                push_constant = stage.push_constant;
+            else
+            {
+                //one range for all stages, so every stage may push the whole block
+                uint32_t begin = std::min(push_constant->offset, stage.push_constant->offset);
+                uint32_t end = std::max(push_constant->offset + push_constant->size,
+                                        stage.push_constant->offset + stage.push_constant->size);
+                push_constant->stageFlags |= stage.push_constant->stageFlags;
+                push_constant->offset = begin;
+                push_constant->size = end - begin;
+            }
+        }
+    }
+
+    for(auto &ext : external_sets)
+        if(sets.size() <= ext.set)
+            sets.resize(ext.set + 1);
+
+    Layout layout;
+    layout.set_layouts.resize(sets.size());
+    layout.push_constant = push_constant;
+    for(uint32_t i = 0; i < sets.size(); i++)
+    {
+        auto ext_it = std::find_if(external_sets.begin(), external_sets.end(), [i](const ExternalSet &ext)
+        {
+            return ext.set == i;
+        });
+
+        if(ext_it != external_sets.end())
+        {
+            layout.set_layouts[i] = ext_it->layout;
+            continue;
+        }
+
+        //unused set numbers in between get empty layout
+        std::sort(sets[i].begin(), sets[i].end(), [](const vk::DescriptorSetLayoutBinding &l, const vk::DescriptorSetLayoutBinding &r)
+        {
+            return l.binding < r.binding;
+        });
+
+        auto set_layout = get_set_layout(SetLayoutKey{std::move(sets[i])});
+        if(!set_layout.has_value())
+            return set_layout.error();
+
+        layout.set_layouts[i] = set_layout.value();
+    }
+
+    auto ppl_layout = get_pipeline_layout(PipelineLayoutKey{layout.set_layouts, push_constant});
+    if(!ppl_layout.has_value())
+        return ppl_layout.error();
+
+    layout.layout = ppl_layout.value();
+    return layout;
+}
+
+auto PipelineLayoutCache::GetSetLayoutCount() const -> size_t
+{
+    return set_layouts.size();
+}
+
+auto PipelineLayoutCache::GetPipelineLayoutCount() const -> size_t
+{
+    return pipeline_layouts.size();
+}
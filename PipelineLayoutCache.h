@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <optional>
+#include <unordered_map>
+#include "VulkanInclude.h"
+#include "ShaderReflection.h"
+#include "utils/expected.hpp"
+
+//Builds descriptor set and pipeline layouts from reflected stages and deduplicates them by content.
+//Equal interfaces get the same handles, so pipelines with them stay compatible and share bound descriptor sets.
+//Layouts live until destroy, handles returned from cache must not be destroyed by caller
+class PipelineLayoutCache
+{
+public:
+    //set owned by another module (e.g. frame data ring), its layout is used as is instead of reflected one
+    struct ExternalSet
+    {
+        uint32_t set;
+        vk::DescriptorSetLayout layout;
+    };
+
+    //replaces reflected type, SPIR-V doesn't tell dynamic buffers from plain ones
+    struct BindingOverride
+    {
+        uint32_t set;
+        uint32_t binding;
+        vk::DescriptorType type;
+    };
+
+    struct Layout
+    {
+        vk::PipelineLayout layout;
+        std::vector<vk::DescriptorSetLayout> set_layouts;//index is set number
+        std::optional<vk::PushConstantRange> push_constant;//stages are union of stages that declare it
+    };
+
+private:
+    struct SetLayoutKey
+    {
+        std::vector<vk::DescriptorSetLayoutBinding> bindings;//sorted by binding, no immutable samplers
+
+        auto operator==(const SetLayoutKey &key) const -> bool;
+    };
+
+    struct PipelineLayoutKey
+    {
+        std::vector<vk::DescriptorSetLayout> set_layouts;
+        std::optional<vk::PushConstantRange> push_constant;
+
+        auto operator==(const PipelineLayoutKey &key) const -> bool;
+    };
+
+    struct KeyHash
+    {
+        auto operator()(const SetLayoutKey &key) const -> size_t;
+        auto operator()(const PipelineLayoutKey &key) const -> size_t;
+    };
+
+    vk::Device device;
+    std::unordered_map<SetLayoutKey, vk::DescriptorSetLayout, KeyHash> set_layouts;
+    std::unordered_map<PipelineLayoutKey, vk::PipelineLayout, KeyHash> pipeline_layouts;
+
+    auto get_set_layout(SetLayoutKey &&key) -> hrs::expected<vk::DescriptorSetLayout, vk::Result>;
+    auto get_pipeline_layout(PipelineLayoutKey &&key) -> hrs::expected<vk::PipelineLayout, vk::Result>;
+public:
+    PipelineLayoutCache() = default;
+    PipelineLayoutCache(const PipelineLayoutCache &plc) = delete;
+    ~PipelineLayoutCache() = default;
+
+    auto init(vk::Device dev) -> void;
+    auto destroy() -> void;
+    auto is_inited() const -> bool;
+
+    //bindings of the same set and number are merged over stages, their types and counts must agree
+    auto GetLayout(std::span<const ShaderReflection> stages,
+                   std::span<const ExternalSet> external_sets = {},
+                   std::span<const BindingOverride> overrides = {}) -> hrs::expected<Layout, vk::Result>;
+
+    auto GetSetLayoutCount() const -> size_t;
+    auto GetPipelineLayoutCount() const -> size_t;
+};
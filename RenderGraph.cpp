@@ -0,0 +1,673 @@
+#include "RenderGraph.h"
+#include <algorithm>
+
+using
+    std::vector,
+    std::optional;
+
+static constexpr vk::AccessFlags WRITE_ACCESS_MASK =
+    vk::AccessFlagBits::eShaderWrite |
+    vk::AccessFlagBits::eColorAttachmentWrite |
+    vk::AccessFlagBits::eDepthStencilAttachmentWrite |
+    vk::AccessFlagBits::eTransferWrite |
+    vk::AccessFlagBits::eHostWrite |
+    vk::AccessFlagBits::eMemoryWrite;
+
+static auto usage_from_access(const RenderGraph::Access &access) -> vk::ImageUsageFlags
+{
+    vk::ImageUsageFlags usage;
+    if(access.access & (vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite))
+        usage |= vk::ImageUsageFlagBits::eColorAttachment;
+
+    if(access.access & (vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite))
+        usage |= vk::ImageUsageFlagBits::eDepthStencilAttachment;
+
+    if(access.access & vk::AccessFlagBits::eInputAttachmentRead)
+        usage |= vk::ImageUsageFlagBits::eInputAttachment;
+
+    if(access.access & (vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite))
+    {
+        //general layout means image load/store, anything else is sampled
+        if(access.layout == vk::ImageLayout::eGeneral)
+            usage |= vk::ImageUsageFlagBits::eStorage;
+        else
+            usage |= vk::ImageUsageFlagBits::eSampled;
+    }
+
+    if(access.access & vk::AccessFlagBits::eTransferRead)
+        usage |= vk::ImageUsageFlagBits::eTransferSrc;
+
+    if(access.access & vk::AccessFlagBits::eTransferWrite)
+        usage |= vk::ImageUsageFlagBits::eTransferDst;
+
+    return usage;
+}
+
+auto RenderGraph::Barriers::is_empty() const -> bool
+{
+    return !src_stages && !dst_stages && image_barriers.empty();
+}
+
+auto RenderGraph::PassBuilder::Read(ResourceId id, const Access &access) -> PassBuilder &
+{
+    graph->add_access(pass, id, access, true, false);
+    return *this;
+}
+
+auto RenderGraph::PassBuilder::Write(ResourceId id, const Access &access) -> PassBuilder &
+{
+    graph->add_access(pass, id, access, false, true);
+    return *this;
+}
+
+auto RenderGraph::PassBuilder::SetSideEffects() -> PassBuilder &
+{
+    graph->passes[pass].has_side_effects = true;
+    return *this;
+}
+
+auto RenderGraph::add_access(PassId pass, ResourceId id, const Access &access, bool is_read, bool is_write) -> void
+{
+    //read and write of the same resource by one pass is single access, e.g. depth test with depth write
+    for(auto &pass_access : passes[pass].accesses)
+    {
+        if(pass_access.id == id)
+        {
+            pass_access.access.stages |= access.stages;
+            pass_access.access.access |= access.access;
+            pass_access.access.layout = access.layout;
+            pass_access.is_read |= is_read;
+            pass_access.is_write |= is_write;
+            return;
+        }
+    }
+
+    passes[pass].accesses.push_back(PassAccess{id, access, is_read, is_write});
+}
+
+auto RenderGraph::cull_passes() -> void
+{
+    //anything written to imported resource is observable outside of graph
+    vector<bool> is_needed(resources.size(), false);
+    for(size_t i = 0; i < resources.size(); i++)
+        is_needed[i] = resources[i].is_imported;
+
+    for(size_t i = passes.size(); i > 0; i--)
+    {
+        auto &pass = passes[i - 1];
+        pass.is_live = pass.has_side_effects;
+        for(auto &pass_access : pass.accesses)
+            if(pass_access.is_write && is_needed[pass_access.id])
+                pass.is_live = true;
+
+        if(!pass.is_live)
+            continue;
+
+        for(auto &pass_access : pass.accesses)
+            if(pass_access.is_read)
+                is_needed[pass_access.id] = true;
+    }
+}
+
+auto RenderGraph::compute_lifetimes() -> void
+{
+    for(auto &res : resources)
+    {
+        res.first_pass.reset();
+        res.last_pass.reset();
+    }
+
+    for(PassId i = 0; i < passes.size(); i++)
+    {
+        if(!passes[i].is_live)
+            continue;
+
+        for(auto &pass_access : passes[i].accesses)
+        {
+            auto &res = resources[pass_access.id];
+            if(!res.first_pass)
+                res.first_pass = i;
+
+            res.last_pass = i;
+            res.last_access = pass_access.access;
+        }
+    }
+}
+
+auto RenderGraph::create_transients() -> vk::Result
+{
+    vector<ResourceId> transients;
+    for(ResourceId id = 0; id < resources.size(); id++)
+    {
+        auto &res = resources[id];
+        if(res.is_imported || !res.is_image || !res.first_pass)
+            continue;
+
+        vk::ImageUsageFlags usage = res.desc.usage;
+        for(auto &pass : passes)
+            if(pass.is_live)
+                for(auto &pass_access : pass.accesses)
+                    if(pass_access.id == id)
+                        usage |= usage_from_access(pass_access.access);
+
+        vk::ImageCreateInfo image_info;
+        image_info
+            .setImageType(vk::ImageType::e2D)
+            .setFormat(res.desc.format)
+            .setExtent(vk::Extent3D(res.desc.extent.width, res.desc.extent.height, 1))
+            .setMipLevels(1)
+            .setArrayLayers(1)
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setTiling(vk::ImageTiling::eOptimal)
+            .setUsage(usage)
+            .setSharingMode(vk::SharingMode::eExclusive)
+            .setInitialLayout(vk::ImageLayout::eUndefined);
+
+        auto image_tmp = device.createImage(image_info);
+        if(image_tmp.result != vk::Result::eSuccess)
+            return image_tmp.result;
+
+        res.image = image_tmp.value;
+        res.requirements = device.getImageMemoryRequirements(res.image);
+        transients.push_back(id);
+    }
+
+    if(transients.empty())
+        return vk::Result::eSuccess;
+
+    vk::MemoryRequirements heap_req;
+    heap_req.size = place_transients(transients);
+    heap_req.alignment = 1;
+    heap_req.memoryTypeBits = ~uint32_t(0);
+    for(auto id : transients)
+    {
+        heap_req.alignment = std::max(heap_req.alignment, resources[id].requirements.alignment);
+        heap_req.memoryTypeBits &= resources[id].requirements.memoryTypeBits;
+    }
+
+    //all transients live in single allocation, so they must agree on memory type
+    if(heap_req.memoryTypeBits == 0)
+        return vk::Result::eErrorFeatureNotPresent;
+
+    auto memory_tmp = allocator->Allocate(heap_req,
+                                          vk::MemoryPropertyFlagBits::eDeviceLocal,
+                                          {},
+                                          DeviceAllocator::ResourceTiling::Optimal);
+    if(!memory_tmp.has_value())
+        return memory_tmp.error();
+
+    transient_memory = memory_tmp.value();
+
+    for(auto id : transients)
+    {
+        auto &res = resources[id];
+        auto res_bind = device.bindImageMemory(res.image, transient_memory.memory, transient_memory.offset + res.memory_offset);
+        if(res_bind != vk::Result::eSuccess)
+            return res_bind;
+
+        vk::ImageViewCreateInfo view_info;
+        view_info
+            .setImage(res.image)
+            .setViewType(vk::ImageViewType::e2D)
+            .setFormat(res.desc.format)
+            .setSubresourceRange(res.range);
+
+        auto view_tmp = device.createImageView(view_info);
+        if(view_tmp.result != vk::Result::eSuccess)
+            return view_tmp.result;
+
+        res.view = view_tmp.value;
+    }
+
+    return vk::Result::eSuccess;
+}
+
+auto RenderGraph::place_transients(const std::vector<ResourceId> &transients) -> vk::DeviceSize
+{
+    auto is_lifetime_intersected = [this](ResourceId a, ResourceId b) -> bool
+    {
+        auto &res_a = resources[a];
+        auto &res_b = resources[b];
+        return !(res_a.last_pass.value() < res_b.first_pass.value() || res_b.last_pass.value() < res_a.first_pass.value());
+    };
+
+    //biggest first, smaller ones fill holes between them
+    vector<ResourceId> sorted = transients;
+    std::sort(sorted.begin(), sorted.end(), [this](ResourceId a, ResourceId b)
+    {
+        return resources[a].requirements.size > resources[b].requirements.size;
+    });
+
+    vector<ResourceId> placed;
+    vk::DeviceSize heap_size = 0;
+    transient_unaliased_size = 0;
+    for(auto id : sorted)
+    {
+        auto &res = resources[id];
+        auto align = [&res](vk::DeviceSize offset)
+        {
+            return (offset + res.requirements.alignment - 1) / res.requirements.alignment * res.requirements.alignment;
+        };
+
+        vector<vk::DeviceSize> candidates{0};
+        for(auto other : placed)
+            if(is_lifetime_intersected(id, other))
+                candidates.push_back(align(resources[other].memory_offset + resources[other].requirements.size));
+
+        std::sort(candidates.begin(), candidates.end());
+        for(auto offset : candidates)
+        {
+            bool is_free = true;
+            for(auto other : placed)
+            {
+                auto &other_res = resources[other];
+                if(is_lifetime_intersected(id, other) &&
+                   offset < other_res.memory_offset + other_res.requirements.size &&
+                   other_res.memory_offset < offset + res.requirements.size)
+                {
+                    is_free = false;
+                    break;
+                }
+            }
+
+            if(is_free)
+            {
+                res.memory_offset = offset;
+                break;
+            }
+        }
+
+        placed.push_back(id);
+        heap_size = std::max(heap_size, res.memory_offset + res.requirements.size);
+        transient_unaliased_size += res.requirements.size;
+    }
+
+    return heap_size;
+}
+
+auto RenderGraph::is_memory_overlapped(ResourceId a, ResourceId b) const -> bool
+{
+    auto &res_a = resources[a];
+    auto &res_b = resources[b];
+    return res_a.memory_offset < res_b.memory_offset + res_b.requirements.size &&
+           res_b.memory_offset < res_a.memory_offset + res_a.requirements.size;
+}
+
+auto RenderGraph::initial_state(ResourceId id) const -> SyncState
+{
+    auto &res = resources[id];
+    SyncState state;
+    if(res.is_imported)
+    {
+        state.layout = res.initial.layout;
+        if(res.initial.access & WRITE_ACCESS_MASK)
+        {
+            state.write_stages = res.initial.stages;
+            state.write_access = res.initial.access & WRITE_ACCESS_MASK;
+        }
+        else
+            state.read_stages = res.initial.stages;
+
+        return state;
+    }
+
+    //transient memory is taken over from previous occupants of the same bytes:
+    //earlier ones in this frame, otherwise all of them in previous frame
+    auto add_occupant = [&](const Resource &occupant)
+    {
+        state.write_stages |= occupant.last_access.stages;
+        state.write_access |= occupant.last_access.access & WRITE_ACCESS_MASK;
+    };
+
+    bool has_predecessor = false;
+    for(ResourceId other = 0; other < resources.size(); other++)
+    {
+        auto &other_res = resources[other];
+        if(other == id || other_res.is_imported || !other_res.is_image || !other_res.first_pass)
+            continue;
+
+        if(other_res.last_pass.value() < res.first_pass.value() && is_memory_overlapped(id, other))
+        {
+            add_occupant(other_res);
+            has_predecessor = true;
+        }
+    }
+
+    if(!has_predecessor)
+    {
+        for(ResourceId other = 0; other < resources.size(); other++)
+        {
+            auto &other_res = resources[other];
+            if(other_res.is_imported || !other_res.is_image || !other_res.first_pass)
+                continue;
+
+            if(other == id || is_memory_overlapped(id, other))
+                add_occupant(other_res);
+        }
+    }
+
+    return state;
+}
+
+auto RenderGraph::sync_access(ResourceId id, SyncState &state, const Access &access, bool is_write, Barriers &barriers) const -> void
+{
+    if(resources[id].is_image && access.layout != state.layout)
+    {
+        barriers.image_barriers.push_back(ImageBarrier{id, state.layout, access.layout, state.write_access, access.access});
+        barriers.src_stages |= state.write_stages | state.read_stages;
+        barriers.dst_stages |= access.stages;
+
+        //transition is write itself, later accesses are chained through stages of this one
+        state.layout = access.layout;
+        state.write_stages = access.stages;
+        state.write_access = (is_write ? access.access & WRITE_ACCESS_MASK : vk::AccessFlags());
+        state.read_stages = (is_write ? vk::PipelineStageFlags() : access.stages);
+        state.visible_stages = (is_write ? vk::PipelineStageFlags() : access.stages);
+        state.visible_access = (is_write ? vk::AccessFlags() : access.access);
+        return;
+    }
+
+    if(is_write)
+    {
+        if(state.read_stages)
+        {
+            //WAR needs only execution dependency, reads are already ordered after previous write
+            barriers.src_stages |= state.read_stages;
+            barriers.dst_stages |= access.stages;
+        }
+        else if(state.write_stages)
+        {
+            barriers.src_stages |= state.write_stages;
+            barriers.src_access |= state.write_access;
+            barriers.dst_stages |= access.stages;
+            barriers.dst_access |= access.access;
+        }
+
+        state.write_stages = access.stages;
+        state.write_access = access.access & WRITE_ACCESS_MASK;
+        state.read_stages = {};
+        state.visible_stages = {};
+        state.visible_access = {};
+    }
+    else
+    {
+        //write is made visible once for every reader stage and access
+        bool is_visible = !(access.stages & ~state.visible_stages) && !(access.access & ~state.visible_access);
+        if(state.write_stages && !is_visible)
+        {
+            barriers.src_stages |= state.write_stages;
+            barriers.src_access |= state.write_access;
+            barriers.dst_stages |= access.stages;
+            barriers.dst_access |= access.access;
+            state.visible_stages |= access.stages;
+            state.visible_access |= access.access;
+        }
+
+        state.read_stages |= access.stages;
+    }
+}
+
+auto RenderGraph::compute_barriers() -> void
+{
+    vector<SyncState> states(resources.size());
+    for(ResourceId id = 0; id < resources.size(); id++)
+        if(resources[id].first_pass)
+            states[id] = initial_state(id);
+
+    for(auto &pass : passes)
+    {
+        pass.barriers = {};
+        if(!pass.is_live)
+            continue;
+
+        for(auto &pass_access : pass.accesses)
+            sync_access(pass_access.id, states[pass_access.id], pass_access.access, pass_access.is_write, pass.barriers);
+    }
+
+    final_barriers = {};
+    for(ResourceId id = 0; id < resources.size(); id++)
+    {
+        auto &res = resources[id];
+        if(res.is_imported && res.first_pass && res.final)
+            sync_access(id, states[id], res.final.value(), false, final_barriers);
+    }
+}
+
+auto RenderGraph::record_barriers(vk::CommandBuffer buf, const Barriers &barriers) const -> void
+{
+    if(barriers.is_empty())
+        return;
+
+    vector<vk::ImageMemoryBarrier> image_barriers;
+    image_barriers.reserve(barriers.image_barriers.size());
+    for(auto &barrier : barriers.image_barriers)
+    {
+        auto &res = resources[barrier.id];
+        image_barriers.push_back(vk::ImageMemoryBarrier()
+            .setSrcAccessMask(barrier.src_access)
+            .setDstAccessMask(barrier.dst_access)
+            .setOldLayout(barrier.old_layout)
+            .setNewLayout(barrier.new_layout)
+            .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setImage(res.image)
+            .setSubresourceRange(res.range));
+    }
+
+    //buffers never need own barriers, global one is enough
+    vector<vk::MemoryBarrier> memory_barriers;
+    if(barriers.src_access || barriers.dst_access)
+        memory_barriers.push_back(vk::MemoryBarrier(barriers.src_access, barriers.dst_access));
+
+    buf.pipelineBarrier(barriers.src_stages ? barriers.src_stages : vk::PipelineStageFlagBits::eTopOfPipe,
+                        barriers.dst_stages ? barriers.dst_stages : vk::PipelineStageFlagBits::eBottomOfPipe,
+                        {},
+                        memory_barriers,
+                        {},
+                        image_barriers);
+}
+
+auto RenderGraph::destroy_transients() -> void
+{
+    for(auto &res : resources)
+    {
+        if(res.is_imported)
+            continue;
+
+        if(deletion_queue)
+        {
+            deletion_queue->Push(res.view);
+            deletion_queue->Push(res.image);
+        }
+        else
+        {
+            device.destroy(res.view);
+            device.destroy(res.image);
+        }
+        res.view = vk::ImageView();
+        res.image = vk::Image();
+    }
+
+    if(transient_memory)
+    {
+        if(deletion_queue)
+            deletion_queue->Push(transient_memory);
+        else
+            allocator->Free(transient_memory);
+    }
+
+    transient_memory = {};
+    transient_unaliased_size = 0;
+}
+
+auto RenderGraph::init(vk::Device dev, DeviceAllocator &alloc, DeletionQueue *deletion) -> void
+{
+    device = dev;
+    allocator = &alloc;
+    deletion_queue = deletion;
+}
+
+auto RenderGraph::destroy() -> void
+{
+    if(!is_inited())
+        return;
+
+    Reset();
+    device = vk::Device();
+    allocator = nullptr;
+    deletion_queue = nullptr;
+}
+
+auto RenderGraph::is_inited() const -> bool
+{
+    return allocator != nullptr;
+}
+
+auto RenderGraph::Reset() -> void
+{
+    destroy_transients();
+    resources.clear();
+    passes.clear();
+    final_barriers = {};
+    is_compiled = false;
+}
+
+auto RenderGraph::ImportImage(std::string_view name,
+                              vk::Image image,
+                              const vk::ImageSubresourceRange &range,
+                              const Access &initial,
+                              const std::optional<Access> &final) -> ResourceId
+{
+    Resource res;
+    res.name = name;
+    res.is_image = true;
+    res.is_imported = true;
+    res.image = image;
+    res.range = range;
+    res.initial = initial;
+    res.final = final;
+    resources.push_back(std::move(res));
+    is_compiled = false;
+    return resources.size() - 1;
+}
+
+auto RenderGraph::ImportBuffer(std::string_view name,
+                               vk::Buffer buffer,
+                               const Access &initial,
+                               const std::optional<Access> &final) -> ResourceId
+{
+    Resource res;
+    res.name = name;
+    res.is_image = false;
+    res.is_imported = true;
+    res.buffer = buffer;
+    res.initial = initial;
+    res.final = final;
+    resources.push_back(std::move(res));
+    is_compiled = false;
+    return resources.size() - 1;
+}
+
+auto RenderGraph::CreateImage(std::string_view name, const ImageDesc &desc) -> ResourceId
+{
+    Resource res;
+    res.name = name;
+    res.is_image = true;
+    res.is_imported = false;
+    res.desc = desc;
+    res.range = vk::ImageSubresourceRange(desc.aspect, 0, 1, 0, 1);
+    resources.push_back(std::move(res));
+    is_compiled = false;
+    return resources.size() - 1;
+}
+
+auto RenderGraph::AddPass(std::string_view name, const std::function<void (PassBuilder &)> &setup, RecordFunc record) -> PassId
+{
+    Pass pass;
+    pass.name = name;
+    passes.push_back(std::move(pass));
+
+    PassId id = passes.size() - 1;
+    PassBuilder builder(this, id);
+    setup(builder);
+    passes[id].record = std::move(record);
+    is_compiled = false;
+    return id;
+}
+
+auto RenderGraph::Compile() -> vk::Result
+{
+    if(!is_inited())
+        return vk::Result::eErrorInitializationFailed;
+
+    is_compiled = false;
+    destroy_transients();
+    cull_passes();
+    compute_lifetimes();
+
+    auto res = create_transients();
+    if(res != vk::Result::eSuccess)
+    {
+        destroy_transients();
+        return res;
+    }
+
+    compute_barriers();
+    is_compiled = true;
+    return vk::Result::eSuccess;
+}
+
+auto RenderGraph::Execute(vk::CommandBuffer buf) const -> void
+{
+    for(auto &pass : passes)
+    {
+        if(!pass.is_live)
+            continue;
+
+        record_barriers(buf, pass.barriers);
+        if(pass.record)
+            pass.record(buf);
+    }
+
+    record_barriers(buf, final_barriers);
+}
+
+auto RenderGraph::SetImportedImage(ResourceId id, vk::Image image) -> void
+{
+    resources[id].image = image;
+}
+
+auto RenderGraph::SetImportedBuffer(ResourceId id, vk::Buffer buffer) -> void
+{
+    resources[id].buffer = buffer;
+}
+
+auto RenderGraph::GetImage(ResourceId id) const -> vk::Image
+{
+    return resources[id].image;
+}
+
+auto RenderGraph::GetImageView(ResourceId id) const -> vk::ImageView
+{
+    return resources[id].view;
+}
+
+auto RenderGraph::IsPassLive(PassId id) const -> bool
+{
+    return passes[id].is_live;
+}
+
+auto RenderGraph::IsCompiled() const -> bool
+{
+    return is_compiled;
+}
+
+auto RenderGraph::GetTransientMemorySize() const -> vk::DeviceSize
+{
+    return transient_memory.size;
+}
+
+auto RenderGraph::GetTransientUnaliasedSize() const -> vk::DeviceSize
+{
+    return transient_unaliased_size;
+}
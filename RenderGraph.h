@@ -0,0 +1,194 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <optional>
+#include "VulkanInclude.h"
+#include "DeviceAllocator.h"
+#include "DeletionQueue.h"
+
+//Declarative frame graph: passes declare what they read and write, graph is compiled once
+//(passes culling, barriers, transient images placement) and then only executed every frame.
+//Passes are executed in declaration order, so declaration order is the dependency order.
+//Transient images whose lifetimes don't intersect share the same memory.
+class RenderGraph
+{
+public:
+    using ResourceId = uint32_t;
+    using PassId = uint32_t;
+
+    //how resource is used by pass, layout is ignored for buffers
+    struct Access
+    {
+        vk::PipelineStageFlags stages;
+        vk::AccessFlags access;
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    };
+
+    struct ImageDesc
+    {
+        vk::Format format = vk::Format::eUndefined;
+        vk::Extent2D extent;
+        vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
+        vk::ImageUsageFlags usage;//added to usage deduced from accesses
+    };
+
+    class PassBuilder
+    {
+    private:
+        friend class RenderGraph;
+        RenderGraph *graph;
+        PassId pass;
+
+        PassBuilder(RenderGraph *_graph, PassId _pass) : graph(_graph), pass(_pass) {}
+    public:
+        auto Read(ResourceId id, const Access &access) -> PassBuilder &;
+        auto Write(ResourceId id, const Access &access) -> PassBuilder &;
+        //pass is never culled, e.g. it writes something graph doesn't know about
+        auto SetSideEffects() -> PassBuilder &;
+    };
+
+    using RecordFunc = std::function<void (vk::CommandBuffer buf)>;
+
+private:
+    struct Resource
+    {
+        std::string name;
+        bool is_image = true;
+        bool is_imported = false;
+
+        ImageDesc desc;
+        vk::ImageSubresourceRange range;
+        vk::Image image;
+        vk::ImageView view;
+        vk::Buffer buffer;
+
+        //imported only: state before first and after last pass of frame
+        Access initial;
+        std::optional<Access> final;
+
+        //filled by Compile
+        std::optional<PassId> first_pass;
+        std::optional<PassId> last_pass;
+        Access last_access;
+        vk::MemoryRequirements requirements;
+        vk::DeviceSize memory_offset = 0;
+    };
+
+    struct PassAccess
+    {
+        ResourceId id;
+        Access access;
+        bool is_read;
+        bool is_write;
+    };
+
+    struct ImageBarrier
+    {
+        ResourceId id;
+        vk::ImageLayout old_layout;
+        vk::ImageLayout new_layout;
+        vk::AccessFlags src_access;
+        vk::AccessFlags dst_access;
+    };
+
+    //all barriers before pass are merged into single pipelineBarrier
+    struct Barriers
+    {
+        vk::PipelineStageFlags src_stages;
+        vk::PipelineStageFlags dst_stages;
+        vk::AccessFlags src_access;//global memory barrier
+        vk::AccessFlags dst_access;
+        std::vector<ImageBarrier> image_barriers;
+
+        auto is_empty() const -> bool;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::vector<PassAccess> accesses;
+        RecordFunc record;
+        bool has_side_effects = false;
+        bool is_live = false;
+        Barriers barriers;
+    };
+
+    //hazard tracking state of resource during compilation
+    struct SyncState
+    {
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        vk::PipelineStageFlags write_stages;
+        vk::AccessFlags write_access;
+        vk::PipelineStageFlags read_stages;//reads since last write
+        vk::PipelineStageFlags visible_stages;//where last write is already visible
+        vk::AccessFlags visible_access;
+    };
+
+    vk::Device device;
+    DeviceAllocator *allocator = nullptr;
+    DeletionQueue *deletion_queue = nullptr;
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    Barriers final_barriers;
+    bool is_compiled = false;
+
+    DeviceAllocator::Allocation transient_memory;
+    vk::DeviceSize transient_unaliased_size = 0;
+
+    auto add_access(PassId pass, ResourceId id, const Access &access, bool is_read, bool is_write) -> void;
+    auto cull_passes() -> void;
+    auto compute_lifetimes() -> void;
+    auto create_transients() -> vk::Result;
+    auto place_transients(const std::vector<ResourceId> &transients) -> vk::DeviceSize;
+    auto initial_state(ResourceId id) const -> SyncState;
+    auto sync_access(ResourceId id, SyncState &state, const Access &access, bool is_write, Barriers &barriers) const -> void;
+    auto is_memory_overlapped(ResourceId a, ResourceId b) const -> bool;
+    auto compute_barriers() -> void;
+    auto record_barriers(vk::CommandBuffer buf, const Barriers &barriers) const -> void;
+    auto destroy_transients() -> void;
+public:
+    RenderGraph() = default;
+    RenderGraph(const RenderGraph &rg) = delete;
+    ~RenderGraph() = default;
+
+    //transients of previous graph go to deletion queue if it's set, frames in flight may still use them
+    auto init(vk::Device dev, DeviceAllocator &alloc, DeletionQueue *deletion = nullptr) -> void;
+    auto destroy() -> void;
+    auto is_inited() const -> bool;
+
+    //removes all passes and resources
+    auto Reset() -> void;
+
+    //final - state graph must leave resource in, empty - whatever last pass left
+    auto ImportImage(std::string_view name,
+                     vk::Image image,
+                     const vk::ImageSubresourceRange &range,
+                     const Access &initial,
+                     const std::optional<Access> &final = {}) -> ResourceId;
+    auto ImportBuffer(std::string_view name,
+                      vk::Buffer buffer,
+                      const Access &initial,
+                      const std::optional<Access> &final = {}) -> ResourceId;
+    //transient images exist only inside frame, contents are undefined at first use
+    auto CreateImage(std::string_view name, const ImageDesc &desc) -> ResourceId;
+
+    auto AddPass(std::string_view name, const std::function<void (PassBuilder &)> &setup, RecordFunc record) -> PassId;
+
+    auto Compile() -> vk::Result;
+    auto Execute(vk::CommandBuffer buf) const -> void;
+
+    //handles of imported resources may change every frame, e.g. acquired swapchain image
+    auto SetImportedImage(ResourceId id, vk::Image image) -> void;
+    auto SetImportedBuffer(ResourceId id, vk::Buffer buffer) -> void;
+
+    auto GetImage(ResourceId id) const -> vk::Image;
+    auto GetImageView(ResourceId id) const -> vk::ImageView;
+    auto IsPassLive(PassId id) const -> bool;
+    auto IsCompiled() const -> bool;
+    auto GetTransientMemorySize() const -> vk::DeviceSize;
+    //what transients would take without aliasing
+    auto GetTransientUnaliasedSize() const -> vk::DeviceSize;
+};
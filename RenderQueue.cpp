@@ -0,0 +1,140 @@
+#include "RenderQueue.h"
+#include <numeric>
+#include <algorithm>
+
+using
+    std::array,
+    std::span;
+
+namespace
+{
+    constexpr uint32_t RADIX_BITS = 8;
+    constexpr uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+
+    constexpr auto field_mask(uint32_t bits) -> uint64_t
+    {
+        return (uint64_t(1) << bits) - 1;
+    }
+
+    auto is_same_batch(const RenderQueue::DrawItem &l, const RenderQueue::DrawItem &r) -> bool
+    {
+        return l.pass == r.pass &&
+               l.pipeline == r.pipeline &&
+               l.mesh.first_index == r.mesh.first_index &&
+               l.mesh.vertex_offset == r.mesh.vertex_offset &&
+               l.mesh.index_count == r.mesh.index_count &&
+               l.uniform_offset == r.uniform_offset &&
+               l.storage_offset == r.storage_offset;
+    }
+}
+
+auto RenderQueue::MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, const MeshHandle &mesh, float depth) -> uint64_t
+{
+    //mesh field wraps for index buffers above 2^MESH_BITS, that only splits some batches
+    uint64_t depth_field = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * field_mask(DEPTH_BITS));
+    uint64_t key = pass & field_mask(PASS_BITS);
+    key = (key << PIPELINE_BITS) | (pipeline & field_mask(PIPELINE_BITS));
+    key = (key << MATERIAL_BITS) | (material & field_mask(MATERIAL_BITS));
+    key = (key << MESH_BITS) | (mesh.first_index & field_mask(MESH_BITS));
+    key = (key << DEPTH_BITS) | depth_field;
+    return key;
+}
+
+//LSD radix sort of keys with item indices, stable, so equal keys keep submission order
+auto RenderQueue::sort_keys() -> void
+{
+    size_t count = keys.size();
+    sorted_keys.assign(keys.begin(), keys.end());
+    order.resize(count);
+    std::iota(order.begin(), order.end(), 0);
+    tmp_keys.resize(count);
+    tmp_order.resize(count);
+
+    for(uint32_t shift = 0; shift < 64; shift += RADIX_BITS)
+    {
+        array<uint32_t, RADIX_SIZE> offsets{};
+        for(auto key : sorted_keys)
+            offsets[(key >> shift) & (RADIX_SIZE - 1)]++;
+
+        //usually most high fields are equal for all keys, such pass doesn't change order
+        if(offsets[(sorted_keys[0] >> shift) & (RADIX_SIZE - 1)] == count)
+            continue;
+
+        uint32_t sum = 0;
+        for(auto &offset : offsets)
+        {
+            uint32_t digit_count = offset;
+            offset = sum;
+            sum += digit_count;
+        }
+
+        for(size_t i = 0; i < count; i++)
+        {
+            uint32_t pos = offsets[(sorted_keys[i] >> shift) & (RADIX_SIZE - 1)]++;
+            tmp_keys[pos] = sorted_keys[i];
+            tmp_order[pos] = order[i];
+        }
+
+        sorted_keys.swap(tmp_keys);
+        order.swap(tmp_order);
+    }
+}
+
+auto RenderQueue::Clear() -> void
+{
+    items.clear();
+    keys.clear();
+    transforms.clear();
+    draws.clear();
+}
+
+auto RenderQueue::Submit(const DrawItem &item) -> void
+{
+    items.push_back(item);
+    keys.push_back(MakeKey(item.pass, item.pipeline, item.material, item.mesh, item.depth));
+}
+
+auto RenderQueue::Build() -> std::span<const GraphicsDevice::InstancedMeshDraw>
+{
+    transforms.clear();
+    draws.clear();
+    if(items.empty())
+        return draws;
+
+    //sorting works on a copy, so Build can be called again without remaking keys
+    sort_keys();
+
+    //transforms must not reallocate while spans point into it
+    transforms.reserve(items.size());
+    size_t run_begin = 0;
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        auto &item = items[order[i]];
+        transforms.push_back(item.transform);
+
+        bool is_run_end = (i + 1 == order.size() || !is_same_batch(item, items[order[i + 1]]));
+        if(!is_run_end)
+            continue;
+
+        draws.push_back(GraphicsDevice::InstancedMeshDraw
+        {
+            .mesh = item.mesh,
+            .transforms = span<const twv::glsl::Mat4x4>(transforms.data() + run_begin, i + 1 - run_begin),
+            .uniform_offset = item.uniform_offset,
+            .storage_offset = item.storage_offset
+        });
+        run_begin = i + 1;
+    }
+
+    return draws;
+}
+
+auto RenderQueue::GetSubmittedCount() const -> size_t
+{
+    return items.size();
+}
+
+auto RenderQueue::GetDrawCount() const -> size_t
+{
+    return draws.size();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <optional>
+#include "GraphicsDevice.h"
+
+//Collects single draws of a frame, orders them by packed 64-bit key and merges runs
+//of the same mesh and material into instanced draws for GraphicsDevice::DrawInstanced.
+//Key from most to least significant: pass | pipeline | material | mesh | depth,
+//so state changes happen only between runs and opaque draws of a run go front to back
+class RenderQueue
+{
+public:
+    constexpr static uint32_t PASS_BITS = 4;
+    constexpr static uint32_t PIPELINE_BITS = 4;
+    constexpr static uint32_t MATERIAL_BITS = 14;
+    constexpr static uint32_t MESH_BITS = 22;
+    constexpr static uint32_t DEPTH_BITS = 20;
+    static_assert(PASS_BITS + PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + DEPTH_BITS == 64);
+
+    //material is what draws share besides mesh, here it's frame data chunks.
+    //Key fields are only order, draws are merged by exact mesh and chunk offsets
+    struct DrawItem
+    {
+        uint32_t pass = 0;
+        uint32_t pipeline = 0;
+        uint32_t material = 0;
+        MeshHandle mesh;
+        twv::glsl::Mat4x4 transform;
+        float depth = 0.0f;//normalized view depth, [0, 1]
+        std::optional<uint32_t> uniform_offset;
+        std::optional<uint32_t> storage_offset;
+    };
+
+private:
+    std::vector<DrawItem> items;
+    std::vector<uint64_t> keys;//made once by Submit, in submission order
+    std::vector<uint64_t> sorted_keys;
+    std::vector<uint32_t> order;
+    std::vector<uint64_t> tmp_keys;
+    std::vector<uint32_t> tmp_order;
+
+    std::vector<twv::glsl::Mat4x4> transforms;//sorted, instanced draws point into it
+    std::vector<GraphicsDevice::InstancedMeshDraw> draws;
+
+    auto sort_keys() -> void;
+public:
+    RenderQueue() = default;
+    ~RenderQueue() = default;
+
+    static auto MakeKey(uint32_t pass, uint32_t pipeline, uint32_t material, const MeshHandle &mesh, float depth) -> uint64_t;
+
+    auto Clear() -> void;
+    auto Submit(const DrawItem &item) -> void;
+    //returned draws are valid until next Clear or Build
+    auto Build() -> std::span<const GraphicsDevice::InstancedMeshDraw>;
+
+    auto GetSubmittedCount() const -> size_t;
+    auto GetDrawCount() const -> size_t;//of the last Build
+};
@@ -1,9 +1,17 @@
 #include "ResourceManager.h"
 #include <fstream>
+#include <algorithm>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
 
 using
     std::string,
     std::ifstream,
+    std::ofstream,
     std::filesystem::file_size,
     std::error_code,
     std::vector,
@@ -35,7 +43,7 @@ ResourceManager::ResourceManager(ResourceManager &&rm) noexcept
 
 ResourceManager::~ResourceManager()
 {
-
+    StopShaderWatch();
 }
 
 auto ResourceManager::init(const ResourceManagerFS &init_path) -> ResourceManager::Result
@@ -74,7 +82,7 @@ auto ResourceManager::LoadShaders(const std::vector<std::string_view> &shaders_n
             input_shader_stream.read(reinterpret_cast<ifstream::char_type *>(shader_code.data()), shader_file_size);
             input_shader_stream.close();
 
-            shaders.insert({string(sh_name), move(shader_code)});
+            shaders.insert_or_assign(string(sh_name), move(shader_code));
         }
 
         shader_path = shader_path.parent_path();
@@ -88,3 +96,126 @@ auto ResourceManager::LoadShaders(const std::vector<std::string_view> &shaders_n
 
     return {Result::error_code::Success};
 }
+
+auto ResourceManager::StartShaderWatch() -> hrs::ResultDef<ResourceManager::Result>
+{
+#ifdef __linux__
+    StopShaderWatch();
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd == -1)
+        return {Result::error_code::WatchError, string("inotify_init1: ") + std::strerror(errno)};
+
+    //editors and compilers either rewrite file in place or move new one over it
+    int wd = inotify_add_watch(fd, start_fs_path.shader_search_path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if(wd == -1)
+    {
+        string err = std::strerror(errno);
+        close(fd);
+        return {Result::error_code::WatchError, start_fs_path.shader_search_path.string() + ": " + err};
+    }
+
+    watch_fd = fd;
+    watch_wd = wd;
+    return {Result::error_code::Success};
+#else
+    return {Result::error_code::WatchNotSupported};
+#endif
+}
+
+auto ResourceManager::StopShaderWatch() -> void
+{
+#ifdef __linux__
+    if(watch_fd == -1)
+        return;
+
+    inotify_rm_watch(watch_fd, watch_wd);
+    close(watch_fd);
+#endif
+    watch_fd = -1;
+    watch_wd = -1;
+}
+
+auto ResourceManager::IsShaderWatched() const -> bool
+{
+    return watch_fd != -1;
+}
+
+auto ResourceManager::PollChangedShaders() -> std::vector<std::string>
+{
+    vector<string> changed;
+#ifdef __linux__
+    if(watch_fd == -1)
+        return changed;
+
+    alignas(inotify_event) char events_buf[4096];
+    while(true)
+    {
+        auto read_size = read(watch_fd, events_buf, sizeof(events_buf));
+        if(read_size <= 0)
+            break;//EAGAIN - no more events
+
+        for(ssize_t pos = 0; pos < read_size;)
+        {
+            auto event = reinterpret_cast<const inotify_event *>(events_buf + pos);
+            pos += sizeof(inotify_event) + event->len;
+            if(event->len == 0)
+                continue;
+
+            //only shaders somebody asked for, other files in directory are ignored
+            string name(event->name);
+            if(!shaders.contains(name))
+                continue;
+
+            if(std::find(changed.begin(), changed.end(), name) == changed.end())
+                changed.push_back(move(name));
+        }
+    }
+#endif
+    return changed;
+}
+
+auto ResourceManager::LoadPipelineCache(const std::filesystem::path &cache_path) -> hrs::ResultDef<ResourceManager::Result>
+{
+    //first run has no cache yet, pipelines are just compiled from scratch
+    error_code erc;
+    if(!std::filesystem::exists(cache_path, erc) && !erc)
+    {
+        pipeline_cache.clear();
+        return {Result::error_code::Success};
+    }
+
+    auto cache_size = file_size(cache_path, erc);
+    if(erc)
+        return {Result::error_code::InputOpenError, string("Pipeline cache size can't be read: ") + cache_path.string()};
+
+    ifstream input_cache_stream(cache_path, ios_base::in | ios_base::binary);
+    if(!input_cache_stream.is_open())
+        return {Result::error_code::InputOpenError, string("This path is not accessable: ") + cache_path.string()};
+
+    vector<uint8_t> cache_data(cache_size, 0);
+    input_cache_stream.read(reinterpret_cast<ifstream::char_type *>(cache_data.data()), cache_size);
+    if(input_cache_stream.rdstate() & ios_base::failbit)
+        return {Result::error_code::InputOpenError, string("Pipeline cache reading error: ") + cache_path.string()};
+
+    pipeline_cache = move(cache_data);
+    return {Result::error_code::Success};
+}
+
+auto ResourceManager::SavePipelineCache(const std::filesystem::path &cache_path, std::span<const uint8_t> data) -> hrs::ResultDef<ResourceManager::Result>
+{
+    ofstream output_cache_stream(cache_path, ios_base::out | ios_base::binary | ios_base::trunc);
+    if(!output_cache_stream.is_open())
+        return {Result::error_code::OutputOpenError, string("This path is not accessable: ") + cache_path.string()};
+
+    output_cache_stream.write(reinterpret_cast<const ofstream::char_type *>(data.data()), data.size());
+    if(output_cache_stream.rdstate() & ios_base::badbit)
+        return {Result::error_code::OutputOpenError, string("Pipeline cache writing error: ") + cache_path.string()};
+
+    return {Result::error_code::Success};
+}
+
+auto ResourceManager::GetPipelineCache() -> std::span<const uint8_t>
+{
+    return pipeline_cache;
+}
@@ -19,6 +19,7 @@ public:
 
             // I/O
 			InputOpenError,
+            OutputOpenError,
             //ReadError,
 
             //path
@@ -26,7 +27,11 @@ public:
 
             //load
             ShaderLoadError,
-            ShaderRecieveError
+            ShaderRecieveError,
+
+            //watch
+            WatchNotSupported,
+            WatchError
         } code;
 
         constexpr Result(error_code err = error_code::Success) : code(err)
@@ -53,6 +58,11 @@ public:
 private:
     ResourceManagerFS start_fs_path;
     std::map<std::string, std::vector<uint32_t>> shaders;
+    std::vector<uint8_t> pipeline_cache;
+
+    //inotify instance and watch of shader search path, -1 - not watched
+    int watch_fd = -1;
+    int watch_wd = -1;
 public:
     ResourceManager();
     ResourceManager(const ResourceManager &rm);
@@ -61,8 +71,21 @@ public:
 
     auto init(const ResourceManagerFS &init_path = ResourceManagerFS()) -> Result;
 
+    //already loaded shaders are replaced with new code
     auto LoadShaders(const std::vector<std::string_view> &shaders_names) -> hrs::ResultDef<ResourceManager::Result>;
 
+    //watch is non blocking, changes are collected by polling
+    auto StartShaderWatch() -> hrs::ResultDef<ResourceManager::Result>;
+    auto StopShaderWatch() -> void;
+    auto IsShaderWatched() const -> bool;
+    //names of loaded shaders whose files were rewritten since last poll, code isn't reloaded here
+    auto PollChangedShaders() -> std::vector<std::string>;
+
+    //missing file is success with empty cache, errors are only for existing unreadable files
+    auto LoadPipelineCache(const std::filesystem::path &cache_path) -> hrs::ResultDef<ResourceManager::Result>;
+    auto SavePipelineCache(const std::filesystem::path &cache_path, std::span<const uint8_t> data) -> hrs::ResultDef<ResourceManager::Result>;
+    auto GetPipelineCache() -> std::span<const uint8_t>;
+
     template<typename T_INFO_CONTAINER>
     requires requires(T_INFO_CONTAINER &t)
     {
@@ -97,6 +120,9 @@ constexpr auto ResourceManager::Result::message() const -> std::string_view
 		case Result::error_code::InputOpenError:
 			res = "Input stream reading error";
             break;
+        case Result::error_code::OutputOpenError:
+            res = "Output stream opening error";
+            break;
 		/*case Result::error_code::ReadError:
             res = "Input stream reading error";
             break;
@@ -106,6 +132,12 @@ constexpr auto ResourceManager::Result::message() const -> std::string_view
         case Result::error_code::ShaderRecieveError:
             res = "Shader receiving error";
             break;
+        case Result::error_code::WatchNotSupported:
+            res = "File watching isn't supported on this platform";
+            break;
+        case Result::error_code::WatchError:
+            res = "File watching error";
+            break;
     }
 
     return res;
@@ -124,6 +156,9 @@ constexpr auto ResourceManager::Result::to_view() const -> std::string_view
             break;
 		case Result::error_code::InputOpenError:
             res = "InputOpenError";
+            break;
+        case Result::error_code::OutputOpenError:
+            res = "OutputOpenError";
             break;
 		/*case Result::error_code::ReadError:
             res = "ReadError";
@@ -134,6 +169,12 @@ constexpr auto ResourceManager::Result::to_view() const -> std::string_view
         case Result::error_code::ShaderRecieveError:
             res = "ShaderRecieveError";
             break;
+        case Result::error_code::WatchNotSupported:
+            res = "WatchNotSupported";
+            break;
+        case Result::error_code::WatchError:
+            res = "WatchError";
+            break;
     }
 
     return res;
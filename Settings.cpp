@@ -97,6 +97,14 @@ auto Settings::write_settings(std::filesystem::path write_path) -> Result
     output_settings_stream<<window_width.name<<" = "<<window_width.value<<endl;
     output_settings_stream<<window_height.name<<" = "<<window_height.value<<endl;
     output_settings_stream<<window_is_fullscreen.name<<" = "<<window_is_fullscreen.value<<endl;
+    output_settings_stream<<frames_in_flight.name<<" = "<<frames_in_flight.value<<endl;
+    output_settings_stream<<headless.name<<" = "<<headless.value<<endl;
+    output_settings_stream<<headless_frames.name<<" = "<<headless_frames.value<<endl;
+    output_settings_stream<<present_mode.name<<" = "<<present_mode.value<<endl;
+    output_settings_stream<<swapchain_images.name<<" = "<<swapchain_images.value<<endl;
+    output_settings_stream<<frame_rate_limit.name<<" = "<<frame_rate_limit.value<<endl;
+    output_settings_stream<<depth_prepass.name<<" = "<<depth_prepass.value<<endl;
+    output_settings_stream<<shader_hot_reload.name<<" = "<<shader_hot_reload.value<<endl;
 
     output_settings_stream.close();
 
@@ -181,6 +189,22 @@ auto Settings::set_setting(const string_view &setting_string_represenation) -> R
         return extracted_res;
     else if(auto extracted_res = set_extracted_value(window_is_fullscreen, extracted_param_name, extracted_value); extracted_res != Result::error_code::ParameterNotRecognized)
         return extracted_res;
+    else if(auto extracted_res = set_extracted_value(frames_in_flight, extracted_param_name, extracted_value); extracted_res != Result::error_code::ParameterNotRecognized)
+        return extracted_res;
+    else if(auto extracted_res = set_extracted_value(headless, extracted_param_name, extracted_value); extracted_res != Result::error_code::ParameterNotRecognized)
+        return extracted_res;
+    else if(auto extracted_res = set_extracted_value(headless_frames, extracted_param_name, extracted_value); extracted_res != Result::error_code::ParameterNotRecognized)
+        return extracted_res;
+    else if(auto extracted_res = set_extracted_value(present_mode, extracted_param_name, extracted_value); extracted_res != Result::error_code::ParameterNotRecognized)
+        return extracted_res;
+    else if(auto extracted_res = set_extracted_value(swapchain_images, extracted_param_name, extracted_value); extracted_res != Result::error_code::ParameterNotRecognized)
+        return extracted_res;
+    else if(auto extracted_res = set_extracted_value(frame_rate_limit, extracted_param_name, extracted_value); extracted_res != Result::error_code::ParameterNotRecognized)
+        return extracted_res;
+    else if(auto extracted_res = set_extracted_value(depth_prepass, extracted_param_name, extracted_value); extracted_res != Result::error_code::ParameterNotRecognized)
+        return extracted_res;
+    else if(auto extracted_res = set_extracted_value(shader_hot_reload, extracted_param_name, extracted_value); extracted_res != Result::error_code::ParameterNotRecognized)
+        return extracted_res;
     else
         return Result::error_code::ParameterNotRecognized;
 
@@ -15,6 +15,14 @@ struct Settings
         WINDOW_WIDTH = 2,
         WINDOW_HEIGHT = 3,
         WINDOW_IS_FULLSCREEN = 4,
+        FRAMES_IN_FLIGHT = 5,
+        HEADLESS = 6,
+        HEADLESS_FRAMES = 7,
+        PRESENT_MODE = 8,
+        SWAPCHAIN_IMAGES = 9,
+        FRAME_RATE_LIMIT = 10,
+        DEPTH_PREPASS = 11,
+        SHADER_HOT_RELOAD = 12,
 
         RREPRESENTATION_ENUM_MAX
     };
@@ -74,6 +82,17 @@ struct Settings
     parameter<int> window_width {"window_width", 800};
     parameter<int> window_height {"window_height", 600};
     parameter<bool> window_is_fullscreen {"window_is_fullscreen", false};
+    parameter<int> frames_in_flight {"frames_in_flight", 2};
+    //offscreen rendering of window_width x window_height without window
+    parameter<bool> headless {"headless", false};
+    parameter<int> headless_frames {"headless_frames", 1000};
+    //mailbox, immediate, fifo or fifo_relaxed, falls back if surface doesn't support it
+    parameter<std::string> present_mode {"present_mode", "mailbox"};
+    parameter<int> swapchain_images {"swapchain_images", 0};//0 - chosen by device
+    parameter<int> frame_rate_limit {"frame_rate_limit", 0};//0 - not limited
+    parameter<bool> depth_prepass {"depth_prepass", false};
+    //watches shaders_path and rebuilds pipelines of changed shaders
+    parameter<bool> shader_hot_reload {"shader_hot_reload", false};
 
 	Settings();
 
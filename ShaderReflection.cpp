@@ -0,0 +1,566 @@
+#include "ShaderReflection.h"
+#include <algorithm>
+
+using
+    std::vector,
+    std::optional,
+    std::span;
+
+namespace
+{
+    constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+    constexpr size_t SPIRV_HEADER_WORDS = 5;
+
+    //only what reflection reads, values are from SPIR-V specification
+    namespace spv
+    {
+        enum Op : uint32_t
+        {
+            OpEntryPoint = 15,
+            OpTypeVoid = 19,
+            OpTypeBool = 20,
+            OpTypeInt = 21,
+            OpTypeFloat = 22,
+            OpTypeVector = 23,
+            OpTypeMatrix = 24,
+            OpTypeImage = 25,
+            OpTypeSampler = 26,
+            OpTypeSampledImage = 27,
+            OpTypeArray = 28,
+            OpTypeRuntimeArray = 29,
+            OpTypeStruct = 30,
+            OpTypePointer = 32,
+            OpConstant = 43,
+            OpVariable = 59,
+            OpDecorate = 71,
+            OpMemberDecorate = 72,
+            OpTypeAccelerationStructureKHR = 5341
+        };
+
+        enum Decoration : uint32_t
+        {
+            Block = 2,
+            BufferBlock = 3,
+            ArrayStride = 6,
+            MatrixStride = 7,
+            BuiltIn = 11,
+            Location = 30,
+            Binding = 33,
+            DescriptorSet = 34,
+            Offset = 35
+        };
+
+        enum StorageClass : uint32_t
+        {
+            UniformConstant = 0,
+            Input = 1,
+            Uniform = 2,
+            PushConstant = 9,
+            StorageBuffer = 12
+        };
+
+        enum Dim : uint32_t
+        {
+            DimBuffer = 5,
+            DimSubpassData = 6
+        };
+    }
+
+    struct Decorations
+    {
+        optional<uint32_t> set;
+        optional<uint32_t> binding;
+        optional<uint32_t> location;
+        optional<uint32_t> array_stride;
+        bool is_builtin = false;
+        bool is_block = false;
+        bool is_buffer_block = false;
+    };
+
+    struct MemberDecorations
+    {
+        optional<uint32_t> offset;
+        optional<uint32_t> matrix_stride;
+        bool is_builtin = false;
+    };
+
+    //instructions are kept whole: inst[0] is word count and opcode, operands follow
+    struct Module
+    {
+        vector<span<const uint32_t>> ids;//types and constants by result id
+        vector<Decorations> decorations;
+        vector<vector<MemberDecorations>> member_decorations;
+        vector<span<const uint32_t>> variables;
+        optional<uint32_t> execution_model;
+
+        auto get(uint32_t id) const -> span<const uint32_t>
+        {
+            return (id < ids.size() ? ids[id] : span<const uint32_t>());
+        }
+
+        auto opcode(uint32_t id) const -> uint32_t
+        {
+            auto inst = get(id);
+            return (inst.empty() ? 0 : inst[0] & 0xFFFF);
+        }
+
+        auto member(uint32_t id, uint32_t ind) const -> const MemberDecorations *
+        {
+            if(id >= member_decorations.size() || ind >= member_decorations[id].size())
+                return nullptr;
+
+            return &member_decorations[id][ind];
+        }
+
+        auto constant(uint32_t id) const -> optional<uint32_t>
+        {
+            auto inst = get(id);
+            if(opcode(id) != spv::OpConstant || inst.size() < 4)
+                return {};
+
+            return inst[3];
+        }
+
+        //size of type in explicitly laid out block
+        auto type_size(uint32_t id, optional<uint32_t> matrix_stride = {}) const -> optional<uint32_t>
+        {
+            auto inst = get(id);
+            switch(opcode(id))
+            {
+                case spv::OpTypeInt:
+                case spv::OpTypeFloat:
+                    return inst[2] / 8;
+                case spv::OpTypeVector:
+                    {
+                        auto component = type_size(inst[2]);
+                        if(!component)
+                            return {};
+
+                        return component.value() * inst[3];
+                    }
+                case spv::OpTypeMatrix:
+                    {
+                        auto column = (matrix_stride ? matrix_stride : type_size(inst[2]));
+                        if(!column)
+                            return {};
+
+                        return column.value() * inst[3];
+                    }
+                case spv::OpTypeArray:
+                    {
+                        auto length = constant(inst[3]);
+                        auto element = (decorations[id].array_stride ? decorations[id].array_stride : type_size(inst[2]));
+                        if(!length || !element)
+                            return {};
+
+                        return element.value() * length.value();
+                    }
+                case spv::OpTypeStruct:
+                    {
+                        uint32_t size = 0;
+                        for(uint32_t i = 0; i < inst.size() - 2; i++)
+                        {
+                            auto member_dec = member(id, i);
+                            if(!member_dec || !member_dec->offset)
+                                return {};
+
+                            auto member_size = type_size(inst[2 + i], member_dec->matrix_stride);
+                            if(!member_size)
+                                return {};
+
+                            size = std::max(size, member_dec->offset.value() + member_size.value());
+                        }
+
+                        return size;
+                    }
+            }
+
+            return {};
+        }
+    };
+
+    auto to_stage(uint32_t execution_model) -> optional<vk::ShaderStageFlagBits>
+    {
+        switch(execution_model)
+        {
+            case 0:
+                return vk::ShaderStageFlagBits::eVertex;
+            case 1:
+                return vk::ShaderStageFlagBits::eTessellationControl;
+            case 2:
+                return vk::ShaderStageFlagBits::eTessellationEvaluation;
+            case 3:
+                return vk::ShaderStageFlagBits::eGeometry;
+            case 4:
+                return vk::ShaderStageFlagBits::eFragment;
+            case 5:
+                return vk::ShaderStageFlagBits::eCompute;
+        }
+
+        return {};
+    }
+
+    auto to_descriptor_type(const Module &mod, uint32_t storage_class, uint32_t type_id) -> optional<vk::DescriptorType>
+    {
+        auto inst = mod.get(type_id);
+        switch(storage_class)
+        {
+            case spv::StorageBuffer:
+                return vk::DescriptorType::eStorageBuffer;
+            case spv::Uniform:
+                //old style storage buffers are uniform blocks decorated with BufferBlock
+                if(mod.decorations[type_id].is_buffer_block)
+                    return vk::DescriptorType::eStorageBuffer;
+                return vk::DescriptorType::eUniformBuffer;
+            case spv::UniformConstant:
+                switch(mod.opcode(type_id))
+                {
+                    case spv::OpTypeSampler:
+                        return vk::DescriptorType::eSampler;
+                    case spv::OpTypeSampledImage:
+                        return vk::DescriptorType::eCombinedImageSampler;
+                    case spv::OpTypeImage:
+                        {
+                            //sampled operand: 1 - with sampler, 2 - storage
+                            bool is_storage = (inst[7] == 2);
+                            if(inst[3] == spv::DimBuffer)
+                                return (is_storage ? vk::DescriptorType::eStorageTexelBuffer : vk::DescriptorType::eUniformTexelBuffer);
+                            else if(inst[3] == spv::DimSubpassData)
+                                return vk::DescriptorType::eInputAttachment;
+
+                            return (is_storage ? vk::DescriptorType::eStorageImage : vk::DescriptorType::eSampledImage);
+                        }
+                    case spv::OpTypeAccelerationStructureKHR:
+                        return vk::DescriptorType::eAccelerationStructureKHR;
+                }
+                break;
+        }
+
+        return {};
+    }
+
+    auto to_vertex_format(const Module &mod, uint32_t type_id) -> optional<vk::Format>
+    {
+        constexpr vk::Format float_formats[] =
+            {vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat, vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat};
+        constexpr vk::Format sint_formats[] =
+            {vk::Format::eR32Sint, vk::Format::eR32G32Sint, vk::Format::eR32G32B32Sint, vk::Format::eR32G32B32A32Sint};
+        constexpr vk::Format uint_formats[] =
+            {vk::Format::eR32Uint, vk::Format::eR32G32Uint, vk::Format::eR32G32B32Uint, vk::Format::eR32G32B32A32Uint};
+
+        uint32_t components = 1;
+        if(mod.opcode(type_id) == spv::OpTypeVector)
+        {
+            components = mod.get(type_id)[3];
+            type_id = mod.get(type_id)[2];
+        }
+
+        auto inst = mod.get(type_id);
+        if(components == 0 || components > 4 || inst.size() < 3 || inst[2] != 32)
+            return {};
+
+        if(mod.opcode(type_id) == spv::OpTypeFloat)
+            return float_formats[components - 1];
+        else if(mod.opcode(type_id) == spv::OpTypeInt)
+            return (inst[3] ? sint_formats[components - 1] : uint_formats[components - 1]);
+
+        return {};
+    }
+
+    //matrices and arrays take consecutive locations
+    auto add_vertex_inputs(const Module &mod, uint32_t type_id, uint32_t location, vector<ShaderReflection::VertexInput> &inputs) -> optional<uint32_t>
+    {
+        auto inst = mod.get(type_id);
+        uint32_t count = 1;
+        if(mod.opcode(type_id) == spv::OpTypeArray)
+        {
+            auto length = mod.constant(inst[3]);
+            if(!length)
+                return {};
+
+            count = length.value();
+            type_id = inst[2];
+            inst = mod.get(type_id);
+        }
+
+        uint32_t columns = 1;
+        if(mod.opcode(type_id) == spv::OpTypeMatrix)
+        {
+            columns = inst[3];
+            type_id = inst[2];
+        }
+
+        auto format = to_vertex_format(mod, type_id);
+        if(!format)
+            return {};
+
+        for(uint32_t i = 0; i < count * columns; i++)
+            inputs.push_back({location + i, format.value()});
+
+        return location + count * columns;
+    }
+}
+
+auto ShaderReflection::Reflect(std::span<const uint32_t> code) -> hrs::expected<ShaderReflection, Error>
+{
+    if(code.size() < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC)
+        return Error::InvalidHeader;
+
+    //operands read below are checked against word count only where it's variable
+    constexpr auto min_words = [](uint32_t opcode) -> uint32_t
+    {
+        switch(opcode)
+        {
+            case spv::OpTypeImage:
+                return 9;
+            case spv::OpTypeMatrix:
+            case spv::OpTypeVector:
+            case spv::OpTypeArray:
+            case spv::OpTypeInt:
+            case spv::OpTypePointer:
+            case spv::OpVariable:
+            case spv::OpMemberDecorate:
+                return 4;
+            case spv::OpTypeFloat:
+            case spv::OpTypeRuntimeArray:
+            case spv::OpDecorate:
+                return 3;
+        }
+
+        return 2;
+    };
+
+    uint32_t bound = code[3];
+    Module mod;
+    mod.ids.resize(bound);
+    mod.decorations.resize(bound);
+    mod.member_decorations.resize(bound);
+
+    auto valid_id = [&](uint32_t id)
+    {
+        return id < bound;
+    };
+
+    for(size_t pos = SPIRV_HEADER_WORDS; pos < code.size();)
+    {
+        uint32_t word_count = code[pos] >> 16;
+        uint32_t opcode = code[pos] & 0xFFFF;
+        if(word_count < min_words(opcode) || pos + word_count > code.size())
+            return Error::InvalidInstruction;
+
+        auto inst = code.subspan(pos, word_count);
+        switch(opcode)
+        {
+            case spv::OpEntryPoint:
+                if(!mod.execution_model)
+                    mod.execution_model = inst[1];
+                break;
+            case spv::OpDecorate:
+                {
+                    if(!valid_id(inst[1]))
+                        return Error::InvalidInstruction;
+
+                    auto &dec = mod.decorations[inst[1]];
+                    optional<uint32_t> literal = (word_count > 3 ? optional<uint32_t>(inst[3]) : std::nullopt);
+                    switch(inst[2])
+                    {
+                        case spv::Block:
+                            dec.is_block = true;
+                            break;
+                        case spv::BufferBlock:
+                            dec.is_buffer_block = true;
+                            break;
+                        case spv::BuiltIn:
+                            dec.is_builtin = true;
+                            break;
+                        case spv::ArrayStride:
+                            dec.array_stride = literal;
+                            break;
+                        case spv::Location:
+                            dec.location = literal;
+                            break;
+                        case spv::Binding:
+                            dec.binding = literal;
+                            break;
+                        case spv::DescriptorSet:
+                            dec.set = literal;
+                            break;
+                    }
+                }
+                break;
+            case spv::OpMemberDecorate:
+                {
+                    //struct can't have more members than module has words, keeps resize below sane
+                    if(!valid_id(inst[1]) || inst[2] >= code.size())
+                        return Error::InvalidInstruction;
+
+                    auto &members = mod.member_decorations[inst[1]];
+                    if(members.size() <= inst[2])
+                        members.resize(inst[2] + 1);
+
+                    auto &dec = members[inst[2]];
+                    optional<uint32_t> literal = (word_count > 4 ? optional<uint32_t>(inst[4]) : std::nullopt);
+                    switch(inst[3])
+                    {
+                        case spv::BuiltIn:
+                            dec.is_builtin = true;
+                            break;
+                        case spv::Offset:
+                            dec.offset = literal;
+                            break;
+                        case spv::MatrixStride:
+                            dec.matrix_stride = literal;
+                            break;
+                    }
+                }
+                break;
+            case spv::OpTypeVoid:
+            case spv::OpTypeBool:
+            case spv::OpTypeInt:
+            case spv::OpTypeFloat:
+            case spv::OpTypeVector:
+            case spv::OpTypeMatrix:
+            case spv::OpTypeImage:
+            case spv::OpTypeSampler:
+            case spv::OpTypeSampledImage:
+            case spv::OpTypeArray:
+            case spv::OpTypeRuntimeArray:
+            case spv::OpTypeStruct:
+            case spv::OpTypePointer:
+            case spv::OpTypeAccelerationStructureKHR:
+                if(!valid_id(inst[1]))
+                    return Error::InvalidInstruction;
+                mod.ids[inst[1]] = inst;
+                break;
+            case spv::OpConstant:
+                if(word_count < 4 || !valid_id(inst[2]))
+                    return Error::InvalidInstruction;
+                mod.ids[inst[2]] = inst;
+                break;
+            case spv::OpVariable:
+                mod.variables.push_back(inst);
+                break;
+        }
+
+        pos += word_count;
+    }
+
+    if(!mod.execution_model)
+        return Error::NoEntryPoint;
+
+    auto stage = to_stage(mod.execution_model.value());
+    if(!stage)
+        return Error::UnsupportedType;
+
+    ShaderReflection refl;
+    refl.stage = stage.value();
+
+    //every declared variable is reported, even not statically used by entry point
+    for(auto &var : mod.variables)
+    {
+        uint32_t storage_class = var[3];
+        if(!valid_id(var[2]) || mod.opcode(var[1]) != spv::OpTypePointer || !valid_id(mod.get(var[1])[3]))
+            return Error::InvalidInstruction;
+
+        auto &dec = mod.decorations[var[2]];
+        uint32_t type_id = mod.get(var[1])[3];
+        switch(storage_class)
+        {
+            case spv::UniformConstant:
+            case spv::Uniform:
+            case spv::StorageBuffer:
+                {
+                    if(!dec.binding)
+                        break;
+
+                    uint32_t count = 1;
+                    while(mod.opcode(type_id) == spv::OpTypeArray)
+                    {
+                        auto length = mod.constant(mod.get(type_id)[3]);
+                        if(!length)
+                            return Error::UnsupportedType;
+
+                        count *= length.value();
+                        type_id = mod.get(type_id)[2];
+                    }
+
+                    //unbounded arrays need descriptor indexing, which isn't used
+                    if(mod.opcode(type_id) == spv::OpTypeRuntimeArray)
+                        return Error::UnsupportedType;
+
+                    auto type = to_descriptor_type(mod, storage_class, type_id);
+                    if(!type)
+                        return Error::UnsupportedType;
+
+                    refl.bindings.push_back({dec.set.value_or(0), dec.binding.value(), type.value(), count});
+                }
+                break;
+            case spv::PushConstant:
+                {
+                    if(mod.opcode(type_id) != spv::OpTypeStruct)
+                        return Error::UnsupportedType;
+
+                    auto size = mod.type_size(type_id);
+                    if(!size || size.value() == 0)
+                        return Error::UnsupportedType;
+
+                    uint32_t offset = size.value();
+                    for(auto &member : mod.member_decorations[type_id])
+                        offset = std::min(offset, member.offset.value_or(0));
+
+                    refl.push_constant = vk::PushConstantRange(refl.stage, offset, size.value() - offset);
+                }
+                break;
+            case spv::Input:
+                {
+                    if(refl.stage != vk::ShaderStageFlagBits::eVertex || dec.is_builtin || !dec.location)
+                        break;
+
+                    if(!add_vertex_inputs(mod, type_id, dec.location.value(), refl.vertex_inputs))
+                        return Error::UnsupportedType;
+                }
+                break;
+        }
+    }
+
+    std::sort(refl.bindings.begin(), refl.bindings.end(), [](const DescriptorBinding &l, const DescriptorBinding &r)
+    {
+        return (l.set != r.set ? l.set < r.set : l.binding < r.binding);
+    });
+
+    //aliased variables share binding
+    auto dup = std::unique(refl.bindings.begin(), refl.bindings.end(), [](const DescriptorBinding &l, const DescriptorBinding &r)
+    {
+        return l.set == r.set && l.binding == r.binding;
+    });
+    refl.bindings.erase(dup, refl.bindings.end());
+
+    std::sort(refl.vertex_inputs.begin(), refl.vertex_inputs.end(), [](const VertexInput &l, const VertexInput &r)
+    {
+        return l.location < r.location;
+    });
+
+    return refl;
+}
+
+auto ShaderReflection::ErrorToView(Error err) -> std::string_view
+{
+    std::string_view res;
+    switch(err)
+    {
+        case Error::InvalidHeader:
+            res = "InvalidHeader";
+            break;
+        case Error::InvalidInstruction:
+            res = "InvalidInstruction";
+            break;
+        case Error::NoEntryPoint:
+            res = "NoEntryPoint";
+            break;
+        case Error::UnsupportedType:
+            res = "UnsupportedType";
+            break;
+    }
+
+    return res;
+}
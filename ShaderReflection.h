@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <optional>
+#include <string_view>
+#include "VulkanInclude.h"
+#include "utils/expected.hpp"
+
+//Minimal SPIR-V reader, extracts only the interface pipeline creation depends on:
+//stage of entry point, descriptor bindings, push constant range and vertex inputs.
+//Dynamic buffers can't be told from plain ones by code, layout builder decides it (see PipelineLayoutCache)
+class ShaderReflection
+{
+public:
+    enum class Error : uint8_t
+    {
+        InvalidHeader,
+        InvalidInstruction,
+        NoEntryPoint,
+        UnsupportedType
+    };
+
+    struct DescriptorBinding
+    {
+        uint32_t set;
+        uint32_t binding;
+        vk::DescriptorType type;
+        uint32_t count;
+    };
+
+    struct VertexInput
+    {
+        uint32_t location;
+        vk::Format format;
+    };
+
+    vk::ShaderStageFlagBits stage = vk::ShaderStageFlagBits::eVertex;
+    std::vector<DescriptorBinding> bindings;//sorted by set and binding
+    std::optional<vk::PushConstantRange> push_constant;//stage flags are stage
+    std::vector<VertexInput> vertex_inputs;//vertex stage only, sorted by location, matrices take location per column
+
+    //first entry point is reflected
+    static auto Reflect(std::span<const uint32_t> code) -> hrs::expected<ShaderReflection, Error>;
+    static auto ErrorToView(Error err) -> std::string_view;
+};
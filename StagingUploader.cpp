@@ -0,0 +1,523 @@
+#include "StagingUploader.h"
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+using
+    std::optional,
+    std::lock_guard,
+    std::mutex,
+    std::move;
+
+auto StagingUploader::is_ownership_transfer_needed() const -> bool
+{
+    return transfer_queue.family != graphics_family;
+}
+
+auto StagingUploader::try_allocate_ring(vk::DeviceSize size) -> optional<vk::DeviceSize>
+{
+    //occupied bytes are always one circular interval ending at ring_head
+    vk::DeviceSize aligned_head = ((ring_head + copy_alignment - 1) / copy_alignment) * copy_alignment;
+    vk::DeviceSize start;
+    vk::DeviceSize total;
+    if(aligned_head + size <= ring_size)
+    {
+        start = aligned_head;
+        total = aligned_head - ring_head + size;
+    }
+    else
+    {
+        //tail of the ring is skipped
+        start = 0;
+        total = ring_size - ring_head + size;
+    }
+
+    if(ring_used + total > ring_size)
+        return {};
+
+    ring_used += total;
+    pending_ring_bytes += total;
+    ring_head = start + size;
+    return start;
+}
+
+auto StagingUploader::retire_batches() -> vk::Result
+{
+    if(in_flight.empty())
+        return vk::Result::eSuccess;
+
+    auto completed = device.getSemaphoreCounterValue(timeline);
+    if(completed.result != vk::Result::eSuccess)
+        return completed.result;
+
+    while(!in_flight.empty() && in_flight.front().timeline_value <= completed.value)
+    {
+        auto &batch = in_flight.front();
+        ring_used -= batch.ring_bytes;
+        for(auto &staging : batch.oversized_staging)
+            allocator->DestroyBuffer(staging);
+
+        free_bufs.push_back(batch.buf);
+        in_flight.pop_front();
+    }
+
+    return vk::Result::eSuccess;
+}
+
+auto StagingUploader::wait_oldest_batch() -> vk::Result
+{
+    if(in_flight.empty())
+        return vk::Result::eSuccess;
+
+    uint64_t value = in_flight.front().timeline_value;
+    vk::SemaphoreWaitInfo wait_info;
+    wait_info
+        .setFlags({})
+        .setSemaphores(timeline)
+        .setValues(value);
+
+    auto res = device.waitSemaphores(wait_info, std::numeric_limits<uint64_t>::max());
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    return retire_batches();
+}
+
+auto StagingUploader::submit_pending() -> vk::Result
+{
+    if(pending_buffer_copies.empty() && pending_image_copies.empty())
+        return vk::Result::eSuccess;
+
+    vk::CommandBuffer buf;
+    if(!free_bufs.empty())
+    {
+        buf = free_bufs.back();
+        free_bufs.pop_back();
+    }
+    else
+    {
+        vk::CommandBufferAllocateInfo comm_buf_info;
+        comm_buf_info
+            .setCommandPool(comm_pool)
+            .setLevel(vk::CommandBufferLevel::ePrimary)
+            .setCommandBufferCount(1);
+
+        auto buf_tmp = device.allocateCommandBuffers(comm_buf_info);
+        if(buf_tmp.result != vk::Result::eSuccess)
+            return buf_tmp.result;
+
+        buf = buf_tmp.value[0];
+    }
+
+    auto res = buf.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    if(res != vk::Result::eSuccess)
+    {
+        free_bufs.push_back(buf);
+        return res;
+    }
+
+    bool transfer_ownership = is_ownership_transfer_needed();
+    uint32_t src_family = (transfer_ownership ? transfer_queue.family : VK_QUEUE_FAMILY_IGNORED);
+    uint32_t dst_family = (transfer_ownership ? graphics_family : VK_QUEUE_FAMILY_IGNORED);
+
+    std::vector<vk::ImageMemoryBarrier> release_image_barriers;
+    std::vector<vk::ImageMemoryBarrier> to_transfer_barriers;
+
+    //buffers are concurrent, semaphore wait alone makes writes visible to graphics queue
+    for(auto &copy : pending_buffer_copies)
+    {
+        buf.copyBuffer(copy.src, copy.dst, copy.region);
+        graphics_wait.stages |= copy.dst_stages;
+    }
+
+    if(!pending_image_copies.empty())
+    {
+        for(auto &copy : pending_image_copies)
+        {
+            to_transfer_barriers.push_back(vk::ImageMemoryBarrier()
+                                            .setSrcAccessMask({})
+                                            .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+                                            .setOldLayout(vk::ImageLayout::eUndefined)
+                                            .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+                                            .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                                            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                                            .setImage(copy.dst)
+                                            .setSubresourceRange(copy.range));
+        }
+
+        buf.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                            vk::PipelineStageFlagBits::eTransfer,
+                            {},
+                            {},
+                            {},
+                            to_transfer_barriers);
+
+        for(auto &copy : pending_image_copies)
+        {
+            buf.copyBufferToImage(copy.src, copy.dst, vk::ImageLayout::eTransferDstOptimal, copy.region);
+
+            //layout transition is done here even without ownership transfer
+            vk::ImageMemoryBarrier barrier;
+            barrier
+                .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+                .setDstAccessMask({})
+                .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+                .setNewLayout(copy.final_layout)
+                .setSrcQueueFamilyIndex(src_family)
+                .setDstQueueFamilyIndex(dst_family)
+                .setImage(copy.dst)
+                .setSubresourceRange(copy.range);
+
+            release_image_barriers.push_back(barrier);
+            if(transfer_ownership)
+            {
+                acquire_image_barriers.push_back(vk::ImageMemoryBarrier(barrier)
+                                                    .setSrcAccessMask({})
+                                                    .setDstAccessMask(copy.dst_access));
+            }
+            graphics_wait.stages |= copy.dst_stages;
+        }
+    }
+
+    if(!release_image_barriers.empty())
+    {
+        buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                            vk::PipelineStageFlagBits::eBottomOfPipe,
+                            {},
+                            {},
+                            {},
+                            release_image_barriers);
+    }
+
+    res = buf.end();
+    if(res != vk::Result::eSuccess)
+    {
+        free_bufs.push_back(buf);
+        return res;
+    }
+
+    uint64_t signal_value = last_submitted_value + 1;
+    vk::TimelineSemaphoreSubmitInfo timeline_info;
+    timeline_info.setSignalSemaphoreValues(signal_value);
+
+    vk::SubmitInfo submit_info;
+    submit_info
+        .setPNext(&timeline_info)
+        .setCommandBuffers(buf)
+        .setSignalSemaphores(timeline);
+
+    res = transfer_queue.queue.submit(submit_info, {});
+    if(res != vk::Result::eSuccess)
+    {
+        free_bufs.push_back(buf);
+        return res;
+    }
+
+    last_submitted_value = signal_value;
+    graphics_wait.value = signal_value;
+
+    Batch batch;
+    batch.buf = buf;
+    batch.timeline_value = signal_value;
+    batch.ring_bytes = pending_ring_bytes;
+    batch.oversized_staging = move(pending_oversized);
+    in_flight.push_back(move(batch));
+
+    pending_buffer_copies.clear();
+    pending_image_copies.clear();
+    pending_oversized.clear();
+    pending_ring_bytes = 0;
+
+    return vk::Result::eSuccess;
+}
+
+auto StagingUploader::allocate_staging(std::span<const uint8_t> data, vk::Buffer &src, vk::DeviceSize &src_offset) -> vk::Result
+{
+    //big uploads would block the ring for everyone, so they get own staging buffer
+    if(data.size() > ring_size / 2)
+    {
+        vk::BufferCreateInfo staging_info;
+        staging_info
+            .setFlags({})
+            .setSize(data.size())
+            .setUsage(vk::BufferUsageFlagBits::eTransferSrc)
+            .setSharingMode(vk::SharingMode::eExclusive);
+
+        auto staging = allocator->CreateBuffer(staging_info, vk::MemoryPropertyFlagBits::eHostVisible);
+        if(!staging.has_value())
+            return staging.error();
+
+        std::memcpy(staging.value().allocation.mapped_ptr, data.data(), data.size());
+        auto res = allocator->Flush(staging.value().allocation);
+        if(res != vk::Result::eSuccess)
+        {
+            allocator->DestroyBuffer(staging.value());
+            return res;
+        }
+
+        src = staging.value().buffer;
+        src_offset = 0;
+        pending_oversized.push_back(staging.value());
+        return vk::Result::eSuccess;
+    }
+
+    auto offset = try_allocate_ring(data.size());
+    while(!offset)
+    {
+        auto res = retire_batches();
+        if(res != vk::Result::eSuccess)
+            return res;
+
+        offset = try_allocate_ring(data.size());
+        if(offset)
+            break;
+
+        //whole ring is taken by uploads that are not submitted yet
+        if(in_flight.empty())
+        {
+            if(pending_ring_bytes == 0)
+                return vk::Result::eErrorOutOfPoolMemory;
+
+            res = submit_pending();
+            if(res != vk::Result::eSuccess)
+                return res;
+        }
+
+        res = wait_oldest_batch();
+        if(res != vk::Result::eSuccess)
+            return res;
+
+        offset = try_allocate_ring(data.size());
+    }
+
+    std::memcpy(static_cast<uint8_t *>(ring.allocation.mapped_ptr) + offset.value(), data.data(), data.size());
+    auto res = allocator->Flush(ring.allocation, offset.value(), data.size());
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    src = ring.buffer;
+    src_offset = offset.value();
+    return vk::Result::eSuccess;
+}
+
+auto StagingUploader::init(vk::Device dev,
+                           vk::PhysicalDevice ph_dev,
+                           DeviceAllocator &alloc,
+                           const QueueDesc &transfer,
+                           uint32_t graphics_queue_family,
+                           vk::DeviceSize size) -> vk::Result
+{
+    device = dev;
+    allocator = &alloc;
+    transfer_queue = transfer;
+    graphics_family = graphics_queue_family;
+    ring_size = size;
+    ring_head = 0;
+    ring_used = 0;
+    last_submitted_value = 0;
+
+    auto limits = ph_dev.getProperties().limits;
+    copy_alignment = std::max(MIN_COPY_ALIGNMENT, limits.optimalBufferCopyOffsetAlignment);
+
+    vk::BufferCreateInfo ring_info;
+    ring_info
+        .setFlags({})
+        .setSize(ring_size)
+        .setUsage(vk::BufferUsageFlagBits::eTransferSrc)
+        .setSharingMode(vk::SharingMode::eExclusive);
+
+    auto ring_tmp = allocator->CreateBuffer(ring_info, vk::MemoryPropertyFlagBits::eHostVisible);
+    if(!ring_tmp.has_value())
+    {
+        allocator = nullptr;
+        return ring_tmp.error();
+    }
+
+    ring = ring_tmp.value();
+
+    vk::CommandPoolCreateInfo pool_info;
+    pool_info
+        .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient)
+        .setQueueFamilyIndex(transfer_queue.family);
+
+    auto pool_tmp = device.createCommandPool(pool_info);
+    if(pool_tmp.result != vk::Result::eSuccess)
+    {
+        destroy();
+        return pool_tmp.result;
+    }
+
+    comm_pool = pool_tmp.value;
+
+    vk::SemaphoreTypeCreateInfo timeline_type_info;
+    timeline_type_info
+        .setSemaphoreType(vk::SemaphoreType::eTimeline)
+        .setInitialValue(0);
+
+    auto timeline_tmp = device.createSemaphore(vk::SemaphoreCreateInfo().setPNext(&timeline_type_info));
+    if(timeline_tmp.result != vk::Result::eSuccess)
+    {
+        destroy();
+        return timeline_tmp.result;
+    }
+
+    timeline = timeline_tmp.value;
+    return vk::Result::eSuccess;
+}
+
+auto StagingUploader::destroy() -> void
+{
+    if(!allocator)
+        return;
+
+    //device must be idle here
+    for(auto &batch : in_flight)
+        for(auto &staging : batch.oversized_staging)
+            allocator->DestroyBuffer(staging);
+
+    for(auto &staging : pending_oversized)
+        allocator->DestroyBuffer(staging);
+
+    in_flight.clear();
+    pending_oversized.clear();
+    pending_buffer_copies.clear();
+    pending_image_copies.clear();
+    acquire_image_barriers.clear();
+    free_bufs.clear();
+    graphics_wait = {};
+
+    device.destroy(comm_pool);
+    device.destroy(timeline);
+    comm_pool = vk::CommandPool();
+    timeline = vk::Semaphore();
+
+    allocator->DestroyBuffer(ring);
+    allocator = nullptr;
+}
+
+auto StagingUploader::is_inited() const -> bool
+{
+    return allocator != nullptr;
+}
+
+auto StagingUploader::UploadBuffer(vk::Buffer dst,
+                                   vk::DeviceSize dst_offset,
+                                   std::span<const uint8_t> data,
+                                   vk::PipelineStageFlags dst_stages) -> vk::Result
+{
+    if(data.empty())
+        return vk::Result::eSuccess;
+
+    lock_guard<mutex> lck(uploader_mutex);
+
+    vk::Buffer src;
+    vk::DeviceSize src_offset;
+    auto res = allocate_staging(data, src, src_offset);
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    pending_buffer_copies.push_back(BufferCopyCmd
+    {
+        .src = src,
+        .dst = dst,
+        .region = vk::BufferCopy(src_offset, dst_offset, data.size()),
+        .dst_stages = dst_stages
+    });
+
+    return vk::Result::eSuccess;
+}
+
+auto StagingUploader::UploadImage(vk::Image dst,
+                                  const vk::BufferImageCopy &region,
+                                  const vk::ImageSubresourceRange &range,
+                                  std::span<const uint8_t> data,
+                                  vk::ImageLayout final_layout,
+                                  vk::PipelineStageFlags dst_stages,
+                                  vk::AccessFlags dst_access) -> vk::Result
+{
+    if(data.empty())
+        return vk::Result::eSuccess;
+
+    lock_guard<mutex> lck(uploader_mutex);
+
+    vk::Buffer src;
+    vk::DeviceSize src_offset;
+    auto res = allocate_staging(data, src, src_offset);
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    pending_image_copies.push_back(ImageCopyCmd
+    {
+        .src = src,
+        .dst = dst,
+        .region = vk::BufferImageCopy(region).setBufferOffset(src_offset),
+        .range = range,
+        .final_layout = final_layout,
+        .dst_stages = dst_stages,
+        .dst_access = dst_access
+    });
+
+    return vk::Result::eSuccess;
+}
+
+auto StagingUploader::Submit() -> vk::Result
+{
+    lock_guard<mutex> lck(uploader_mutex);
+
+    auto res = retire_batches();
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    return submit_pending();
+}
+
+auto StagingUploader::RecordAcquires(vk::CommandBuffer graphics_buf) -> GraphicsWait
+{
+    lock_guard<mutex> lck(uploader_mutex);
+
+    auto wait = graphics_wait;
+    if(!acquire_image_barriers.empty())
+    {
+        graphics_buf.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                                     graphics_wait.stages,
+                                     {},
+                                     {},
+                                     {},
+                                     acquire_image_barriers);
+    }
+
+    acquire_image_barriers.clear();
+    graphics_wait = {};
+    return wait;
+}
+
+auto StagingUploader::WaitIdle() -> vk::Result
+{
+    lock_guard<mutex> lck(uploader_mutex);
+
+    auto res = submit_pending();
+    if(res != vk::Result::eSuccess)
+        return res;
+
+    while(!in_flight.empty())
+    {
+        res = wait_oldest_batch();
+        if(res != vk::Result::eSuccess)
+            return res;
+    }
+
+    return vk::Result::eSuccess;
+}
+
+auto StagingUploader::GetTimelineSemaphore() const -> vk::Semaphore
+{
+    return timeline;
+}
+
+auto StagingUploader::GetQueueFamilies() const -> std::vector<uint32_t>
+{
+    if(!is_ownership_transfer_needed())
+        return {graphics_family};
+
+    return {graphics_family, transfer_queue.family};
+}
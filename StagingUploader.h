@@ -0,0 +1,137 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <span>
+#include <mutex>
+#include <optional>
+#include "VulkanInclude.h"
+#include "DeviceAllocator.h"
+
+//Streams data to device local resources through staging ring on transfer queue.
+//Batches signal timeline semaphore, graphics queue waits on it and acquires ownership of uploaded images,
+//so CPU never waits for uploads unless staging ring is exhausted.
+//Buffers are written again after graphics queue used them, so they aren't transferred between families:
+//buffer destinations must be shared concurrently between GetQueueFamilies()
+class StagingUploader
+{
+public:
+    constexpr static vk::DeviceSize DEFAULT_RING_SIZE = 32 * 1024 * 1024;
+    constexpr static vk::DeviceSize MIN_COPY_ALIGNMENT = 16;
+
+    struct QueueDesc
+    {
+        uint32_t family;
+        vk::Queue queue;
+    };
+
+    //what graphics submit must wait on before uploaded data is used
+    struct GraphicsWait
+    {
+        uint64_t value = 0;//0 - nothing to wait
+        vk::PipelineStageFlags stages;
+    };
+
+private:
+    struct BufferCopyCmd
+    {
+        vk::Buffer src;
+        vk::Buffer dst;
+        vk::BufferCopy region;
+        vk::PipelineStageFlags dst_stages;
+    };
+
+    struct ImageCopyCmd
+    {
+        vk::Buffer src;
+        vk::Image dst;
+        vk::BufferImageCopy region;
+        vk::ImageSubresourceRange range;
+        vk::ImageLayout final_layout;
+        vk::PipelineStageFlags dst_stages;
+        vk::AccessFlags dst_access;
+    };
+
+    struct Batch
+    {
+        vk::CommandBuffer buf;
+        uint64_t timeline_value = 0;
+        vk::DeviceSize ring_bytes = 0;//including alignment and wrap padding
+        std::vector<DeviceAllocator::BufferAllocation> oversized_staging;
+    };
+
+    vk::Device device;
+    DeviceAllocator *allocator = nullptr;
+    QueueDesc transfer_queue;
+    uint32_t graphics_family = 0;
+
+    DeviceAllocator::BufferAllocation ring;
+    vk::DeviceSize ring_size = 0;
+    vk::DeviceSize ring_head = 0;
+    vk::DeviceSize ring_used = 0;
+    vk::DeviceSize copy_alignment = MIN_COPY_ALIGNMENT;
+
+    vk::CommandPool comm_pool;
+    std::vector<vk::CommandBuffer> free_bufs;
+
+    vk::Semaphore timeline;
+    uint64_t last_submitted_value = 0;
+    std::deque<Batch> in_flight;
+
+    //recorded by next Submit
+    std::vector<BufferCopyCmd> pending_buffer_copies;
+    std::vector<ImageCopyCmd> pending_image_copies;
+    std::vector<DeviceAllocator::BufferAllocation> pending_oversized;
+    vk::DeviceSize pending_ring_bytes = 0;
+
+    //recorded into next graphics command buffer
+    std::vector<vk::ImageMemoryBarrier> acquire_image_barriers;
+    GraphicsWait graphics_wait;
+
+    std::mutex uploader_mutex;
+
+    auto is_ownership_transfer_needed() const -> bool;
+    auto try_allocate_ring(vk::DeviceSize size) -> std::optional<vk::DeviceSize>;
+    auto retire_batches() -> vk::Result;
+    auto wait_oldest_batch() -> vk::Result;
+    auto submit_pending() -> vk::Result;
+    auto allocate_staging(std::span<const uint8_t> data, vk::Buffer &src, vk::DeviceSize &src_offset) -> vk::Result;
+public:
+    StagingUploader() = default;
+    StagingUploader(const StagingUploader &su) = delete;
+    ~StagingUploader() = default;
+
+    auto init(vk::Device dev,
+              vk::PhysicalDevice ph_dev,
+              DeviceAllocator &alloc,
+              const QueueDesc &transfer,
+              uint32_t graphics_queue_family,
+              vk::DeviceSize size = DEFAULT_RING_SIZE) -> vk::Result;
+    auto destroy() -> void;
+    auto is_inited() const -> bool;
+
+    //dst_stages - where graphics queue uses data after upload
+    auto UploadBuffer(vk::Buffer dst,
+                      vk::DeviceSize dst_offset,
+                      std::span<const uint8_t> data,
+                      vk::PipelineStageFlags dst_stages) -> vk::Result;
+    //dst_stages/dst_access - how graphics queue uses image after upload
+    //image is transitioned from undefined layout, region.bufferOffset is ignored
+    auto UploadImage(vk::Image dst,
+                     const vk::BufferImageCopy &region,
+                     const vk::ImageSubresourceRange &range,
+                     std::span<const uint8_t> data,
+                     vk::ImageLayout final_layout,
+                     vk::PipelineStageFlags dst_stages,
+                     vk::AccessFlags dst_access) -> vk::Result;
+
+    //submits all pending uploads as one batch
+    auto Submit() -> vk::Result;
+    //records acquire barriers of submitted batches, returned value must be waited by the same graphics submit
+    auto RecordAcquires(vk::CommandBuffer graphics_buf) -> GraphicsWait;
+    auto WaitIdle() -> vk::Result;
+
+    auto GetTimelineSemaphore() const -> vk::Semaphore;
+    //one family if uploads share graphics family
+    auto GetQueueFamilies() const -> std::vector<uint32_t>;
+};
@@ -1,4 +1,5 @@
 #include "Mat.hpp"
+#include <array>
 
 #include <iostream>
 
@@ -116,4 +117,39 @@ namespace twv
 
 		return out_m;
 	}
+	//Planes of clip volume -w <= x, y <= w, 0 <= z <= w for row vectors (v * view_proj).
+	//Order: left, right, bottom, top, near, far. xyz is inward normal, w is distance.
+	template<std::floating_point T>
+	constexpr auto FrustumPlanes(const Mat<T, 4, 4> &view_proj) -> std::array<Vec<T, 4>, 6>
+	{
+		auto column = [&](size_t col) -> Vec<T, 4>
+		{
+			Vec<T, 4> out_v;
+			for(size_t row = 0; row < 4; row++)
+				out_v[row] = view_proj[row][col];
+
+			return out_v;
+		};
+
+		auto c0 = column(0);
+		auto c1 = column(1);
+		auto c2 = column(2);
+		auto c3 = column(3);
+
+		std::array<Vec<T, 4>, 6> planes{c3, c3, c3, c3, c2, c3};
+		planes[0] += c0;
+		planes[1] -= c0;
+		planes[2] += c1;
+		planes[3] -= c1;
+		planes[5] -= c2;
+
+		for(auto &plane : planes)
+		{
+			T len = sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			if(len != T(0))
+				plane /= len;
+		}
+
+		return planes;
+	}
 }
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <set>
+#include <map>
+#include <optional>
+#include <bit>
+
+namespace hrs
+{
+	//Classic binary buddy allocator over [0, size) range.
+	//It allocates only offsets, so it can manage any linear resource (device memory, buffers and etc.)
+	//Every block of order k is aligned to (min_block_size << k), so alignment is handled by size rounding.
+	class BuddyAllocator
+	{
+	private:
+		size_t size;
+		size_t min_block_size;
+		size_t used;
+		std::vector<std::set<size_t>> free_blocks;//per order
+		std::map<size_t, uint8_t> allocated_blocks;//offset -> order
+
+		constexpr auto block_size(size_t order) const -> size_t
+		{
+			return min_block_size << order;
+		}
+
+		constexpr auto order_for(size_t required_size) const -> size_t
+		{
+			if(required_size <= min_block_size)
+				return 0;
+
+			return std::bit_width((required_size - 1) / min_block_size);
+		}
+
+	public:
+		BuddyAllocator(size_t _size = 0, size_t _min_block_size = 256)
+		{
+			init(_size, _min_block_size);
+		}
+
+		~BuddyAllocator() = default;
+		BuddyAllocator(const BuddyAllocator &) = default;
+		BuddyAllocator(BuddyAllocator &&) noexcept = default;
+		auto operator=(const BuddyAllocator &) -> BuddyAllocator & = default;
+		auto operator=(BuddyAllocator &&) noexcept -> BuddyAllocator & = default;
+
+		//size and min_block_size are rounded down/up to power of two
+		auto init(size_t _size, size_t _min_block_size = 256) -> void
+		{
+			min_block_size = std::bit_ceil(_min_block_size == 0 ? size_t(1) : _min_block_size);
+			size = (_size < min_block_size ? 0 : std::bit_floor(_size));
+			used = 0;
+			allocated_blocks.clear();
+			free_blocks.clear();
+
+			if(size == 0)
+				return;
+
+			free_blocks.resize(order_for(size) + 1);
+			free_blocks.back().insert(0);
+		}
+
+		auto allocate(size_t required_size, size_t alignment = 1) -> std::optional<size_t>
+		{
+			if(size == 0 || required_size == 0)
+				return {};
+
+			if(alignment > required_size)
+				required_size = alignment;
+
+			if(required_size > size)
+				return {};
+
+			size_t target_order = order_for(required_size);
+			size_t order = target_order;
+			while(order < free_blocks.size() && free_blocks[order].empty())
+				order++;
+
+			if(order == free_blocks.size())
+				return {};
+
+			size_t offset = *free_blocks[order].begin();
+			free_blocks[order].erase(free_blocks[order].begin());
+
+			//split until required order, right halves become free
+			while(order > target_order)
+			{
+				order--;
+				free_blocks[order].insert(offset + block_size(order));
+			}
+
+			allocated_blocks.insert({offset, static_cast<uint8_t>(target_order)});
+			used += block_size(target_order);
+			return offset;
+		}
+
+		auto free(size_t offset) -> bool
+		{
+			auto it = allocated_blocks.find(offset);
+			if(it == allocated_blocks.end())
+				return false;
+
+			size_t order = it->second;
+			allocated_blocks.erase(it);
+			used -= block_size(order);
+
+			//merge with buddy while it's free
+			while(order + 1 < free_blocks.size())
+			{
+				size_t buddy = offset ^ block_size(order);
+				auto buddy_it = free_blocks[order].find(buddy);
+				if(buddy_it == free_blocks[order].end())
+					break;
+
+				free_blocks[order].erase(buddy_it);
+				offset = (offset < buddy ? offset : buddy);
+				order++;
+			}
+
+			free_blocks[order].insert(offset);
+			return true;
+		}
+
+		auto allocation_size(size_t offset) const -> size_t
+		{
+			auto it = allocated_blocks.find(offset);
+			if(it == allocated_blocks.end())
+				return 0;
+
+			return block_size(it->second);
+		}
+
+		auto get_size() const -> size_t
+		{
+			return size;
+		}
+
+		auto get_used() const -> size_t
+		{
+			return used;
+		}
+
+		auto get_allocation_count() const -> size_t
+		{
+			return allocated_blocks.size();
+		}
+
+		auto is_empty() const -> bool
+		{
+			return allocated_blocks.empty();
+		}
+
+		//largest block that can be allocated right now
+		auto get_largest_free() const -> size_t
+		{
+			for(size_t order = free_blocks.size(); order > 0; order--)
+				if(!free_blocks[order - 1].empty())
+					return block_size(order - 1);
+
+			return 0;
+		}
+	};
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+namespace hrs
+{
+	//Paces loop to target rate: coarse sleep until spin_margin before deadline, then spin.
+	//OS sleep granularity is much worse than frame budget, spinning the last part keeps pacing steady.
+	class FrameLimiter
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+	private:
+		clock::duration period = clock::duration::zero();
+		clock::duration spin_margin;
+		clock::time_point deadline;
+		bool is_started = false;
+
+	public:
+		FrameLimiter(std::chrono::microseconds _spin_margin = std::chrono::microseconds(1500)) : spin_margin(_spin_margin) {}
+
+		//0 - not limited
+		auto SetTargetRate(double frames_per_second) -> void
+		{
+			if(frames_per_second <= 0.0)
+				period = clock::duration::zero();
+			else
+				period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / frames_per_second));
+
+			is_started = false;
+		}
+
+		auto IsEnabled() const -> bool
+		{
+			return period != clock::duration::zero();
+		}
+
+		//blocks until next frame must start
+		auto Wait() -> void
+		{
+			if(!IsEnabled())
+				return;
+
+			auto now = clock::now();
+			if(!is_started)
+			{
+				deadline = now + period;
+				is_started = true;
+				return;
+			}
+
+			if(deadline > now + spin_margin)
+				std::this_thread::sleep_for(deadline - now - spin_margin);
+
+			while(clock::now() < deadline)
+				std::this_thread::yield();
+
+			//late frame starts new schedule instead of burst of catching up frames
+			now = clock::now();
+			deadline += period;
+			if(deadline < now)
+				deadline = now + period;
+		}
+	};
+}
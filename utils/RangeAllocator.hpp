@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <iterator>
+
+namespace hrs
+{
+	//First-fit allocator of [offset, offset + size) ranges inside [0, capacity).
+	//Works in any units (bytes, vertices, indices), neighbour free ranges are coalesced on free.
+	class RangeAllocator
+	{
+	private:
+		size_t capacity;
+		size_t used;
+		std::map<size_t, size_t> free_ranges;//offset -> size
+		std::map<size_t, size_t> allocated_ranges;//offset -> size
+
+	public:
+		RangeAllocator(size_t _capacity = 0)
+		{
+			init(_capacity);
+		}
+
+		~RangeAllocator() = default;
+		RangeAllocator(const RangeAllocator &) = default;
+		RangeAllocator(RangeAllocator &&) noexcept = default;
+		auto operator=(const RangeAllocator &) -> RangeAllocator & = default;
+		auto operator=(RangeAllocator &&) noexcept -> RangeAllocator & = default;
+
+		auto init(size_t _capacity) -> void
+		{
+			capacity = _capacity;
+			used = 0;
+			free_ranges.clear();
+			allocated_ranges.clear();
+			if(capacity != 0)
+				free_ranges.insert({0, capacity});
+		}
+
+		//size 0 isn't a range, callers keep empty ranges themselves
+		auto allocate(size_t size) -> std::optional<size_t>
+		{
+			if(size == 0)
+				return {};
+
+			for(auto it = free_ranges.begin(); it != free_ranges.end(); it++)
+			{
+				if(it->second < size)
+					continue;
+
+				size_t offset = it->first;
+				size_t rest = it->second - size;
+				free_ranges.erase(it);
+				if(rest != 0)
+					free_ranges.insert({offset + size, rest});
+
+				allocated_ranges.insert({offset, size});
+				used += size;
+				return offset;
+			}
+
+			return {};
+		}
+
+		auto free(size_t offset) -> bool
+		{
+			auto alloc_it = allocated_ranges.find(offset);
+			if(alloc_it == allocated_ranges.end())
+				return false;
+
+			size_t size = alloc_it->second;
+			allocated_ranges.erase(alloc_it);
+			used -= size;
+
+			auto next = free_ranges.lower_bound(offset);
+			if(next != free_ranges.end() && offset + size == next->first)
+			{
+				size += next->second;
+				next = free_ranges.erase(next);
+			}
+
+			if(next != free_ranges.begin())
+			{
+				auto prev = std::prev(next);
+				if(prev->first + prev->second == offset)
+				{
+					prev->second += size;
+					return true;
+				}
+			}
+
+			free_ranges.insert({offset, size});
+			return true;
+		}
+
+		auto get_capacity() const -> size_t
+		{
+			return capacity;
+		}
+
+		auto get_used() const -> size_t
+		{
+			return used;
+		}
+
+		auto get_allocation_count() const -> size_t
+		{
+			return allocated_ranges.size();
+		}
+	};
+}
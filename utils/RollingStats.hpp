@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cstddef>
+
+namespace hrs
+{
+	//Keeps last window_size samples in ring and computes order statistics over them.
+	//Summary sorts a copy of samples, so it's meant to be called rarely, not every sample.
+	class RollingStats
+	{
+	public:
+		struct Summary
+		{
+			size_t count = 0;
+			double min = 0.0;
+			double max = 0.0;
+			double avg = 0.0;
+			double p50 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+		};
+
+	private:
+		std::vector<double> samples;
+		size_t window_size;
+		size_t next = 0;
+		mutable std::vector<double> sorted;
+
+	public:
+		RollingStats(size_t _window_size = 1024) : window_size(_window_size == 0 ? 1 : _window_size)
+		{
+			samples.reserve(window_size);
+		}
+
+		auto Add(double sample) -> void
+		{
+			if(samples.size() < window_size)
+				samples.push_back(sample);
+			else
+				samples[next] = sample;
+
+			next = (next + 1) % window_size;
+		}
+
+		auto Clear() -> void
+		{
+			samples.clear();
+			next = 0;
+		}
+
+		auto GetCount() const -> size_t
+		{
+			return samples.size();
+		}
+
+		//percentiles take the sample at rounded rank p * (n - 1), no interpolation
+		auto GetSummary() const -> Summary
+		{
+			if(samples.empty())
+				return {};
+
+			sorted.assign(samples.begin(), samples.end());
+			std::sort(sorted.begin(), sorted.end());
+
+			auto percentile = [this](double p)
+			{
+				size_t rank = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+				return sorted[rank];
+			};
+
+			return Summary
+			{
+				.count = sorted.size(),
+				.min = sorted.front(),
+				.max = sorted.back(),
+				.avg = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size(),
+				.p50 = percentile(0.50),
+				.p95 = percentile(0.95),
+				.p99 = percentile(0.99)
+			};
+		}
+	};
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+namespace hrs
+{
+	//Fixed set of workers with shared FIFO queue of tasks.
+	//Results and exceptions are returned through std::future.
+	class ThreadPool
+	{
+	private:
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> tasks;
+		std::mutex tasks_mutex;
+		std::condition_variable tasks_cv;
+		bool is_stopped = true;
+
+		auto worker_loop() -> void
+		{
+			while(true)
+			{
+				std::function<void()> task;
+				{
+					std::unique_lock<std::mutex> lck(tasks_mutex);
+					tasks_cv.wait(lck, [this]()
+					{
+						return is_stopped || !tasks.empty();
+					});
+
+					//queued tasks are finished even after stop
+					if(tasks.empty())
+						return;
+
+					task = std::move(tasks.front());
+					tasks.pop_front();
+				}
+
+				task();
+			}
+		}
+
+	public:
+		ThreadPool(size_t count = 0)
+		{
+			init(count);
+		}
+
+		~ThreadPool()
+		{
+			stop();
+		}
+
+		ThreadPool(const ThreadPool &) = delete;
+		auto operator=(const ThreadPool &) -> ThreadPool & = delete;
+
+		auto init(size_t count) -> void
+		{
+			stop();
+			if(count == 0)
+				return;
+
+			is_stopped = false;
+			workers.reserve(count);
+			for(size_t i = 0; i < count; i++)
+				workers.emplace_back(&ThreadPool::worker_loop, this);
+		}
+
+		auto stop() -> void
+		{
+			{
+				std::lock_guard<std::mutex> lck(tasks_mutex);
+				is_stopped = true;
+			}
+
+			tasks_cv.notify_all();
+			for(auto &worker : workers)
+				worker.join();
+
+			workers.clear();
+		}
+
+		auto get_worker_count() const -> size_t
+		{
+			return workers.size();
+		}
+
+		//without workers task is executed in place
+		template<typename F>
+		auto submit(F &&func) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+		{
+			using R = std::invoke_result_t<std::decay_t<F>>;
+			auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+			auto fut = task->get_future();
+
+			if(workers.empty())
+			{
+				(*task)();
+				return fut;
+			}
+
+			{
+				std::lock_guard<std::mutex> lck(tasks_mutex);
+				tasks.emplace_back([task]()
+				{
+					(*task)();
+				});
+			}
+
+			tasks_cv.notify_one();
+			return fut;
+		}
+	};
+}